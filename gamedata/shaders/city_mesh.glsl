@@ -4,14 +4,20 @@
 
 // constants
 uniform mat4 view_projection_matrix;
+uniform int animation_cycle; // game cycles elapsed since blocks animation started
 uniform isamplerBuffer tex_1; // block frames table
 uniform isamplerBuffer tex_2; // palette indices table
 
 // attributes
+#ifdef CITY_VERTEX_PACKED
+in ivec4 in_pos0; // fixed point position and texture layer
+in ivec4 in_texcoord0; // texture coordinate, remap index and transparency flag
+#else
 in vec3 in_pos0;
 in vec3 in_texcoord0;
 in int in_color0; // remap index
 in int in_color1; // transparency flag
+#endif
 
 // pass to fragment shader
 out vec3 Texcoord;
@@ -20,23 +26,43 @@ flat out float BlockTextureIndex;
 flat out float PaletteIndex;
 
 const float MeshHeightModifier = -0.15; // shift the geometry level slightly below the sprites to remove the zfighting
+const int BlocksAnimationFramesFlag = 0x4000; // table entry refers to animation frames record, must match SpriteManager
 
 // entry point
 void main() 
 {
+#ifdef CITY_VERTEX_PACKED
+    // decode compact vertex
+    vec3 position = vec3(in_pos0.xyz) * CITY_VERTEX_POSITION_SCALE;
+    Texcoord = vec3(in_texcoord0.xy, in_pos0.w);
+    Transparency = in_texcoord0.w;
+    int remapIndex = in_texcoord0.z;
+#else
+    vec3 position = in_pos0;
 	Texcoord = in_texcoord0;
     Transparency = in_color1;
+    int remapIndex = in_color0;
+#endif
 
     // get real block tile index
-    BlockTextureIndex = texelFetch(tex_1, int(Texcoord.z + 0.5)).r;
+    int blockIndex = texelFetch(tex_1, int(Texcoord.z + 0.5)).r;
+    if (blockIndex >= BlocksAnimationFramesFlag)
+    {
+        // animated block, record contains frames count, game cycles per frame and frames
+        int recordOffset = blockIndex - BlocksAnimationFramesFlag;
+        int framesCount = texelFetch(tex_1, recordOffset).r;
+        int cyclesPerFrame = texelFetch(tex_1, recordOffset + 1).r;
+        blockIndex = texelFetch(tex_1, recordOffset + 2 + (animation_cycle / cyclesPerFrame) % framesCount).r;
+    }
+    BlockTextureIndex = blockIndex;
 
     // get palette index for block tile
-    PaletteIndex = texelFetch(tex_2, int(4.0 * BlockTextureIndex + in_color0)).r;
+    PaletteIndex = texelFetch(tex_2, int(4.0 * BlockTextureIndex + remapIndex)).r;
 
     vec4 vertexPosition = view_projection_matrix * vec4(
-		in_pos0.x, 
-		in_pos0.y + MeshHeightModifier, 
-		in_pos0.z, 1.0f);
+		position.x, 
+		position.y + MeshHeightModifier, 
+		position.z, 1.0f);
 
     gl_Position = vertexPosition;
 }
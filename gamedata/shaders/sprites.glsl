@@ -5,24 +5,45 @@
 // constants
 uniform mat4 view_projection_matrix;
 
-// attributes
-in vec3 in_pos0;
-in vec2 in_texcoord0;
-in int in_color0; // palette index
+// per instance attributes, see SpriteInstance3D
+in vec4 in_pos0; // position x, position y, height, rotation angle in radians
+in vec4 in_texcoord0; // texture region u0, v0, u1, v1
+in vec2 in_texcoord1; // sprite size
+in ivec2 in_color0; // palette index, origin mode
 
 // pass to fragment shader
 out vec2 Texcoord;
 out vec3 Position;
 flat out int PaletteIndex;
 
+const int ORIGIN_MODE_CENTER = 1;
+
 // entry point
 void main() 
 {
-	Texcoord = in_texcoord0;
-    Position = in_pos0;
-    PaletteIndex = in_color0;
+    // all sprites share same quad, vertex index is corner index
+    vec2 corner = vec2(gl_VertexID & 1, gl_VertexID >> 1);
+
+    vec2 cornerPosition = in_texcoord1 * corner;
+    if (in_color0.y == ORIGIN_MODE_CENTER)
+    {
+        cornerPosition -= in_texcoord1 * 0.5f;
+    }
+
+    float rotationSin = sin(in_pos0.w);
+    float rotationCos = cos(in_pos0.w);
+    cornerPosition = vec2(cornerPosition.x * rotationCos - cornerPosition.y * rotationSin, 
+        cornerPosition.x * rotationSin + cornerPosition.y * rotationCos) + in_pos0.xy;
+
+#ifdef SPRITES_DEPTH_AXIS_Z
+    Position = vec3(cornerPosition, in_pos0.z);
+#else
+    Position = vec3(cornerPosition.x, in_pos0.z, cornerPosition.y);
+#endif
+	Texcoord = mix(in_texcoord0.xy, in_texcoord0.zw, corner);
+    PaletteIndex = in_color0.x;
 
-    vec4 vertexPosition = view_projection_matrix * vec4(in_pos0, 1.0f);
+    vec4 vertexPosition = view_projection_matrix * vec4(Position, 1.0f);
     gl_Position = vertexPosition;
 }
 
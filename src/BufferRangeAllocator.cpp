@@ -0,0 +1,100 @@
+#include "stdafx.h"
+#include "BufferRangeAllocator.h"
+
+void BufferRangeAllocator::Setup(unsigned int capacity, unsigned int usedLength)
+{
+    debug_assert(usedLength <= capacity);
+
+    mFreeRanges.clear();
+    mCapacity = capacity;
+    if (usedLength < capacity)
+    {
+        mFreeRanges.push_back({usedLength, capacity - usedLength});
+    }
+}
+
+void BufferRangeAllocator::Cleanup()
+{
+    mFreeRanges.clear();
+    mCapacity = 0;
+}
+
+bool BufferRangeAllocator::Allocate(unsigned int length, unsigned int& outOffset)
+{
+    if (length == 0)
+    {
+        outOffset = 0;
+        return true;
+    }
+
+    for (auto range_iterator = mFreeRanges.begin(); range_iterator != mFreeRanges.end(); ++range_iterator)
+    {
+        if (range_iterator->mLength < length)
+            continue;
+
+        outOffset = range_iterator->mOffset;
+        range_iterator->mOffset += length;
+        range_iterator->mLength -= length;
+        if (range_iterator->mLength == 0)
+        {
+            mFreeRanges.erase(range_iterator);
+        }
+        return true;
+    }
+    return false;
+}
+
+void BufferRangeAllocator::Free(unsigned int offset, unsigned int length)
+{
+    if (length == 0)
+        return;
+
+    debug_assert(offset + length <= mCapacity);
+
+    auto next_iterator = std::upper_bound(mFreeRanges.begin(), mFreeRanges.end(), offset, 
+        [](unsigned int rangeOffset, const FreeRange& currRange)
+        {
+            return rangeOffset < currRange.mOffset;
+        });
+
+    // merge with previous free range
+    if (next_iterator != mFreeRanges.begin())
+    {
+        auto prev_iterator = next_iterator - 1;
+        debug_assert(prev_iterator->mOffset + prev_iterator->mLength <= offset);
+        if (prev_iterator->mOffset + prev_iterator->mLength == offset)
+        {
+            prev_iterator->mLength += length;
+            // merge with next free range
+            if (next_iterator != mFreeRanges.end() && next_iterator->mOffset == offset + length)
+            {
+                prev_iterator->mLength += next_iterator->mLength;
+                mFreeRanges.erase(next_iterator);
+            }
+            return;
+        }
+    }
+
+    // merge with next free range
+    if (next_iterator != mFreeRanges.end())
+    {
+        debug_assert(offset + length <= next_iterator->mOffset);
+        if (next_iterator->mOffset == offset + length)
+        {
+            next_iterator->mOffset = offset;
+            next_iterator->mLength += length;
+            return;
+        }
+    }
+    mFreeRanges.insert(next_iterator, {offset, length});
+}
+
+void BufferRangeAllocator::Grow(unsigned int newCapacity)
+{
+    if (newCapacity <= mCapacity)
+        return;
+
+    const unsigned int prevCapacity = mCapacity;
+    mCapacity = newCapacity;
+    Free(prevCapacity, newCapacity - prevCapacity);
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+// manages free space of buffer which content is split into variable sized ranges,
+// it does not own any memory and only tracks offsets, units are up to caller
+class BufferRangeAllocator final: public cxx::noncopyable
+{
+public:
+    // Reset allocator, whole capacity becomes free except for leading used part
+    // @param capacity: Total length of managed buffer
+    // @param usedLength: Length of initially allocated range at start of buffer
+    void Setup(unsigned int capacity, unsigned int usedLength);
+
+    // Drop all ranges and reset capacity to zero
+    void Cleanup();
+
+    // Find free range of specified length, first fit strategy
+    // @param length: Requested length
+    // @param outOffset: Start of allocated range
+    // @returns false if there is no contiguous free range large enough
+    bool Allocate(unsigned int length, unsigned int& outOffset);
+
+    // Return previously allocated range, adjacent free ranges get merged
+    // @param offset: Start of range
+    // @param length: Length of range
+    void Free(unsigned int offset, unsigned int length);
+
+    // Extend capacity, new space is appended to free ranges
+    // @param newCapacity: New total length, does nothing if it is less than current
+    void Grow(unsigned int newCapacity);
+
+    inline unsigned int GetCapacity() const { return mCapacity; }
+
+private:
+    struct FreeRange
+    {
+        unsigned int mOffset;
+        unsigned int mLength;
+    };
+    std::vector<FreeRange> mFreeRanges; // sorted by offset, never adjacent
+    unsigned int mCapacity = 0;
+};
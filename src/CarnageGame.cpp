@@ -9,9 +9,16 @@
 #include "MemoryManager.h"
 #include "TimeManager.h"
 #include "TrafficManager.h"
+#include "TaskManager.h"
 
 static const char* InputsConfigPath = "config/inputs.json";
 
+// number of block textures uploaded to gpu per frame while loading
+static const int LoadingBlockTexturesPerFrame = 256;
+
+// number of loading steps performed on worker threads
+static const int LoadingWorkerStepsCount = 4;
+
 //////////////////////////////////////////////////////////////////////////
 
 CarnageGame gCarnageGame;
@@ -36,10 +43,9 @@ bool CarnageGame::Initialize()
     if (gSystem.mStartupParams.mDebugMapName.empty())
         return false;
 
+    mScenarioStarted = false;
     if (!StartScenario(gSystem.mStartupParams.mDebugMapName))
     {
-        ShutdownCurrentScenario();
-
         gConsole.LogMessage(eLogMessage_Warning, "Fail to start game"); 
         return false;
     }
@@ -48,11 +54,21 @@ bool CarnageGame::Initialize()
 
 void CarnageGame::Deinit()
 {
+    // workers might still access game data
+    gTaskManager.WaitForTasks(mLoadingTasks);
+    mLoadingStage = eLoadingStage_None;
+
     ShutdownCurrentScenario();
 }
 
 void CarnageGame::UpdateFrame()
 {
+    if (IsLoading())
+    {
+        UpdateLoading();
+        return;
+    }
+
     float deltaTime = gTimeManager.mGameFrameDelta;
 
     gSpriteManager.UpdateBlocksAnimations(deltaTime);
@@ -268,6 +284,12 @@ void CarnageGame::DebugChangeMap(const std::string& mapName)
 {
     gConsole.LogMessage(eLogMessage_Debug, "Changing to next map '%s'", mapName.c_str());
 
+    if (IsLoading())
+    {
+        gConsole.LogMessage(eLogMessage_Warning, "Cannot change map while loading");
+        return;
+    }
+
     if (!StartScenario(mapName))
     {
         gConsole.LogMessage(eLogMessage_Warning, "Fail to change map");
@@ -277,30 +299,141 @@ void CarnageGame::DebugChangeMap(const std::string& mapName)
 
 bool CarnageGame::StartScenario(const std::string& mapName)
 {
-    ShutdownCurrentScenario();
+    debug_assert(!IsLoading());
 
-    if (!gGameMap.LoadFromFile(mapName))
-    {
-        gConsole.LogMessage(eLogMessage_Warning, "Cannot load map '%s'", mapName.c_str());
-        return false;
-    }
+    ShutdownCurrentScenario();
     gSpriteManager.Cleanup();
-    gRenderManager.mMapRenderer.BuildMapMesh();
-    if (!gSpriteManager.InitLevelSprites())
+
+    gConsole.LogMessage(eLogMessage_Info, "Loading map '%s'...", mapName.c_str());
+
+    mLoadingStartTime = std::chrono::high_resolution_clock::now();
+    mLoadingMapName = mapName;
+    mLoadingStepsDone = 0;
+    mLoadingFailed = false;
+    mLoadingStage = eLoadingStage_ReadLevelData;
+
+    gTaskManager.QueueTask([this]()
+        {
+            ReadLevelData();
+        }, 
+        &mLoadingTasks);
+    return true;
+}
+
+void CarnageGame::ReadLevelData()
+{
+    if (!gGameMap.LoadFromFile(mLoadingMapName))
     {
-        debug_assert(false);
+        gConsole.LogMessage(eLogMessage_Warning, "Cannot load map '%s'", mLoadingMapName.c_str());
+        mLoadingFailed = true;
+        return;
     }
-    //gSpriteManager.DumpSpriteDeltas("D:/Temp/gta1_deltas");
-    //gSpriteCache.DumpBlocksTexture("D:/Temp/gta1_blocks");
-    //gSpriteManager.DumpSpriteTextures("D:/Temp/gta1_sprites");
-    //gSpriteManager.DumpCarsTextures("D:/Temp/gta_cars");
-    if (!gPhysics.InitPhysicsWorld())
+    ++mLoadingStepsDone;
+
+    // remaining steps only read map data so they can run simultaneously
+    gTaskManager.QueueTask([this]()
+        {
+            gRenderManager.mMapRenderer.PrepareMapMesh();
+            ++mLoadingStepsDone;
+        }, 
+        &mLoadingTasks);
+
+    gTaskManager.QueueTask([this]()
+        {
+            if (!gSpriteManager.PrepareLevelSprites())
+            {
+                mLoadingFailed = true;
+            }
+            //gSpriteManager.DumpSpriteDeltas("D:/Temp/gta1_deltas");
+            //gSpriteCache.DumpBlocksTexture("D:/Temp/gta1_blocks");
+            //gSpriteManager.DumpSpriteTextures("D:/Temp/gta1_sprites");
+            //gSpriteManager.DumpCarsTextures("D:/Temp/gta_cars");
+            ++mLoadingStepsDone;
+        }, 
+        &mLoadingTasks);
+
+    gTaskManager.QueueTask([this]()
+        {
+            if (!gPhysics.InitPhysicsWorld())
+            {
+                gConsole.LogMessage(eLogMessage_Warning, "Cannot initialize physics world");
+                mLoadingFailed = true;
+            }
+            ++mLoadingStepsDone;
+        }, 
+        &mLoadingTasks);
+}
+
+void CarnageGame::UpdateLoading()
+{
+    switch (mLoadingStage)
     {
-        debug_assert(false);
-    }
+        case eLoadingStage_ReadLevelData:
+            if (!mLoadingTasks.IsCompleted())
+                break;
+
+            if (mLoadingFailed)
+            {
+                mLoadingStage = eLoadingStage_None;
+                ShutdownCurrentScenario();
+                gSpriteManager.Cleanup();
+
+                gConsole.LogMessage(eLogMessage_Warning, "Fail to load map '%s'", mLoadingMapName.c_str());
+                if (!mScenarioStarted)
+                {
+                    // nothing to play
+                    gSystem.QuitRequest();
+                }
+                break;
+            }
+            mLoadingStage = eLoadingStage_UploadMapMesh;
+        break;
 
-    gGameObjectsManager.InitGameObjects();
+        case eLoadingStage_UploadMapMesh:
+            gRenderManager.mMapRenderer.UploadMapMesh();
+            mLoadingStage = eLoadingStage_UploadSprites;
+        break;
 
+        case eLoadingStage_UploadSprites:
+        {
+            bool isCompleted = false;
+            if (!gSpriteManager.UploadLevelSprites(LoadingBlockTexturesPerFrame, isCompleted))
+            {
+                debug_assert(false);
+                isCompleted = true;
+            }
+            if (isCompleted)
+            {
+                mLoadingStage = eLoadingStage_InitGameObjects;
+            }
+        }
+        break;
+
+        case eLoadingStage_InitGameObjects:
+            gGameObjectsManager.InitGameObjects();
+            mLoadingStage = eLoadingStage_SpawnPlayers;
+        break;
+
+        case eLoadingStage_SpawnPlayers:
+        {
+            SpawnPlayers();
+
+            mScenarioStarted = true;
+            mLoadingStage = eLoadingStage_None;
+
+            std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - mLoadingStartTime;
+            gConsole.LogMessage(eLogMessage_Info, "Map '%s' loaded in %.1f ms", mLoadingMapName.c_str(), elapsed.count());
+        }
+        break;
+
+        default:
+            debug_assert(false);
+        break;
+    }
+}
+
+void CarnageGame::SpawnPlayers()
+{
     // temporary
     //glm::vec3 pos { 108.0f, 2.0f, 25.0f };
     //glm::vec3 pos { 14.0, 2.0f, 38.0f };
@@ -322,7 +455,7 @@ bool CarnageGame::StartScenario(const std::string& mapName)
         {
             for (int zBlock = MAP_LAYERS_COUNT - 1; zBlock > -1; --zBlock)
             {
-                MapBlockInfo* currBlock = gGameMap.GetBlock(xBlock, yBlock, zBlock);
+                const MapBlockInfo* currBlock = gGameMap.GetBlock(xBlock, yBlock, zBlock);
                 if (currBlock->mGroundType == eGroundType_Field ||
                     currBlock->mGroundType == eGroundType_Pawement ||
                     currBlock->mGroundType == eGroundType_Road)
@@ -344,7 +477,32 @@ bool CarnageGame::StartScenario(const std::string& mapName)
     gTrafficManager.StartupTraffic();
 
     SetupScreenLayout(mNumPlayers);
-    return true;
+}
+
+bool CarnageGame::IsLoading() const
+{
+    return mLoadingStage != eLoadingStage_None;
+}
+
+float CarnageGame::GetLoadingProgress() const
+{
+    // rough weights of loading stages
+    switch (mLoadingStage)
+    {
+        case eLoadingStage_ReadLevelData: 
+            return 0.6f * mLoadingStepsDone.load() / LoadingWorkerStepsCount;
+        case eLoadingStage_UploadMapMesh: 
+            return 0.6f;
+        case eLoadingStage_UploadSprites: 
+            return 0.65f + 0.25f * gSpriteManager.GetLevelSpritesUploadProgress();
+        case eLoadingStage_InitGameObjects: 
+            return 0.9f;
+        case eLoadingStage_SpawnPlayers: 
+            return 0.95f;
+        default:
+        break;
+    }
+    return 1.0f;
 }
 
 void CarnageGame::ShutdownCurrentScenario()
@@ -360,6 +518,7 @@ void CarnageGame::ShutdownCurrentScenario()
         mHumanSlot[ihuman].mCharView.SetCameraController(nullptr);
         mHumanSlot[ihuman].mCharPedestrian = nullptr;
     }
+    mNumPlayers = 0;
     gTrafficManager.CleanupTraffic();
     gGameObjectsManager.FreeGameObjects();
     gPhysics.FreePhysicsWorld();
@@ -4,6 +4,7 @@
 #include "GameObjectsManager.h"
 #include "HumanCharacterController.h"
 #include "HumanCharacterView.h"
+#include "TaskManager.h"
 
 // top level game application controller
 class CarnageGame final: public InputEventsHandler
@@ -53,14 +54,50 @@ public:
     // @returns -1 on error
     int GetPlayerIndex(const HumanCharacterController* controller) const;
 
+    // Test whether level is being loaded in background
+    bool IsLoading() const;
+
+    // Get level loading progress in range [0, 1]
+    float GetLoadingProgress() const;
+
     // Debug stuff
     void DebugChangeMap(const std::string& mapName);
 
 private:
+    // level gets loaded in stages, heavy cpu work is done on worker threads 
+    // while gpu uploads are spread across multiple frames on main thread
+    enum eLoadingStage
+    {
+        eLoadingStage_None, // nothing is loading
+        eLoadingStage_ReadLevelData, // map, style, mesh and collision data are being processed on worker threads
+        eLoadingStage_UploadMapMesh,
+        eLoadingStage_UploadSprites,
+        eLoadingStage_InitGameObjects,
+        eLoadingStage_SpawnPlayers,
+    };
+
     bool SetInputActionsFromConfig();
 
+    // Begin level loading, scenario gets started once all loading stages are done
     bool StartScenario(const std::string& mapName);
     void ShutdownCurrentScenario();
+
+    // Process current loading stage
+    void UpdateLoading();
+
+    // Worker thread procedure
+    void ReadLevelData();
+
+    void SpawnPlayers();
+
+private:
+    eLoadingStage mLoadingStage = eLoadingStage_None;
+    std::string mLoadingMapName;
+    TaskGroup mLoadingTasks;
+    std::atomic<int> mLoadingStepsDone {0};
+    std::atomic<bool> mLoadingFailed {false};
+    bool mScenarioStarted = false; // first level has been loaded successfully
+    std::chrono::high_resolution_clock::time_point mLoadingStartTime;
 };
 
 extern CarnageGame gCarnageGame;
\ No newline at end of file
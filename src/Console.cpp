@@ -25,6 +25,8 @@ void Console::Deinit()
 
 void Console::LogMessage(eLogMessage messageCat, const char* format, ...)
 {
+    std::lock_guard<std::mutex> lock (mLogMutex);
+
     VA_SCOPE_OPEN(format, vaList)
     vsnprintf(ConsoleMessageBuffer, sizeof(ConsoleMessageBuffer), format, vaList);
     VA_SCOPE_CLOSE(vaList)
@@ -42,9 +44,16 @@ void Console::LogMessage(eLogMessage messageCat, const char* format, ...)
 
 void Console::Flush()
 {
+    std::lock_guard<std::mutex> lock (mLogMutex);
+
     mLines.clear();
 }
 
+std::unique_lock<std::mutex> Console::LockLines()
+{
+    return std::unique_lock<std::mutex>(mLogMutex);
+}
+
 void Console::ExecuteCommands(const char* commands)
 {
     cxx::string_tokenizer tokenizer(commands);
@@ -21,12 +21,18 @@ public:
     // Clear all console text messages
     void Flush();
 
+    // Lock text messages list while reading it, messages can be written from worker threads
+    std::unique_lock<std::mutex> LockLines();
+
     // parse and execute commands
     // @param commands: Commands string
     void ExecuteCommands(const char* commands);
 
 public:
     std::deque<ConsoleLine> mLines;
+
+private:
+    std::mutex mLogMutex; // messages can be written from worker threads
 };
 
 extern Console gConsole;
\ No newline at end of file
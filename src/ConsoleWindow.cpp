@@ -39,6 +39,7 @@ void ConsoleWindow::DoUI(ImGuiIO& imguiContext)
         ImGuiWindowFlags_HorizontalScrollbar | ImGuiWindowFlags_NoBackground);
     ImGui::PushStyleVar(ImGuiStyleVar_ItemSpacing, ImVec2(4,1));
 
+    std::unique_lock<std::mutex> linesLock = gConsole.LockLines();
     for (const ConsoleLine& currentLine: gConsole.mLines)
     {
         const char* item = currentLine.mString.c_str();
@@ -65,6 +66,7 @@ void ConsoleWindow::DoUI(ImGuiIO& imguiContext)
             ImGui::PopStyleColor();
         }
     }
+    linesLock.unlock();
 
     if (mScrollToBottom || (mAutoScroll && ImGui::GetScrollY() >= ImGui::GetScrollMaxY()))
     {
@@ -79,18 +79,17 @@ void DebugRenderer::Deinit()
     }
 }
 
-void DebugRenderer::RenderFrameBegin(RenderView* renderview)
+void DebugRenderer::RenderFrameBegin(GameCamera& camera)
 {
     gRenderManager.mDebugProgram.Activate();
-    mCurrentRenderView = renderview;
+    mCurrentCamera = &camera;
 
-    debug_assert(mCurrentRenderView);
-    gRenderManager.mDebugProgram.UploadCameraTransformMatrices(mCurrentRenderView->mCamera);
+    gRenderManager.mDebugProgram.UploadCameraTransformMatrices(camera);
 }
 
 void DebugRenderer::RenderFrameEnd()
 {
-    debug_assert(mCurrentRenderView);        
+    debug_assert(mCurrentCamera);        
 
     if (HasPendingDraws())
     {
@@ -2,7 +2,7 @@
 
 #include "GraphicsDefs.h"
 
-class RenderView;
+class GameCamera;
 
 // debug geometry visualization manager
 class DebugRenderer: public cxx::noncopyable
@@ -13,7 +13,9 @@ public:
     bool Initialize();
     void Deinit();
 
-    void RenderFrameBegin(RenderView* renderview);
+    // setup camera for debug drawing, queued geometry gets drawn on frame end
+    // geometry may be queued before frame begins, while game state is still accessible
+    void RenderFrameBegin(GameCamera& camera);
     void RenderFrameEnd();
 
     // push line to debug draw queue
@@ -78,5 +80,5 @@ private:
     Vertex3D_Debug mDebugVertices[MaxDebugVertices];
 
     GpuBuffer* mGpuVerticesBuffer = nullptr;
-    RenderView* mCurrentRenderView = nullptr;
+    GameCamera* mCurrentCamera = nullptr;
 };
@@ -0,0 +1,874 @@
+#include "stdafx.h"
+#include "DebugSelfTests.h"
+#include "GameMapManager.h"
+#include "GameMapHelpers.h"
+#include "SpriteBatch.h"
+#include "RenderingManager.h"
+#include "GpuBuffer.h"
+
+// test whether values are bit-exact, unlike comparison operator it tells apart signed zeros
+inline bool IsSameBits(float lhs, float rhs)
+{
+    return memcmp(&lhs, &rhs, sizeof(float)) == 0;
+}
+
+// comparison sort, used as reference for radix sort of sprite draw list
+static void SortSpritesReference(std::vector<Sprite2D>& sprites, eSpritesSortMode sortMode)
+{
+    if (sortMode == eSpritesSortMode_None)
+        return;
+
+    if (sortMode == eSpritesSortMode_Height)
+    {
+        static auto SortProc = [](const Sprite2D& lhs, const Sprite2D& rhs)
+        {
+            return lhs.mHeight < rhs.mHeight;
+        };
+        std::sort(sprites.begin(), sprites.end(), SortProc);
+        return;
+    }
+
+    if (sortMode == eSpritesSortMode_DrawOrder)
+    {
+        static auto SortProc = [](const Sprite2D& lhs, const Sprite2D& rhs)
+        {
+            return lhs.mDrawOrder < rhs.mDrawOrder;
+        };
+        std::sort(sprites.begin(), sprites.end(), SortProc);
+        return;
+    }
+
+    if (sortMode == eSpritesSortMode_HeightAndDrawOrder)
+    {
+        static auto SortProc = [](const Sprite2D& lhs, const Sprite2D& rhs)
+        {
+            if (lhs.mHeight != rhs.mHeight)
+            {
+                return (lhs.mHeight < rhs.mHeight);
+            }
+            return (lhs.mDrawOrder < rhs.mDrawOrder);
+        };  
+        std::sort(sprites.begin(), sprites.end(), SortProc);
+        return;
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+void DebugSelfTests::BenchmarkHeightQueries(int numQueries)
+{
+    debug_assert(numQueries > 0);
+
+    // same points for all methods
+    cxx::randomizer pointsRand;
+    std::vector<glm::vec3> queryPoints(numQueries);
+    for (glm::vec3& currPoint: queryPoints)
+    {
+        currPoint.x = Convert::MapUnitsToMeters(pointsRand.generate_float() * MAP_DIMENSIONS);
+        currPoint.y = Convert::MapUnitsToMeters(pointsRand.generate_float() * MAP_LAYERS_COUNT);
+        currPoint.z = Convert::MapUnitsToMeters(pointsRand.generate_float() * MAP_DIMENSIONS);
+    }
+
+    // single queries alternate water handling, batched queries are done with water excluded only
+    std::vector<float> referenceHeights(numQueries);
+    std::vector<float> heights(numQueries);
+    std::vector<float> batchHeights(numQueries);
+    const double referenceTime = MeasureTime([&queryPoints, &referenceHeights, numQueries]()
+        {
+            for (int icurr = 0; icurr < numQueries; ++icurr)
+            {
+                referenceHeights[icurr] = GetHeightAtPositionReference(queryPoints[icurr], (icurr & 1) == 0);
+            }
+        });
+    const double singleTime = MeasureTime([&queryPoints, &heights, numQueries]()
+        {
+            for (int icurr = 0; icurr < numQueries; ++icurr)
+            {
+                heights[icurr] = gGameMap.GetHeightAtPosition(queryPoints[icurr], (icurr & 1) == 0);
+            }
+        });
+    const double batchTime = MeasureTime([&queryPoints, &batchHeights, numQueries]()
+        {
+            gGameMap.GetHeightAtPositions(queryPoints.data(), numQueries, batchHeights.data(), true);
+        });
+
+    int numMismatches = 0;
+    for (int icurr = 0; icurr < numQueries; ++icurr)
+    {
+        if (heights[icurr] != referenceHeights[icurr])
+        {
+            ++numMismatches;
+        }
+        if (batchHeights[icurr] != GetHeightAtPositionReference(queryPoints[icurr], true))
+        {
+            ++numMismatches;
+        }
+    }
+
+    gConsole.LogMessage(eLogMessage_Info, "Height queries benchmark (%d queries):", numQueries);
+    LogBenchmarkTime("blocks data", referenceTime, numQueries);
+    LogBenchmarkTime("heightfield", singleTime, numQueries);
+    LogBenchmarkTime("heightfield batched", batchTime, numQueries);
+    if (numMismatches > 0)
+    {
+        gConsole.LogMessage(eLogMessage_Warning, "Height queries mismatches: %d", numMismatches);
+    }
+}
+
+bool DebugSelfTests::CheckHeightQueries()
+{
+    // sample points are away from blocks edges, so conversion to meters and back does not move them to neighbour block
+    const float SubPositions[] = {0.125f, 0.5f, 0.875f};
+
+    std::vector<glm::vec3> columnPoints;
+    std::vector<float> heights;
+    for (int tiley = 0; tiley < MAP_DIMENSIONS; ++tiley)
+    for (int tilex = 0; tilex < MAP_DIMENSIONS; ++tilex)
+    {
+        columnPoints.clear();
+        for (int layer = 0; layer < MAP_LAYERS_COUNT; ++layer)
+        {
+            for (float suby: SubPositions)
+            for (float subx: SubPositions)
+            {
+                columnPoints.emplace_back(Convert::MapUnitsToMeters(tilex + subx), Convert::MapUnitsToMeters(layer * 1.0f), 
+                    Convert::MapUnitsToMeters(tiley + suby));
+            }
+        }
+        heights.resize(columnPoints.size());
+
+        for (bool excludeWater: {false, true})
+        {
+            gGameMap.GetHeightAtPositions(columnPoints.data(), (int) columnPoints.size(), heights.data(), excludeWater);
+            for (size_t ipoint = 0; ipoint < columnPoints.size(); ++ipoint)
+            {
+                const glm::vec3& currPoint = columnPoints[ipoint];
+                const float referenceHeight = GetHeightAtPositionReference(currPoint, excludeWater);
+                const float height = gGameMap.GetHeightAtPosition(currPoint, excludeWater);
+                if (height != referenceHeight || heights[ipoint] != referenceHeight)
+                {
+                    return CheckFailed("Height queries check failed at (%f, %f, %f), exclude water %d: expected %f, got %f, batched %f", 
+                        currPoint.x, currPoint.y, currPoint.z, excludeWater ? 1 : 0, referenceHeight, height, heights[ipoint]);
+                }
+            }
+        }
+    }
+
+    gConsole.LogMessage(eLogMessage_Info, "Height queries check passed");
+    return true;
+}
+
+void DebugSelfTests::BenchmarkSlopeHeights(int gridResolution)
+{
+    debug_assert(gridResolution > 0);
+
+    std::vector<unsigned char> slopeTypes;
+    std::vector<float> coordsx;
+    std::vector<float> coordsy;
+    GetSlopeSamples(gridResolution, slopeTypes, coordsx, coordsy);
+
+    const int numQueries = (int) slopeTypes.size();
+    std::vector<float> referenceHeights(numQueries);
+    std::vector<float> heights(numQueries);
+    std::vector<float> batchHeights(numQueries);
+    const double referenceTime = MeasureTime([&slopeTypes, &coordsx, &coordsy, &referenceHeights, numQueries]()
+        {
+            for (int icurr = 0; icurr < numQueries; ++icurr)
+            {
+                referenceHeights[icurr] = GameMapHelpers::GetSlopeHeightReference(slopeTypes[icurr], coordsx[icurr], coordsy[icurr]);
+            }
+        });
+    const double singleTime = MeasureTime([&slopeTypes, &coordsx, &coordsy, &heights, numQueries]()
+        {
+            for (int icurr = 0; icurr < numQueries; ++icurr)
+            {
+                heights[icurr] = GameMapHelpers::GetSlopeHeight(slopeTypes[icurr], coordsx[icurr], coordsy[icurr]);
+            }
+        });
+    const double batchTime = MeasureTime([&slopeTypes, &coordsx, &coordsy, &batchHeights, numQueries]()
+        {
+            GameMapHelpers::GetSlopeHeights(slopeTypes.data(), coordsx.data(), coordsy.data(), numQueries, batchHeights.data());
+        });
+
+    int numMismatches = 0;
+    for (int icurr = 0; icurr < numQueries; ++icurr)
+    {
+        if (!IsSameBits(heights[icurr], referenceHeights[icurr]) || !IsSameBits(batchHeights[icurr], referenceHeights[icurr]))
+        {
+            ++numMismatches;
+        }
+    }
+
+    gConsole.LogMessage(eLogMessage_Info, "Slope heights benchmark (%d queries):", numQueries);
+    LogBenchmarkTime("switch", referenceTime, numQueries);
+    LogBenchmarkTime("planes", singleTime, numQueries);
+    LogBenchmarkTime("planes batched", batchTime, numQueries);
+    if (numMismatches > 0)
+    {
+        gConsole.LogMessage(eLogMessage_Warning, "Slope heights mismatches: %d", numMismatches);
+    }
+}
+
+bool DebugSelfTests::CheckSlopeHeights(int gridResolution)
+{
+    debug_assert(gridResolution > 0);
+
+    std::vector<unsigned char> slopeTypes;
+    std::vector<float> coordsx;
+    std::vector<float> coordsy;
+    GetSlopeSamples(gridResolution, slopeTypes, coordsx, coordsy);
+
+    const int numQueries = (int) slopeTypes.size();
+    std::vector<float> batchHeights(numQueries);
+    GameMapHelpers::GetSlopeHeights(slopeTypes.data(), coordsx.data(), coordsy.data(), numQueries, batchHeights.data());
+
+    for (int icurr = 0; icurr < numQueries; ++icurr)
+    {
+        const float referenceHeight = GameMapHelpers::GetSlopeHeightReference(slopeTypes[icurr], coordsx[icurr], coordsy[icurr]);
+        const float height = GameMapHelpers::GetSlopeHeight(slopeTypes[icurr], coordsx[icurr], coordsy[icurr]);
+        if (!IsSameBits(height, referenceHeight) || !IsSameBits(batchHeights[icurr], referenceHeight))
+        {
+            return CheckFailed("Slope heights check failed for slope %d at (%f, %f): expected %f, got %f, batched %f", 
+                slopeTypes[icurr], coordsx[icurr], coordsy[icurr], referenceHeight, height, batchHeights[icurr]);
+        }
+    }
+
+    gConsole.LogMessage(eLogMessage_Info, "Slope heights check passed (%d slope types, %d points each)", 
+        MaxValidSlopeType + 1, numQueries / (MaxValidSlopeType + 1));
+    return true;
+}
+
+void DebugSelfTests::BenchmarkTraceSegments(int numSegments)
+{
+    debug_assert(numSegments > 0);
+
+    // same segments for all methods
+    std::vector<glm::vec3> origins;
+    std::vector<glm::vec3> destinations;
+    GetRandomSegments(numSegments, origins, destinations);
+
+    std::vector<MapTraceResult> referenceResults(numSegments);
+    std::vector<MapTraceResult> results(numSegments);
+    std::vector<MapTraceResult> batchResults(numSegments);
+    const double referenceTime = MeasureTime([&origins, &destinations, &referenceResults, numSegments]()
+        {
+            for (int icurr = 0; icurr < numSegments; ++icurr)
+            {
+                gGameMap.TraceSegmentInternal(origins[icurr], destinations[icurr], true, false, referenceResults[icurr]);
+            }
+        });
+    const double singleTime = MeasureTime([&origins, &destinations, &results, numSegments]()
+        {
+            for (int icurr = 0; icurr < numSegments; ++icurr)
+            {
+                gGameMap.TraceSegment(origins[icurr], destinations[icurr], results[icurr]);
+            }
+        });
+    const double batchTime = MeasureTime([&origins, &destinations, &batchResults, numSegments]()
+        {
+            gGameMap.TraceSegments(origins.data(), destinations.data(), numSegments, batchResults.data());
+        });
+
+    int numHits = 0;
+    int numMismatches = 0;
+    for (int icurr = 0; icurr < numSegments; ++icurr)
+    {
+        if (referenceResults[icurr].mHasHit)
+        {
+            ++numHits;
+        }
+        if (!IsSameTraceResult(results[icurr], referenceResults[icurr]) || !IsSameTraceResult(batchResults[icurr], referenceResults[icurr]))
+        {
+            ++numMismatches;
+        }
+    }
+
+    gConsole.LogMessage(eLogMessage_Info, "Trace segments benchmark (%d segments, %d hits):", numSegments, numHits);
+    LogBenchmarkTime("all blocks", referenceTime, numSegments);
+    LogBenchmarkTime("occupancy cells", singleTime, numSegments);
+    LogBenchmarkTime("occupancy cells batched", batchTime, numSegments);
+    if (numMismatches > 0)
+    {
+        gConsole.LogMessage(eLogMessage_Warning, "Trace segments mismatches: %d", numMismatches);
+    }
+}
+
+bool DebugSelfTests::CheckTraceSegments(int numRandomSegments)
+{
+    debug_assert(numRandomSegments >= 0);
+
+    // segments are specified in map units: x, layer, y
+    std::vector<glm::vec3> origins;
+    std::vector<glm::vec3> destinations;
+    auto AddSegment = [&origins, &destinations](const glm::vec3& origin, const glm::vec3& destination)
+    {
+        origins.push_back(Convert::MapUnitsToMeters(origin));
+        destinations.push_back(Convert::MapUnitsToMeters(destination));
+    };
+
+    // vertical segment through every map column
+    for (int tiley = 0; tiley < MAP_DIMENSIONS; ++tiley)
+    for (int tilex = 0; tilex < MAP_DIMENSIONS; ++tilex)
+    {
+        AddSegment(glm::vec3(tilex + 0.5f, MAP_LAYERS_COUNT - 0.25f, tiley + 0.5f), glm::vec3(tilex + 0.5f, 0.25f, tiley + 0.5f));
+    }
+
+    // horizontal segments along every row and column of blocks on each layer
+    const float MapEdgeStart = 0.25f;
+    const float MapEdgeEnd = MAP_DIMENSIONS - 0.25f;
+    for (int layer = 0; layer < MAP_LAYERS_COUNT; ++layer)
+    for (int itile = 0; itile < MAP_DIMENSIONS; ++itile)
+    {
+        const float height = layer + 0.5f;
+        AddSegment(glm::vec3(MapEdgeStart, height, itile + 0.5f), glm::vec3(MapEdgeEnd, height, itile + 0.5f));
+        AddSegment(glm::vec3(itile + 0.5f, height, MapEdgeEnd), glm::vec3(itile + 0.5f, height, MapEdgeStart));
+    }
+
+    GetRandomSegments(numRandomSegments, origins, destinations);
+
+    const int numSegments = (int) origins.size();
+    std::vector<MapTraceResult> batchResults(numSegments);
+    for (bool excludeWater: {false, true})
+    {
+        gGameMap.TraceSegments(origins.data(), destinations.data(), numSegments, batchResults.data(), excludeWater);
+        for (int icurr = 0; icurr < numSegments; ++icurr)
+        {
+            MapTraceResult referenceResult;
+            MapTraceResult result;
+            gGameMap.TraceSegmentInternal(origins[icurr], destinations[icurr], excludeWater, false, referenceResult);
+            gGameMap.TraceSegment(origins[icurr], destinations[icurr], result, excludeWater);
+            if (!IsSameTraceResult(result, referenceResult) || !IsSameTraceResult(batchResults[icurr], referenceResult))
+            {
+                return CheckFailed("Trace segments check failed on segment %d (%f, %f, %f) - (%f, %f, %f), exclude water %d: "
+                    "expected hit %d (%d, %d, %d), got hit %d (%d, %d, %d), batched hit %d (%d, %d, %d)", icurr, 
+                    origins[icurr].x, origins[icurr].y, origins[icurr].z, destinations[icurr].x, destinations[icurr].y, destinations[icurr].z,
+                    excludeWater ? 1 : 0,
+                    referenceResult.mHasHit ? 1 : 0, referenceResult.mHitBlock.x, referenceResult.mHitBlock.y, referenceResult.mHitBlock.z,
+                    result.mHasHit ? 1 : 0, result.mHitBlock.x, result.mHitBlock.y, result.mHitBlock.z,
+                    batchResults[icurr].mHasHit ? 1 : 0, batchResults[icurr].mHitBlock.x, batchResults[icurr].mHitBlock.y, batchResults[icurr].mHitBlock.z);
+            }
+        }
+    }
+
+    gConsole.LogMessage(eLogMessage_Info, "Trace segments check passed (%d segments)", numSegments);
+    return true;
+}
+
+void DebugSelfTests::BenchmarkSpritesSorting(int numSprites, int numIterations)
+{
+    debug_assert(numSprites > 0 && numIterations > 0);
+
+    // textures are only compared while sorting and never accessed, so fake pointers are fine
+    const int NumTextures = 4;
+    GpuTexture2D* textures[NumTextures];
+    for (int itexture = 0; itexture < NumTextures; ++itexture)
+    {
+        textures[itexture] = reinterpret_cast<GpuTexture2D*>((uintptr_t) (itexture + 1) * 64);
+    }
+
+    // most sprites come from objects spritesheet, heights are quantized so there are many ties
+    cxx::randomizer random (0);
+    std::vector<Sprite2D> sourceSprites(numSprites);
+    for (Sprite2D& currSprite: sourceSprites)
+    {
+        currSprite.mHeight = random.generate_int(0, 95) / 16.0f;
+        currSprite.mDrawOrder = (eSpriteDrawOrder) random.generate_int(eSpriteDrawOrder_Background, eSpriteDrawOrder_Foreground);
+        currSprite.mTexture = textures[random.random_chance(80) ? 0 : random.generate_int(1, NumTextures - 1)];
+    }
+
+    auto CountBatches = [](const std::vector<Sprite2D>& sprites)
+    {
+        int numBatches = 1;
+        for (size_t isprite = 1; isprite < sprites.size(); ++isprite)
+        {
+            if (sprites[isprite].mTexture != sprites[isprite - 1].mTexture)
+            {
+                ++numBatches;
+            }
+        }
+        return numBatches;
+    };
+
+    auto CountMisordered = [](const std::vector<Sprite2D>& sprites)
+    {
+        int numMisordered = 0;
+        for (size_t isprite = 1; isprite < sprites.size(); ++isprite)
+        {
+            const Sprite2D& prev = sprites[isprite - 1];
+            const Sprite2D& curr = sprites[isprite];
+            if ((prev.mHeight > curr.mHeight) || (prev.mHeight == curr.mHeight && prev.mDrawOrder > curr.mDrawOrder))
+            {
+                ++numMisordered;
+            }
+        }
+        return numMisordered;
+    };
+
+    // sprites get copied before each sort, copying is not measured
+    SpriteDrawList drawList;
+    const eSpritesSortMode sortMode = eSpritesSortMode_HeightAndDrawOrder;
+
+    double referenceTime = 0.0;
+    for (int iiteration = 0; iiteration < numIterations; ++iiteration)
+    {
+        drawList.mSprites = sourceSprites;
+        referenceTime += MeasureTime([&drawList, sortMode]()
+            {
+                SortSpritesReference(drawList.mSprites, sortMode);
+            });
+    }
+    const int referenceBatches = CountBatches(drawList.mSprites);
+    const int referenceMisordered = CountMisordered(drawList.mSprites);
+
+    double radixTime = 0.0;
+    for (int iiteration = 0; iiteration < numIterations; ++iiteration)
+    {
+        drawList.mSprites = sourceSprites;
+        radixTime += MeasureTime([&drawList, sortMode]()
+            {
+                drawList.SortSprites(sortMode);
+            });
+    }
+    const int numBatches = CountBatches(drawList.mSprites);
+    const int numMisordered = CountMisordered(drawList.mSprites);
+
+    gConsole.LogMessage(eLogMessage_Info, "Sprites sorting benchmark (%d sprites, %d iterations):", numSprites, numIterations);
+    LogBenchmarkTime("comparison sort", referenceTime, numIterations);
+    LogBenchmarkTime("radix sort", radixTime, numIterations);
+    gConsole.LogMessage(eLogMessage_Info, "Sprites sorting batches: comparison %d, radix %d", referenceBatches, numBatches);
+    if (referenceMisordered > 0 || numMisordered > 0)
+    {
+        gConsole.LogMessage(eLogMessage_Warning, "Sprites sorting misordered: comparison %d, radix %d", referenceMisordered, numMisordered);
+    }
+}
+
+void DebugSelfTests::BenchmarkMapLoading(const std::string& filename, int numIterations)
+{
+    debug_assert(numIterations > 0);
+
+    enum { LoadMode_Stream, LoadMode_Mapped, LoadMode_Cached, LoadMode_COUNT };
+    const char* loadModeNames[LoadMode_COUNT] = 
+    {
+        "stream", 
+        "mapped", 
+        "cached",
+    };
+
+    // each method decodes into its own scratch storage, live map data stays untouched
+    GameMapChunks mapChunks[LoadMode_COUNT];
+    std::vector<StartupObjectPosStruct> startupObjects[LoadMode_COUNT];
+    std::vector<MapHeightfieldCell> heightfield[GameMapManager::HeightfieldVariantsCount];
+
+    auto LoadCityScape = [&filename, &mapChunks, &startupObjects, &heightfield](int loadMode) -> bool
+    {
+        int styleNumber = 0;
+        if (loadMode == LoadMode_Stream)
+            return gGameMap.ReadCityScapeStream(filename, mapChunks[loadMode], startupObjects[loadMode], styleNumber);
+
+        cxx::mapped_file mappedFile;
+        if (!gFiles.MapBinaryFile(filename, mappedFile))
+            return false;
+
+        if (loadMode == LoadMode_Mapped)
+        {
+            return gGameMap.DecodeCityScapeData(filename, mappedFile.get_data(), mappedFile.get_size(), 
+                mapChunks[loadMode], startupObjects[loadMode], styleNumber);
+        }
+        std::string cachePath;
+        if (!gGameMap.GetMapCachePath(filename, cachePath))
+            return false;
+
+        const unsigned long long sourceHash = GameMapManager::ComputeDataHash(mappedFile.get_data(), mappedFile.get_size());
+        return gGameMap.ReadMapCache(cachePath, sourceHash, mapChunks[loadMode], heightfield, startupObjects[loadMode], styleNumber);
+    };
+
+    double loadingTime[LoadMode_COUNT] = {};
+    bool isLoaded[LoadMode_COUNT] = {};
+    for (int imode = 0; imode < LoadMode_COUNT; ++imode)
+    {
+        // first run warms up os file cache so all methods are measured in the same conditions
+        isLoaded[imode] = LoadCityScape(imode);
+        if (!isLoaded[imode])
+            continue;
+
+        loadingTime[imode] = MeasureTime([&LoadCityScape, imode, numIterations]()
+            {
+                for (int icurr = 0; icurr < numIterations; ++icurr)
+                {
+                    LoadCityScape(imode);
+                }
+            });
+    }
+
+    gConsole.LogMessage(eLogMessage_Info, "Map loading benchmark '%s' (%d iterations):", filename.c_str(), numIterations);
+    for (int imode = 0; imode < LoadMode_COUNT; ++imode)
+    {
+        if (isLoaded[imode])
+        {
+            LogBenchmarkTime(loadModeNames[imode], loadingTime[imode], numIterations);
+        }
+        else
+        {
+            gConsole.LogMessage(eLogMessage_Warning, " - %s: failed", loadModeNames[imode]);
+        }
+    }
+
+    // all methods must produce exactly the same data as reference stream decoder
+    for (int imode = LoadMode_Stream + 1; imode < LoadMode_COUNT; ++imode)
+    {
+        if (!isLoaded[LoadMode_Stream] || !isLoaded[imode])
+            continue;
+
+        if (!IsSameMapChunks(mapChunks[LoadMode_Stream], mapChunks[imode]) || startupObjects[LoadMode_Stream] != startupObjects[imode])
+        {
+            gConsole.LogMessage(eLogMessage_Warning, "Map loading benchmark: %s data differs from stream data", loadModeNames[imode]);
+        }
+    }
+}
+
+bool DebugSelfTests::CheckMapCache()
+{
+    std::string cachePath;
+    if (gGameMap.mMapFileName.empty() || !gGameMap.GetMapCachePath(gGameMap.mMapFileName, cachePath))
+    {
+        gConsole.LogMessage(eLogMessage_Warning, "Map cache check requires loaded map and cache directory");
+        return false;
+    }
+
+    // current data goes to separate file, so actual cache of map stays intact
+    const std::string checkCachePath = cachePath + ".check";
+    const unsigned long long CheckSourceHash = 0x0123456789ABCDEFULL;
+    const int CheckStyleNumber = 42;
+    if (!gGameMap.WriteMapCache(checkCachePath, CheckSourceHash, CheckStyleNumber))
+        return false;
+
+    GameMapChunks mapChunks;
+    std::vector<MapHeightfieldCell> heightfield[GameMapManager::HeightfieldVariantsCount];
+    std::vector<StartupObjectPosStruct> startupObjects;
+    int styleNumber = 0;
+    const bool isRead = gGameMap.ReadMapCache(checkCachePath, CheckSourceHash, mapChunks, heightfield, startupObjects, styleNumber);
+    std::remove(checkCachePath.c_str());
+
+    if (!isRead)
+        return CheckFailed("Map cache check failed: cannot read written cache");
+
+    if (styleNumber != CheckStyleNumber)
+        return CheckFailed("Map cache check failed: style number differs");
+
+    for (int tiley = 0; tiley < MAP_DIMENSIONS; ++tiley)
+    for (int tilex = 0; tilex < MAP_DIMENSIONS; ++tilex)
+    {
+        for (int tilez = 0; tilez < MAP_LAYERS_COUNT; ++tilez)
+        {
+            if (*mapChunks.GetBlock(tilex, tiley, tilez) != *gGameMap.mMapChunks.GetBlock(tilex, tiley, tilez))
+                return CheckFailed("Map cache check failed: block (%d, %d, %d) differs", tilex, tiley, tilez);
+        }
+    }
+
+    for (int ivariant = 0; ivariant < GameMapManager::HeightfieldVariantsCount; ++ivariant)
+    {
+        for (int icell = 0; icell < GameMapManager::BlocksAttributesCount; ++icell)
+        {
+            const MapHeightfieldCell& cachedCell = heightfield[ivariant][icell];
+            const MapHeightfieldCell& currentCell = gGameMap.mHeightfield[ivariant][icell];
+            if (cachedCell.mHeight != currentCell.mHeight || cachedCell.mSlopeType != currentCell.mSlopeType)
+                return CheckFailed("Map cache check failed: heightfield %d cell %d differs", ivariant, icell);
+        }
+    }
+
+    if (startupObjects != gGameMap.mStartupObjects)
+        return CheckFailed("Map cache check failed: startup objects differ");
+
+    gConsole.LogMessage(eLogMessage_Info, "Map cache check passed");
+    return true;
+}
+
+bool DebugSelfTests::CheckBlockEdit(int coordx, int coordy, int layer)
+{
+    debug_assert(layer > -1 && layer < MAP_LAYERS_COUNT);
+    debug_assert(coordx > -1 && coordx < MAP_DIMENSIONS);
+    debug_assert(coordy > -1 && coordy < MAP_DIMENSIONS);
+
+    MapRenderer& mapRenderer = gRenderManager.mMapRenderer;
+
+    if (!mapRenderer.mCityMeshBufferV->IsBufferInited() || !mapRenderer.mCityMeshBufferI->IsBufferInited())
+    {
+        gConsole.LogMessage(eLogMessage_Warning, "Block edit check skipped, city mesh is not uploaded");
+        return false;
+    }
+
+    // pending modifications must not be mixed with tested one
+    if (mapRenderer.mHasDirtyChunks)
+    {
+        mapRenderer.UpdateDirtyChunks();
+    }
+
+    // empty block gets filled with nearest solid block below it, solid block gets cleared
+    const MapBlockInfo originalBlock = *gGameMap.GetBlock(coordx, coordy, layer);
+    MapBlockInfo editedBlock {};
+    if (originalBlock.mGroundType == eGroundType_Air)
+    {
+        for (int currLayer = layer - 1; currLayer > -1; --currLayer)
+        {
+            const MapBlockInfo* currBlock = gGameMap.GetBlock(coordx, coordy, currLayer);
+            if (currBlock->mGroundType != eGroundType_Air)
+            {
+                editedBlock = *currBlock;
+                break;
+            }
+        }
+        if (editedBlock.mGroundType == eGroundType_Air)
+        {
+            gConsole.LogMessage(eLogMessage_Warning, "Block edit check skipped, no solid blocks in column (%d, %d)", coordx, coordy);
+            return false;
+        }
+    }
+
+    struct ChunkRanges
+    {
+        unsigned int mVerticesStart, mVerticesCount;
+        unsigned int mIndicesStart, mIndicesCount;
+    };
+    std::vector<ChunkRanges> prevRanges(MapRenderer::BlocksBatchCount);
+    std::vector<std::pair<unsigned int, unsigned int>> verticesRanges;
+    std::vector<std::pair<unsigned int, unsigned int>> indicesRanges;
+    CityMeshData chunkMesh;
+
+    // ranges are sorted by start, non empty ones must fit in buffer and must not intersect each other
+    auto IsValidRanges = [](std::vector<std::pair<unsigned int, unsigned int>>& ranges, unsigned int capacity)
+    {
+        std::sort(ranges.begin(), ranges.end());
+        for (size_t icurr = 0; icurr < ranges.size(); ++icurr)
+        {
+            const unsigned int rangeEnd = ranges[icurr].first + ranges[icurr].second;
+            if (rangeEnd > capacity || (icurr + 1 < ranges.size() && rangeEnd > ranges[icurr + 1].first))
+                return false;
+        }
+        return true;
+    };
+
+    auto EditAndCheck = [&](const MapBlockInfo& blockInfo, const char* stepName)
+    {
+        for (int ichunk = 0; ichunk < MapRenderer::BlocksBatchCount; ++ichunk)
+        {
+            const MapRenderer::MapBlocksChunk& currChunk = mapRenderer.mMapBlocksChunks[ichunk];
+            prevRanges[ichunk] = { currChunk.mVerticesStart, currChunk.mVerticesCount, currChunk.mIndicesStart, currChunk.mIndicesCount };
+        }
+
+        gGameMap.SetBlock(coordx, coordy, layer, blockInfo);
+
+        // faces of neighbour blocks may change too, so chunks containing edited block or its neighbours are affected
+        std::vector<bool> affectedChunks(MapRenderer::BlocksBatchCount);
+        for (int ichunk = 0; ichunk < MapRenderer::BlocksBatchCount; ++ichunk)
+        {
+            const Rect mapArea = mapRenderer.GetChunkMapArea(ichunk);
+            affectedChunks[ichunk] = 
+                (coordx + 1 >= mapArea.x) && (coordx - 1 < mapArea.x + mapArea.w) &&
+                (coordy + 1 >= mapArea.y) && (coordy - 1 < mapArea.y + mapArea.h);
+            if (affectedChunks[ichunk] != mapRenderer.mMapBlocksChunks[ichunk].mIsDirty)
+            {
+                return CheckFailed("Block edit check failed on %s of block (%d, %d, %d): chunk %d dirty flag is %d, expected %d", 
+                    stepName, coordx, coordy, layer, ichunk, mapRenderer.mMapBlocksChunks[ichunk].mIsDirty ? 1 : 0, affectedChunks[ichunk] ? 1 : 0);
+            }
+        }
+
+        mapRenderer.UpdateDirtyChunks();
+
+        verticesRanges.clear();
+        indicesRanges.clear();
+        for (int ichunk = 0; ichunk < MapRenderer::BlocksBatchCount; ++ichunk)
+        {
+            const MapRenderer::MapBlocksChunk& currChunk = mapRenderer.mMapBlocksChunks[ichunk];
+            if (currChunk.mIsDirty || mapRenderer.mHasDirtyChunks)
+            {
+                return CheckFailed("Block edit check failed on %s of block (%d, %d, %d): chunk %d is still dirty", 
+                    stepName, coordx, coordy, layer, ichunk);
+            }
+
+            if (currChunk.mVerticesCount > 0)
+            {
+                verticesRanges.emplace_back(currChunk.mVerticesStart, currChunk.mVerticesCount);
+            }
+            if (currChunk.mIndicesCount > 0)
+            {
+                indicesRanges.emplace_back(currChunk.mIndicesStart, currChunk.mIndicesCount);
+            }
+
+            const ChunkRanges& prevChunk = prevRanges[ichunk];
+            if (!affectedChunks[ichunk])
+            {
+                if (currChunk.mVerticesStart != prevChunk.mVerticesStart || currChunk.mVerticesCount != prevChunk.mVerticesCount ||
+                    currChunk.mIndicesStart != prevChunk.mIndicesStart || currChunk.mIndicesCount != prevChunk.mIndicesCount)
+                {
+                    return CheckFailed("Block edit check failed on %s of block (%d, %d, %d): unaffected chunk %d ranges changed", 
+                        stepName, coordx, coordy, layer, ichunk);
+                }
+                continue;
+            }
+
+            // uploaded geometry of affected chunk must match geometry built from scratch
+            chunkMesh.Clear();
+            GameMapHelpers::BuildMapMesh(gGameMap, mapRenderer.GetChunkMapArea(ichunk), chunkMesh);
+            if (currChunk.mVerticesCount != chunkMesh.mBlocksVertices.size() || currChunk.mIndicesCount != chunkMesh.mBlocksIndices.size())
+            {
+                return CheckFailed("Block edit check failed on %s of block (%d, %d, %d): chunk %d has %u vertices and %u indices, expected %u and %u", 
+                    stepName, coordx, coordy, layer, ichunk, currChunk.mVerticesCount, currChunk.mIndicesCount,
+                    (unsigned int) chunkMesh.mBlocksVertices.size(), (unsigned int) chunkMesh.mBlocksIndices.size());
+            }
+
+            if (currChunk.mIndicesCount == 0)
+                continue;
+
+            const DrawIndex* indices = mapRenderer.mCityMeshBufferI->LockData<DrawIndex>(BufferAccess_Read, 
+                currChunk.mIndicesStart * Sizeof_DrawIndex, currChunk.mIndicesCount * Sizeof_DrawIndex);
+            if (indices == nullptr)
+            {
+                gConsole.LogMessage(eLogMessage_Warning, "Block edit check skipped, cannot read city mesh indices");
+                return false;
+            }
+            unsigned int mismatchIndex = currChunk.mIndicesCount;
+            for (unsigned int iindex = 0; iindex < currChunk.mIndicesCount; ++iindex)
+            {
+                if (indices[iindex] != (DrawIndex) (chunkMesh.mBlocksIndices[iindex] + currChunk.mVerticesStart))
+                {
+                    mismatchIndex = iindex;
+                    break;
+                }
+            }
+            mapRenderer.mCityMeshBufferI->Unlock();
+
+            if (mismatchIndex < currChunk.mIndicesCount)
+            {
+                return CheckFailed("Block edit check failed on %s of block (%d, %d, %d): chunk %d index %u differs", 
+                    stepName, coordx, coordy, layer, ichunk, mismatchIndex);
+            }
+        }
+
+        if (!IsValidRanges(verticesRanges, mapRenderer.mCityMeshVerticesAllocator.GetCapacity()) || 
+            !IsValidRanges(indicesRanges, mapRenderer.mCityMeshIndicesAllocator.GetCapacity()))
+        {
+            return CheckFailed("Block edit check failed on %s of block (%d, %d, %d): chunks ranges overlap or exceed buffers", 
+                stepName, coordx, coordy, layer);
+        }
+        return true;
+    };
+
+    if (!EditAndCheck(editedBlock, "edit") || !EditAndCheck(originalBlock, "restore"))
+    {
+        // don't leave map modified
+        gGameMap.SetBlock(coordx, coordy, layer, originalBlock);
+        return false;
+    }
+
+    gConsole.LogMessage(eLogMessage_Info, "Block edit check passed (%d, %d, %d)", coordx, coordy, layer);
+    return true;
+}
+
+void DebugSelfTests::LogBenchmarkTime(const char* methodName, double milliseconds, int numOperations)
+{
+    const double operationsPerSecond = numOperations / (std::max(milliseconds, 0.001) / 1000.0);
+    gConsole.LogMessage(eLogMessage_Info, " - %s: %.3f ms (%.0f per second)", methodName, milliseconds, operationsPerSecond);
+}
+
+bool DebugSelfTests::CheckFailed(const char* format, ...)
+{
+    char message[1024];
+    va_list vaList;
+    va_start(vaList, format);
+    vsnprintf(message, sizeof(message), format, vaList);
+    va_end(vaList);
+
+    gConsole.LogMessage(eLogMessage_Error, "%s", message);
+    debug_assert(false);
+    return false;
+}
+
+float DebugSelfTests::GetHeightAtPositionReference(const glm::vec3& position, bool excludeWater)
+{
+    // get map block position in which we are located
+    glm::ivec3 mapBlock {
+        Convert::MetersToMapUnits(position.x),
+        Convert::MetersToMapUnits(position.y) + 0.5f,
+        Convert::MetersToMapUnits(position.z)
+    };
+    float currentHeight = (float) mapBlock.y; // set current height to ground, map units
+    for (; currentHeight > 0.0f;)
+    {
+        const MapBlockInfo* blockData = gGameMap.GetBlockClamp(mapBlock.x, mapBlock.z, mapBlock.y); // y is map layer
+
+        // compute slope height
+        if (blockData->mSlopeType) 
+        {
+            // subposition within block
+            float cx = Convert::MetersToMapUnits(position.x) - mapBlock.x;
+            float cy = Convert::MetersToMapUnits(position.z) - mapBlock.z;
+
+            currentHeight += GameMapHelpers::GetSlopeHeight(blockData->mSlopeType, cx, cy);
+
+            break;
+        }
+
+        if (blockData->mGroundType == eGroundType_Air || (blockData->mGroundType == eGroundType_Water && excludeWater)) // fall through non solid block
+        {
+            currentHeight -= 1.0f;
+            mapBlock.y -= 1;
+            continue;
+        }
+
+        break; // bail out
+    }
+    return Convert::MapUnitsToMeters(currentHeight);
+}
+
+void DebugSelfTests::GetSlopeSamples(int gridResolution, std::vector<unsigned char>& slopeTypes, std::vector<float>& coordsx, std::vector<float>& coordsy)
+{
+    slopeTypes.clear();
+    coordsx.clear();
+    coordsy.clear();
+    for (int iy = 0; iy <= gridResolution; ++iy)
+    for (int ix = 0; ix <= gridResolution; ++ix)
+    {
+        for (int islope = 0; islope <= MaxValidSlopeType; ++islope)
+        {
+            slopeTypes.push_back((unsigned char) islope);
+            coordsx.push_back((float) ix / gridResolution);
+            coordsy.push_back((float) iy / gridResolution);
+        }
+    }
+}
+
+void DebugSelfTests::GetRandomSegments(int numSegments, std::vector<glm::vec3>& origins, std::vector<glm::vec3>& destinations)
+{
+    cxx::randomizer pointsRand;
+    for (int icurr = 0; icurr < numSegments; ++icurr)
+    {
+        glm::vec3 points[2];
+        for (glm::vec3& currPoint: points)
+        {
+            currPoint.x = Convert::MapUnitsToMeters(pointsRand.generate_float() * MAP_DIMENSIONS);
+            currPoint.y = Convert::MapUnitsToMeters(pointsRand.generate_float() * MAP_LAYERS_COUNT);
+            currPoint.z = Convert::MapUnitsToMeters(pointsRand.generate_float() * MAP_DIMENSIONS);
+        }
+        origins.push_back(points[0]);
+        destinations.push_back(points[1]);
+    }
+}
+
+bool DebugSelfTests::IsSameTraceResult(const MapTraceResult& lhs, const MapTraceResult& rhs)
+{
+    return lhs.mHasHit == rhs.mHasHit && (!lhs.mHasHit || lhs.mHitBlock == rhs.mHitBlock);
+}
+
+bool DebugSelfTests::IsSameMapChunks(const GameMapChunks& lhs, const GameMapChunks& rhs)
+{
+    for (int tiley = 0; tiley < MAP_DIMENSIONS; ++tiley)
+    for (int tilex = 0; tilex < MAP_DIMENSIONS; ++tilex)
+    {
+        for (int tilez = 0; tilez < MAP_LAYERS_COUNT; ++tilez)
+        {
+            if (*lhs.GetBlock(tilex, tiley, tilez) != *rhs.GetBlock(tilex, tiley, tilez))
+                return false;
+        }
+    }
+    return true;
+}
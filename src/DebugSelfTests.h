@@ -0,0 +1,111 @@
+#pragma once
+
+struct MapTraceResult;
+class GameMapChunks;
+
+// benchmarks and self checks of optimized game subsystems, they are run from cheats window,
+// optimized implementations are compared against reference ones and results are printed to console
+class DebugSelfTests final
+{
+public:
+    // Measure GetHeightAtPosition and GetHeightAtPositions performance on random map points and compare it against 
+    // reference implementation which reads full blocks data
+    // @param numQueries: Number of height queries per each method
+    static void BenchmarkHeightQueries(int numQueries);
+
+    // Compare GetHeightAtPosition and GetHeightAtPositions against reference implementation at sample points 
+    // inside every block of map, both with and without water, stops on first mismatch
+    // @returns false if heights differ from reference heights
+    static bool CheckHeightQueries();
+
+    // Measure slope height computation performance with planes table, batched computation and reference implementation
+    // on sample grid over all slope types
+    // @param gridResolution: Number of grid cells per block side
+    static void BenchmarkSlopeHeights(int gridResolution);
+
+    // Compare planes table and batched computation with reference implementation for all slope types on sample grid, 
+    // stops on first mismatch
+    // @param gridResolution: Number of grid cells per block side
+    // @returns false if heights are not bit-exact with reference heights
+    static bool CheckSlopeHeights(int gridResolution);
+
+    // Measure TraceSegment and TraceSegments throughput on random segments across whole map and compare it against
+    // trace which visits every block
+    // @param numSegments: Number of segments per each method
+    static void BenchmarkTraceSegments(int numSegments);
+
+    // Compare TraceSegment and TraceSegments against trace which visits every block on vertical segments through all 
+    // map columns, horizontal segments along all rows and columns of each layer and random segments, both with and 
+    // without water, stops on first mismatch
+    // @param numRandomSegments: Number of additional random segments
+    // @returns false if hit results differ from reference results
+    static bool CheckTraceSegments(int numRandomSegments);
+
+    // Measure sprites sorting with radix sort against comparison sort
+    // @param numSprites: Number of randomly generated sprites
+    // @param numIterations: Number of sorts per method
+    static void BenchmarkSpritesSorting(int numSprites, int numIterations);
+
+    // Measure decoding time of city scape data using stream, memory mapped file and cache and compare decoded data,
+    // data is decoded into scratch storage, currently loaded map stays untouched
+    // @param filename: Target file name
+    // @param numIterations: Number of loads per each method
+    static void BenchmarkMapLoading(const std::string& filename, int numIterations);
+
+    // Write decoded data of currently loaded map to temporary cache file, read it back and compare with current data,
+    // stops on first mismatch
+    // @returns false if cached data differs from current data
+    static bool CheckMapCache();
+
+    // Edit map block, rebuild dirty city mesh chunks and verify that only chunks containing the block or its neighbours
+    // got new geometry which matches geometry built from scratch, then restore the block and verify again,
+    // stops on first mismatch
+    // Empty block gets filled with nearest solid block below it, solid block gets cleared
+    // @param coordx, coordy, layer: Map block coordinates
+    // @returns false if chunks ranges or geometry are wrong
+    static bool CheckBlockEdit(int coordx, int coordy, int layer);
+
+private:
+    // Run benchmarked method once and measure its execution time
+    // @param method: Benchmarked code
+    // @returns elapsed time, milliseconds
+    template<typename TMethod>
+    static double MeasureTime(TMethod method)
+    {
+        auto startTime = std::chrono::high_resolution_clock::now();
+        method();
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - startTime;
+        return elapsed.count();
+    }
+
+    // Print timing of benchmarked method to console
+    // @param methodName: Method description
+    // @param milliseconds: Elapsed time
+    // @param numOperations: Number of operations done within elapsed time
+    static void LogBenchmarkTime(const char* methodName, double milliseconds, int numOperations);
+
+    // Print check failure details to console and break into debugger
+    // @param format: Message format string
+    // @returns false
+    static bool CheckFailed(const char* format, ...);
+
+    // reference height query implementation, reads full blocks data
+    static float GetHeightAtPositionReference(const glm::vec3& position, bool excludeWater);
+
+    // Fill sample grid over all valid slope types, block edges included, slope types alternate within each grid point
+    // so batched computation mixes different planes in each group
+    // @param gridResolution: Number of grid cells per block side
+    // @param slopeTypes, coordsx, coordsy: Output samples
+    static void GetSlopeSamples(int gridResolution, std::vector<unsigned char>& slopeTypes, std::vector<float>& coordsx, std::vector<float>& coordsy);
+
+    // Append segments with both ends at random map points
+    // @param numSegments: Number of segments
+    // @param origins, destinations: Output segments ends, meters
+    static void GetRandomSegments(int numSegments, std::vector<glm::vec3>& origins, std::vector<glm::vec3>& destinations);
+
+    // Test whether trace results hit the same block, hit position is not compared
+    static bool IsSameTraceResult(const MapTraceResult& lhs, const MapTraceResult& rhs);
+
+    // Test whether both maps have same blocks in all cells, palette order does not matter
+    static bool IsSameMapChunks(const GameMapChunks& lhs, const GameMapChunks& rhs);
+};
@@ -29,6 +29,7 @@ void FileSystem::Deinit()
     mExecutablePath.clear();
     mWorkingDirectoryPath.clear();
     mGTADataDirectoryPath.clear();
+    mCacheDirectoryPath.clear();
     mGameMapsList.clear();
 }
 
@@ -78,6 +79,17 @@ bool FileSystem::OpenTextFile(const std::string& objectName, std::ifstream& inst
     return instream.is_open();
 }
 
+bool FileSystem::MapBinaryFile(const std::string& objectName, cxx::mapped_file& mappedFile)
+{
+    mappedFile.close();
+
+    std::string pathBuffer;
+    if (!GetFullPathToFile(objectName, pathBuffer))
+        return false;
+
+    return mappedFile.open(pathBuffer);
+}
+
 bool FileSystem::IsDirectoryExists(const std::string& objectName)
 {
     if (cxx::is_absolute_path(objectName))
@@ -111,6 +123,30 @@ bool FileSystem::IsFileExists(const std::string& objectName)
     return false;
 }
 
+bool FileSystem::ReadBinaryFile(const std::string& objectName, std::vector<unsigned char>& output)
+{
+    output.clear();
+
+    std::ifstream fileStream;
+    if (!OpenBinaryFile(objectName, fileStream))
+        return false;
+
+    fileStream.seekg(0, std::ios::end);
+    std::streamoff fileLength = fileStream.tellg();
+    fileStream.seekg(0, std::ios::beg);
+
+    if (fileLength < 1)
+        return false;
+
+    output.resize(static_cast<size_t>(fileLength));
+    if (!fileStream.read(reinterpret_cast<char*>(output.data()), fileLength))
+    {
+        output.clear();
+        return false;
+    }
+    return true;
+}
+
 bool FileSystem::ReadTextFile(const std::string& objectName, std::string& output)
 {
     output.clear();
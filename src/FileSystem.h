@@ -8,6 +8,7 @@ public:
     std::string mExecutablePath;
     std::string mWorkingDirectoryPath;
     std::string mGTADataDirectoryPath;
+    std::string mCacheDirectoryPath;
     std::vector<std::string> mSearchPlaces;
 
     std::vector<std::string> mGameMapsList;
@@ -32,10 +33,20 @@ public:
     bool OpenBinaryFile(const std::string& objectName, std::ifstream& instream);
     bool OpenTextFile(const std::string& objectName, std::ifstream& instream);
 
+    // Map binary file content into memory for reading operations
+    // @param objectName: File name
+    // @param mappedFile: Output mapped file
+    bool MapBinaryFile(const std::string& objectName, cxx::mapped_file& mappedFile);
+
     // Load whole text file content to std string
     // @param objectName: File name
     // @param output: Content
     bool ReadTextFile(const std::string& objectName, std::string& output);
+
+    // Load whole binary file content
+    // @param objectName: File name
+    // @param output: Content
+    bool ReadBinaryFile(const std::string& objectName, std::vector<unsigned char>& output);
     
     // Load json config document
     bool ReadConfig(const std::string& jsonName, cxx::json_document& output);
@@ -140,6 +140,67 @@ bool GameCamera::CastRayFromScreenPoint(const glm::ivec2& screenCoordinate, cxx:
     return true;
 }
 
+bool GameCamera::GetVisibleArea(float minHeight, float maxHeight, glm::vec2& outMin, glm::vec2& outMax) const
+{
+    debug_assert(minHeight <= maxHeight);
+
+    // frustum corners, bits of index select right, top and far sides
+    const glm::mat4 inverseViewProjection = glm::inverse(mViewProjectionMatrix);
+    glm::vec3 corners[8];
+    for (int icorner = 0; icorner < 8; ++icorner)
+    {
+        const glm::vec4 clipPoint {
+            (icorner & 1) ? 1.0f : -1.0f,
+            (icorner & 2) ? 1.0f : -1.0f,
+            (icorner & 4) ? 1.0f : -1.0f, 1.0f };
+        const glm::vec4 worldPoint = inverseViewProjection * clipPoint;
+        corners[icorner] = glm::vec3(worldPoint) / worldPoint.w;
+    }
+
+    // clip each frustum edge by heights range, remaining parts of edges bound visible area
+    bool hasPoints = false;
+    auto AddPoint = [&outMin, &outMax, &hasPoints](const glm::vec3& point)
+    {
+        const glm::vec2 point2 { point.x, point.z };
+        outMin = hasPoints ? glm::min(outMin, point2) : point2;
+        outMax = hasPoints ? glm::max(outMax, point2) : point2;
+        hasPoints = true;
+    };
+    for (int icorner = 0; icorner < 8; ++icorner)
+    {
+        for (int iside = 1; iside < 8; iside <<= 1)
+        {
+            if (icorner & iside)
+                continue;
+
+            const glm::vec3& startPoint = corners[icorner];
+            const glm::vec3 edge = corners[icorner | iside] - startPoint;
+            float tmin = 0.0f;
+            float tmax = 1.0f;
+            if (fabs(edge.y) > 0.0f)
+            {
+                float tlower = (minHeight - startPoint.y) / edge.y;
+                float tupper = (maxHeight - startPoint.y) / edge.y;
+                if (tlower > tupper)
+                {
+                    std::swap(tlower, tupper);
+                }
+                tmin = std::max(tmin, tlower);
+                tmax = std::min(tmax, tupper);
+            }
+            else if (startPoint.y < minHeight || startPoint.y > maxHeight)
+                continue;
+
+            if (tmin > tmax)
+                continue;
+
+            AddPoint(startPoint + edge * tmin);
+            AddPoint(startPoint + edge * tmax);
+        }
+    }
+    return hasPoints;
+}
+
 void GameCamera::SetTopDownOrientation()
 {
     mFrontDirection = -SceneAxisY;
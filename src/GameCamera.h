@@ -89,6 +89,13 @@ public:
     // @param resultRay: Output ray info
     bool CastRayFromScreenPoint(const glm::ivec2& screenCoordinate, cxx::ray3d_t& resultRay);
 
+    // Compute area on horizontal plane covered by part of frustum that lies between specified heights,
+    // make sure to ComputeMatricesAndFrustum
+    // @param minHeight, maxHeight: Heights range
+    // @param outMin, outMax: Output area bounds, x and z world coordinates
+    // @returns false if nothing between specified heights can be seen
+    bool GetVisibleArea(float minHeight, float maxHeight, glm::vec2& outMin, glm::vec2& outMax) const;
+
     // Will swap Z and Y direction vectors
     void SetTopDownOrientation();
 
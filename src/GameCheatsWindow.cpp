@@ -6,6 +6,7 @@
 #include "CarnageGame.h"
 #include "Pedestrian.h"
 #include "TimeManager.h"
+#include "DebugSelfTests.h"
 
 namespace ImGui
 {
@@ -42,6 +43,15 @@ void GameCheatsWindow::DoUI(ImGuiIO& imguiContext)
         return;
     }
 
+    // game data is not accessible until loading is done
+    if (gCarnageGame.IsLoading())
+    {
+        ImGui::Text("Loading map...");
+        ImGui::ProgressBar(gCarnageGame.GetLoadingProgress(), ImVec2(200.0f, 0.0f));
+        ImGui::End();
+        return;
+    }
+
     Pedestrian* playerChar = gCarnageGame.mHumanSlot[0].mCharPedestrian;
 
     if (ImGui::BeginMenuBar())
@@ -95,8 +105,16 @@ void GameCheatsWindow::DoUI(ImGuiIO& imguiContext)
 
     ImGui::HorzSpacing();
     ImGui::TextColored(ImVec4(1.0f, 1.0f, 0.0f, 1.0f), "Frame Time: %.3f ms (%.1f FPS)", 1000.0f / io.Framerate, io.Framerate);
-    ImGui::Text("Map chunks drawn: %d", gRenderManager.mMapRenderer.mRenderStats.mBlockChunksDrawnCount);
+    ImGui::Text("Map chunks drawn: %d (%d draw calls, %u triangles)", gRenderManager.mMapRenderer.mRenderStats.mBlockChunksDrawnCount,
+        gRenderManager.mMapRenderer.mRenderStats.mCityMeshDrawCallsCount,
+        gRenderManager.mMapRenderer.mRenderStats.mCityMeshTrianglesDrawnCount);
     ImGui::Text("Sprites drawn: %d", gRenderManager.mMapRenderer.mRenderStats.mSpritesDrawnCount);
+    ImGui::Text("City mesh build: %.2f ms", gRenderManager.mMapRenderer.mRenderStats.mCityMeshBuildTime);
+    ImGui::Text("City mesh triangles: %u (%u before optimization), %u KB", 
+        gRenderManager.mMapRenderer.mRenderStats.mCityMeshTrianglesCount, 
+        gRenderManager.mMapRenderer.mRenderStats.mCityMeshSourceTrianglesCount,
+        gRenderManager.mMapRenderer.mRenderStats.mCityMeshMemoryUsage / 1024);
+    ImGui::Text("City mesh chunks updated: %d", gRenderManager.mMapRenderer.mRenderStats.mCityMeshChunksUpdatedCount);
     
     // pedestrian stats
     if (playerChar)
@@ -199,6 +217,7 @@ void GameCheatsWindow::DoUI(ImGuiIO& imguiContext)
         ImGui::Checkbox("Draw pedestrians", &mEnableDrawPedestrians);
         ImGui::Checkbox("Draw vehicles", &mEnableDrawVehicles);
         ImGui::Checkbox("Draw city mesh", &mEnableDrawCityMesh);
+        ImGui::Checkbox("City mesh multi draw", &mEnableCityMeshMultiDraw);
     }
 
     if (ImGui::CollapsingHeader("Ped"))
@@ -282,6 +301,59 @@ void GameCheatsWindow::DoUI(ImGuiIO& imguiContext)
         }
     }
 
+    if (ImGui::CollapsingHeader("Benchmarks"))
+    {
+        if (ImGui::Button("Map loading"))
+        {
+            DebugSelfTests::BenchmarkMapLoading(gGameMap.mMapFileName, 50);
+        }
+        if (ImGui::Button("Height queries"))
+        {
+            DebugSelfTests::BenchmarkHeightQueries(1000000);
+        }
+        if (ImGui::Button("Slope heights"))
+        {
+            DebugSelfTests::BenchmarkSlopeHeights(256);
+        }
+        if (ImGui::Button("Trace segments"))
+        {
+            DebugSelfTests::BenchmarkTraceSegments(100000);
+        }
+        if (ImGui::Button("Sprites sorting"))
+        {
+            DebugSelfTests::BenchmarkSpritesSorting(16384, 100);
+        }
+    }
+
+    if (ImGui::CollapsingHeader("Self checks"))
+    {
+        if (ImGui::Button("Map cache"))
+        {
+            DebugSelfTests::CheckMapCache();
+        }
+        if (ImGui::Button("Height queries##check"))
+        {
+            DebugSelfTests::CheckHeightQueries();
+        }
+        if (ImGui::Button("Slope heights##check"))
+        {
+            DebugSelfTests::CheckSlopeHeights(255);
+        }
+        if (ImGui::Button("Trace segments##check"))
+        {
+            DebugSelfTests::CheckTraceSegments(20000);
+        }
+        if (playerChar && ImGui::Button("Block edit##check"))
+        {
+            // block right under player feet
+            glm::vec3 pos = Convert::MetersToMapUnits(playerChar->mPhysicsBody->GetPosition());
+            DebugSelfTests::CheckBlockEdit(
+                glm::clamp((int) pos.x, 0, MAP_DIMENSIONS - 1), 
+                glm::clamp((int) pos.z, 0, MAP_DIMENSIONS - 1), 
+                glm::clamp((int) pos.y, 0, MAP_LAYERS_COUNT - 1));
+        }
+    }
+
     ImGui::End();
 }
 
@@ -14,6 +14,7 @@ public:
     bool mEnableDrawPedestrians = true;
     bool mEnableDrawVehicles = true;
     bool mEnableDrawCityMesh = true;
+    bool mEnableCityMeshMultiDraw = true; // submit visible city mesh chunks with single draw call
 
 public:
     GameCheatsWindow();
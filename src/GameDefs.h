@@ -15,6 +15,7 @@
 // map width and height is same
 #define MAP_DIMENSIONS 256
 #define MAP_LAYERS_COUNT 6
+#define MAP_CHUNK_DIMENSIONS 32 // map blocks storage chunk width and height
 
 #define PIXELS_PER_MAP_UNIT (MAP_BLOCK_TEXTURE_DIMS)
 #define METERS_PER_MAP_UNIT (4.0f)
@@ -338,6 +339,44 @@ struct MapBlockInfo
     bool mFlipTopBottomFaces : 1;
     bool mFlipLeftRightFaces : 1;
     bool mIsRailway : 1;
+
+public:
+    // compare blocks field by field, padding bytes are not taken into account
+    // @returns negative, zero or positive value, like memcmp
+    inline int Compare(const MapBlockInfo& rhs) const
+    {
+        static_assert(eBlockFace_COUNT == 5, "Block faces count changed");
+        const int fieldsDiffs[] =
+        {
+            mRemap - rhs.mRemap,
+            (int) mGroundType - (int) rhs.mGroundType,
+            (int) mLidRotation - (int) rhs.mLidRotation,
+            mTrafficLight - rhs.mTrafficLight,
+            mFaces[eBlockFace_W] - rhs.mFaces[eBlockFace_W],
+            mFaces[eBlockFace_E] - rhs.mFaces[eBlockFace_E],
+            mFaces[eBlockFace_N] - rhs.mFaces[eBlockFace_N],
+            mFaces[eBlockFace_S] - rhs.mFaces[eBlockFace_S],
+            mFaces[eBlockFace_Lid] - rhs.mFaces[eBlockFace_Lid],
+            mSlopeType - rhs.mSlopeType,
+            (int) mUpDirection - (int) rhs.mUpDirection,
+            (int) mDownDirection - (int) rhs.mDownDirection,
+            (int) mLeftDirection - (int) rhs.mLeftDirection,
+            (int) mRightDirection - (int) rhs.mRightDirection,
+            (int) mIsFlat - (int) rhs.mIsFlat,
+            (int) mFlipTopBottomFaces - (int) rhs.mFlipTopBottomFaces,
+            (int) mFlipLeftRightFaces - (int) rhs.mFlipLeftRightFaces,
+            (int) mIsRailway - (int) rhs.mIsRailway,
+        };
+        for (int currDiff: fieldsDiffs)
+        {
+            if (currDiff != 0)
+                return currDiff;
+        }
+        return 0;
+    }
+    inline bool operator == (const MapBlockInfo& rhs) const { return Compare(rhs) == 0; }
+    inline bool operator != (const MapBlockInfo& rhs) const { return Compare(rhs) != 0; }
+    inline bool operator < (const MapBlockInfo& rhs) const { return Compare(rhs) < 0; }
 };
 
 const unsigned int Sizeof_BlockInfo = sizeof(MapBlockInfo);
@@ -0,0 +1,144 @@
+#include "stdafx.h"
+#include "GameMapChunks.h"
+
+GameMapChunks::GameMapChunks()
+{
+    // pages table never reallocates, so it can be read while palette gets extended by edits
+    mBlocksPalettePages.reserve(MaxMapBlocksPaletteSize / MapBlocksPalettePageSize);
+    Cleanup();
+}
+
+GameMapChunks::~GameMapChunks()
+{
+    Cleanup();
+
+    for (MapBlockInfo*& currPage: mBlocksPalettePages)
+    {
+        SafeDeleteArray(currPage);
+    }
+}
+
+void GameMapChunks::Cleanup()
+{
+    for (MapBlocksChunkLayer*& currChunkLayer: mChunkLayers)
+    {
+        SafeDelete(currChunkLayer);
+    }
+
+    // keep air block only, first page stays allocated
+    for (size_t ipage = 1; ipage < mBlocksPalettePages.size(); ++ipage)
+    {
+        SafeDeleteArray(mBlocksPalettePages[ipage]);
+    }
+    mBlocksPalettePages.resize(std::min(mBlocksPalettePages.size(), (size_t) 1));
+    mBlocksPaletteSize = 0;
+
+    MapBlockInfo airBlock;
+    memset(&airBlock, 0, Sizeof_BlockInfo);
+    AppendPaletteBlock(airBlock);
+}
+
+size_t GameMapChunks::GetMemoryUsage() const
+{
+    size_t memoryUsage = sizeof(mChunkLayers) + 
+        mBlocksPalettePages.capacity() * sizeof(MapBlockInfo*) +
+        mBlocksPalettePages.size() * MapBlocksPalettePageSize * Sizeof_BlockInfo;
+    for (const MapBlocksChunkLayer* currChunkLayer: mChunkLayers)
+    {
+        if (currChunkLayer)
+        {
+            memoryUsage += sizeof(MapBlocksChunkLayer);
+        }
+    }
+    return memoryUsage;
+}
+
+MapBlocksChunkLayer* GameMapChunks::AllocateChunkLayer(int chunkx, int chunky, int layer)
+{
+    MapBlocksChunkLayer* chunkLayer = GetChunkLayer(chunkx, chunky, layer);
+    if (chunkLayer == nullptr)
+    {
+        chunkLayer = new MapBlocksChunkLayer;
+        memset(chunkLayer, 0, sizeof(MapBlocksChunkLayer));
+        mChunkLayers[(chunky * MapChunksPerSide + chunkx) * MAP_LAYERS_COUNT + layer] = chunkLayer;
+    }
+    return chunkLayer;
+}
+
+void GameMapChunks::SetBlockIndex(int coordx, int coordy, int layer, MapBlockIndex blockIndex)
+{
+    debug_assert(blockIndex < mBlocksPaletteSize);
+
+    const int chunkx = coordx / MAP_CHUNK_DIMENSIONS;
+    const int chunky = coordy / MAP_CHUNK_DIMENSIONS;
+
+    MapBlocksChunkLayer* chunkLayer = GetChunkLayer(chunkx, chunky, layer);
+    if (chunkLayer == nullptr)
+    {
+        if (blockIndex == MapBlockIndex_Air)
+            return;
+
+        chunkLayer = AllocateChunkLayer(chunkx, chunky, layer);
+    }
+    chunkLayer->mBlocks[coordy % MAP_CHUNK_DIMENSIONS][coordx % MAP_CHUNK_DIMENSIONS] = blockIndex;
+}
+
+void GameMapChunks::SetBlock(int coordx, int coordy, int layer, const MapBlockInfo& blockInfo)
+{
+    // edits are rare, so palette is searched linearly
+    MapBlockIndex blockIndex = MapBlockIndex_Air;
+    if (!IsAirBlock(blockInfo))
+    {
+        int foundIndex = 1;
+        while (foundIndex < mBlocksPaletteSize && *GetPaletteBlock((MapBlockIndex) foundIndex) != blockInfo)
+        {
+            ++foundIndex;
+        }
+        blockIndex = (foundIndex == mBlocksPaletteSize) ? AddPaletteBlock(blockInfo) : (MapBlockIndex) foundIndex;
+    }
+    SetBlockIndex(coordx, coordy, layer, blockIndex);
+}
+
+MapBlockIndex GameMapChunks::AddPaletteBlock(const MapBlockInfo& blockInfo)
+{
+    if (IsAirBlock(blockInfo))
+        return MapBlockIndex_Air;
+
+    if (mBlocksPaletteSize == MaxMapBlocksPaletteSize)
+    {
+        debug_assert(false);
+        return MapBlockIndex_Air;
+    }
+
+    return AppendPaletteBlock(blockInfo);
+}
+
+MapBlockIndex GameMapChunks::AppendPaletteBlock(const MapBlockInfo& blockInfo)
+{
+    if (mBlocksPaletteSize == (int) mBlocksPalettePages.size() * MapBlocksPalettePageSize)
+    {
+        mBlocksPalettePages.push_back(new MapBlockInfo[MapBlocksPalettePageSize]);
+    }
+
+    const MapBlockIndex blockIndex = (MapBlockIndex) mBlocksPaletteSize++;
+    mBlocksPalettePages[blockIndex / MapBlocksPalettePageSize][blockIndex % MapBlocksPalettePageSize] = blockInfo;
+    return blockIndex;
+}
+
+void GameMapChunks::SetBlocksPalette(const MapBlockInfo* blocksInfo, int blocksCount)
+{
+    debug_assert(blocksInfo && blocksCount > 0 && blocksCount <= MaxMapBlocksPaletteSize);
+    debug_assert(IsAirBlock(blocksInfo[MapBlockIndex_Air]));
+
+    // allocated pages are reused
+    mBlocksPaletteSize = 0;
+    for (int iblock = 0; iblock < blocksCount; ++iblock)
+    {
+        AppendPaletteBlock(blocksInfo[iblock]);
+    }
+}
+
+bool GameMapChunks::IsAirBlock(const MapBlockInfo& blockInfo) const
+{
+    return blockInfo == *GetPaletteBlock(MapBlockIndex_Air);
+}
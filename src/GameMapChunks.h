@@ -0,0 +1,115 @@
+#pragma once
+
+#include "GameDefs.h"
+
+// index of block data in blocks palette
+using MapBlockIndex = unsigned short;
+
+// blocks palette always starts with air block
+const MapBlockIndex MapBlockIndex_Air = 0;
+const int MaxMapBlocksPaletteSize = 65536;
+const int MapBlocksPalettePageSize = 256; // blocks per palette page
+
+const int MapChunksPerSide = MAP_DIMENSIONS / MAP_CHUNK_DIMENSIONS;
+static_assert((MAP_DIMENSIONS % MAP_CHUNK_DIMENSIONS) == 0, "Map dimensions must be multiple of chunk dimensions");
+
+// defines blocks of square map area on single layer
+struct MapBlocksChunkLayer
+{
+public:
+    MapBlockIndex mBlocks[MAP_CHUNK_DIMENSIONS][MAP_CHUNK_DIMENSIONS]; // y, x
+};
+
+// defines storage of map blocks which is split into square chunks of layers,
+// each distinct block data is stored once in palette and chunks keep 16 bit palette indices,
+// chunk layers containing only air blocks are not allocated,
+// palette is allocated by fixed size pages so blocks data never moves when it grows
+class GameMapChunks final: public cxx::noncopyable
+{
+public:
+    GameMapChunks();
+    ~GameMapChunks();
+
+    // Free all chunk layers and reset blocks palette to single air block, map becomes filled with air
+    void Cleanup();
+
+    // Get memory allocated for chunks and blocks palette, in bytes
+    size_t GetMemoryUsage() const;
+
+    // Get blocks of chunk layer
+    // @param chunkx, chunky, layer: Chunk layer location
+    // @returns null if chunk layer contains only air blocks and is not allocated
+    inline MapBlocksChunkLayer* GetChunkLayer(int chunkx, int chunky, int layer) const
+    {
+        debug_assert(chunkx > -1 && chunkx < MapChunksPerSide);
+        debug_assert(chunky > -1 && chunky < MapChunksPerSide);
+        debug_assert(layer > -1 && layer < MAP_LAYERS_COUNT);
+        return mChunkLayers[(chunky * MapChunksPerSide + chunkx) * MAP_LAYERS_COUNT + layer];
+    }
+
+    // Allocate chunk layer filled with air blocks, does nothing if it is already allocated
+    // @param chunkx, chunky, layer: Chunk layer location
+    MapBlocksChunkLayer* AllocateChunkLayer(int chunkx, int chunky, int layer);
+
+    // Get palette index of block at specified location
+    // @param coordx, coordy, layer: Block location
+    inline MapBlockIndex GetBlockIndex(int coordx, int coordy, int layer) const
+    {
+        const MapBlocksChunkLayer* chunkLayer = GetChunkLayer(coordx / MAP_CHUNK_DIMENSIONS, coordy / MAP_CHUNK_DIMENSIONS, layer);
+        if (chunkLayer == nullptr)
+            return MapBlockIndex_Air;
+
+        return chunkLayer->mBlocks[coordy % MAP_CHUNK_DIMENSIONS][coordx % MAP_CHUNK_DIMENSIONS];
+    }
+
+    // Set palette index of block at specified location, chunk layer gets allocated if needed
+    // @param coordx, coordy, layer: Block location
+    // @param blockIndex: Palette index
+    void SetBlockIndex(int coordx, int coordy, int layer, MapBlockIndex blockIndex);
+
+    // Get block data at specified location, it is shared between all blocks with same data
+    // Pointer stays valid when palette gets extended
+    // @param coordx, coordy, layer: Block location
+    inline const MapBlockInfo* GetBlock(int coordx, int coordy, int layer) const
+    {
+        return GetPaletteBlock(GetBlockIndex(coordx, coordy, layer));
+    }
+
+    // Get block data stored in palette
+    // @param blockIndex: Palette index
+    inline const MapBlockInfo* GetPaletteBlock(MapBlockIndex blockIndex) const
+    {
+        debug_assert(blockIndex < mBlocksPaletteSize);
+        return &mBlocksPalettePages[blockIndex / MapBlocksPalettePageSize][blockIndex % MapBlocksPalettePageSize];
+    }
+
+    // Set block data at specified location, palette gets extended if there is no such data in it yet
+    // @param coordx, coordy, layer: Block location
+    // @param blockInfo: Block data
+    void SetBlock(int coordx, int coordy, int layer, const MapBlockInfo& blockInfo);
+
+    // Append block data to palette without looking for duplicates
+    // @param blockInfo: Block data
+    // @returns palette index, air blocks always map to MapBlockIndex_Air
+    MapBlockIndex AddPaletteBlock(const MapBlockInfo& blockInfo);
+
+    // Replace blocks palette, first block must be air
+    // @param blocksInfo: Blocks data
+    // @param blocksCount: Number of blocks
+    void SetBlocksPalette(const MapBlockInfo* blocksInfo, int blocksCount);
+
+    // Get number of distinct blocks data in palette
+    inline int GetBlocksPaletteSize() const { return mBlocksPaletteSize; }
+
+    // Test whether block data is the same as air block, fields are compared
+    bool IsAirBlock(const MapBlockInfo& blockInfo) const;
+
+private:
+    // put block data at end of palette, new page gets allocated if last one is full
+    MapBlockIndex AppendPaletteBlock(const MapBlockInfo& blockInfo);
+
+private:
+    MapBlocksChunkLayer* mChunkLayers[MapChunksPerSide * MapChunksPerSide * MAP_LAYERS_COUNT] = {}; // row by row, layers of chunk are adjacent, null if not allocated
+    std::vector<MapBlockInfo*> mBlocksPalettePages; // each one holds MapBlocksPalettePageSize blocks
+    int mBlocksPaletteSize = 0;
+};
@@ -3,60 +3,375 @@
 #include "SpriteManager.h"
 #include "GameMapManager.h"
 
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+    #define GAME_MAP_HELPERS_SSE
+    #include <xmmintrin.h>
+#endif
+
+// slope type is stored in 6 bits
+static const int SlopeTypesCount = 64;
+
+// slope surface within block in map units: height = lerp(low, high, weightX * x + weightY * y),
+// slope goes along single axis so interpolation factor is exactly x or y and result matches reference lerp
+struct alignas(16) SlopePlane
+{
+    float mLow;
+    float mHigh;
+    float mWeightX;
+    float mWeightY; // plane fits single sse register
+};
+
+struct SlopePlanesTable
+{
+public:
+    SlopePlanesTable()
+    {
+        for (int islope = 0; islope < SlopeTypesCount; ++islope)
+        {
+            SlopePlane& plane = mPlanes[islope];
+            plane = {};
+
+            if (islope > MaxValidSlopeType)
+                continue;
+
+            // elevations at block corners are exact, slope axis is the one along which elevation changes
+            plane.mLow = GameMapHelpers::GetSlopeHeightReference(islope, 0.0f, 0.0f);
+            plane.mHigh = GameMapHelpers::GetSlopeHeightReference(islope, 1.0f, 1.0f);
+            plane.mWeightX = (GameMapHelpers::GetSlopeHeightReference(islope, 1.0f, 0.0f) != plane.mLow) ? 1.0f : 0.0f;
+            plane.mWeightY = (GameMapHelpers::GetSlopeHeightReference(islope, 0.0f, 1.0f) != plane.mLow) ? 1.0f : 0.0f;
+        }
+    }
+public:
+    SlopePlane mPlanes[SlopeTypesCount];
+};
+
+static const SlopePlanesTable SlopePlanes;
+
+inline float EvaluateSlopePlane(const SlopePlane& plane, float coord_x, float coord_y)
+{
+    return glm::lerp(plane.mLow, plane.mHigh, plane.mWeightX * coord_x + plane.mWeightY * coord_y);
+}
+
 bool GameMapHelpers::BuildMapMesh(GameMapManager& cityScape, const Rect& area, int layerIndex, CityMeshData& meshData)
 {
     debug_assert(layerIndex > -1 && layerIndex < MAP_LAYERS_COUNT);
 
-    // preallocate
-    meshData.mBlocksIndices.reserve(1 * 1024 * 1024);
-    meshData.mBlocksVertices.reserve(1 * 1024 * 1024);
+    BuildLayersMesh(cityScape, area, layerIndex, 1, meshData, nullptr);
+    return true;
+}
 
-    // prepare
+bool GameMapHelpers::BuildMapMesh(GameMapManager& cityScape, const Rect& area, CityMeshData& meshData, int* outSourceTrianglesCount)
+{
+    BuildLayersMesh(cityScape, area, 0, MAP_LAYERS_COUNT, meshData, outSourceTrianglesCount);
+    return true;
+}
+
+void GameMapHelpers::BuildLayersMesh(GameMapManager& cityScape, const Rect& area, int firstLayer, int numLayers, CityMeshData& meshData, 
+    int* outSourceTrianglesCount)
+{
+    const int baseVerticesCount = meshData.mBlocksVertices.size();
+    const int baseIndicesCount = meshData.mBlocksIndices.size();
+
+    // preallocate, one face per block of area is rough average
+    meshData.mBlocksIndices.reserve(baseIndicesCount + area.w * area.h * numLayers * 6);
+    meshData.mBlocksVertices.reserve(baseVerticesCount + area.w * area.h * numLayers * 4);
+
+    // faces group of each emitted face
+    std::vector<unsigned char> facesGroups;
+    facesGroups.reserve(area.w * area.h * numLayers);
+
+    // merge keys of visible faces, zero if there is no face or it is already emitted
+    const int blocksCount = area.w * area.h * numLayers;
+    std::vector<unsigned int> facesKeys[eBlockFace_COUNT];
+    for (std::vector<unsigned int>& currFacesKeys: facesKeys)
+    {
+        currFacesKeys.resize(blocksCount, 0);
+    }
+
+    auto BlockIndex = [&area](int tilex, int tiley, int ilayer)
+    {
+        return (ilayer * area.h + tiley) * area.w + tilex;
+    };
+
+    // drop hidden faces, faces which cannot be merged are emitted as is
+    int sourceFacesCount = 0;
+    for (int ilayer = 0; ilayer < numLayers; ++ilayer)
     for (int tiley = 0; tiley < area.h; ++tiley)
     for (int tilex = 0; tilex < area.w; ++tilex)
     {
-        if (MapBlockInfo* blockInfo = cityScape.GetBlockClamp(tilex + area.x, tiley + area.y, layerIndex))
+        const MapBlockInfo* blockInfo = cityScape.GetBlockClamp(tilex + area.x, tiley + area.y, firstLayer + ilayer);
+        for (int iface = 0; iface < eBlockFace_COUNT; ++iface)
+        {
+            if (blockInfo->mFaces[iface] == 0)
+                continue;
+
+            ++sourceFacesCount;
+
+            eBlockFace faceid = (eBlockFace) iface;
+            if (IsBlockFaceHidden(cityScape, tilex + area.x, tiley + area.y, firstLayer + ilayer, faceid, blockInfo))
+                continue;
+
+            const unsigned int mergeKey = GetBlockFaceMergeKey(faceid, blockInfo);
+            if (mergeKey == 0)
+            {
+                PutBlockFace(cityScape, meshData, tilex + area.x, tiley + area.y, firstLayer + ilayer, faceid, blockInfo);
+                facesGroups.push_back((unsigned char) GetCityMeshFacesGroup(firstLayer + ilayer, faceid));
+                continue;
+            }
+            facesKeys[iface][BlockIndex(tilex, tiley, ilayer)] = mergeKey;
+        }
+    }
+
+    if (outSourceTrianglesCount)
+    {
+        *outSourceTrianglesCount = sourceFacesCount * 2;
+    }
+
+    // greedy merge of same faces within planar slices of area,
+    // lids are merged within layer and side faces are merged along wall and across layers
+    for (int iface = 0; iface < eBlockFace_COUNT; ++iface)
+    {
+        eBlockFace faceid = (eBlockFace) iface;
+
+        // slice axes in map blocks and corresponding axes of mesh space
+        int slicesCount = numLayers;
+        int dimsA = area.w;
+        int dimsB = area.h;
+        int meshAxisA = 0; // x
+        int meshAxisB = 2; // z
+        if (faceid == eBlockFace_W || faceid == eBlockFace_E)
         {
-            for (int iface = 0; iface < eBlockFace_COUNT; ++iface)
+            slicesCount = area.w;
+            dimsA = area.h;
+            dimsB = numLayers;
+            meshAxisA = 2; // z
+            meshAxisB = 1; // y
+        }
+        else if (faceid == eBlockFace_N || faceid == eBlockFace_S)
+        {
+            slicesCount = area.h;
+            dimsA = area.w;
+            dimsB = numLayers;
+            meshAxisA = 0; // x
+            meshAxisB = 1; // y
+        }
+
+        auto SliceBlockIndex = [faceid, &BlockIndex](int islice, int coorda, int coordb)
+        {
+            if (faceid == eBlockFace_W || faceid == eBlockFace_E)
+                return BlockIndex(islice, coorda, coordb);
+
+            if (faceid == eBlockFace_N || faceid == eBlockFace_S)
+                return BlockIndex(coorda, islice, coordb);
+
+            return BlockIndex(coorda, coordb, islice);
+        };
+
+        std::vector<unsigned int>& currFacesKeys = facesKeys[iface];
+        for (int islice = 0; islice < slicesCount; ++islice)
+        for (int coordb = 0; coordb < dimsB; ++coordb)
+        for (int coorda = 0; coorda < dimsA; ++coorda)
+        {
+            const int blockIndex = SliceBlockIndex(islice, coorda, coordb);
+            const unsigned int mergeKey = currFacesKeys[blockIndex];
+            if (mergeKey == 0)
+                continue;
+
+            // grow along first axis, then add whole rows along second axis
+            int extentA = 1;
+            while (coorda + extentA < dimsA && currFacesKeys[SliceBlockIndex(islice, coorda + extentA, coordb)] == mergeKey)
             {
-                if (blockInfo->mFaces[iface] == 0)
-                    continue;
+                ++extentA;
+            }
 
-                eBlockFace faceid = (eBlockFace) iface;
-                PutBlockFace(cityScape, meshData, tilex + area.x, tiley + area.y, layerIndex, faceid, blockInfo);
+            int extentB = 1;
+            for (; coordb + extentB < dimsB; ++extentB)
+            {
+                bool isSameRow = true;
+                for (int icurr = 0; icurr < extentA && isSameRow; ++icurr)
+                {
+                    isSameRow = currFacesKeys[SliceBlockIndex(islice, coorda + icurr, coordb + extentB)] == mergeKey;
+                }
+                if (!isSameRow)
+                    break;
+            }
+
+            for (int currb = 0; currb < extentB; ++currb)
+            for (int curra = 0; curra < extentA; ++curra)
+            {
+                currFacesKeys[SliceBlockIndex(islice, coorda + curra, coordb + currb)] = 0;
+            }
+
+            // emit face of first block and stretch it over merged blocks
+            const int tilex = blockIndex % area.w;
+            const int tiley = (blockIndex / area.w) % area.h;
+            const int ilayer = blockIndex / (area.w * area.h);
+
+            const MapBlockInfo* blockInfo = cityScape.GetBlockClamp(tilex + area.x, tiley + area.y, firstLayer + ilayer);
+
+            const int baseVertexIndex = meshData.mBlocksVertices.size();
+            PutBlockFace(cityScape, meshData, tilex + area.x, tiley + area.y, firstLayer + ilayer, faceid, blockInfo);
+            facesGroups.push_back((unsigned char) GetCityMeshFacesGroup(firstLayer + ilayer, faceid));
+            if (extentA > 1 || extentB > 1)
+            {
+                StretchBlockFace(meshData, baseVertexIndex, meshAxisA, meshAxisB, extentA, extentB);
             }
         }
     }
-    return true;
+
+    // order faces by groups, each face is quad of 4 vertices and 6 indices
+    const int facesCount = facesGroups.size();
+    debug_assert(meshData.mBlocksVertices.size() == baseVerticesCount + facesCount * 4);
+    debug_assert(meshData.mBlocksIndices.size() == baseIndicesCount + facesCount * 6);
+
+    int groupsStart[CityMeshFacesGroupsCount + 1] = {};
+    for (unsigned char currGroup: facesGroups)
+    {
+        ++groupsStart[currGroup + 1];
+    }
+
+    meshData.mFacesGroupsIndicesCount.resize(CityMeshFacesGroupsCount, 0);
+    for (int igroup = 0; igroup < CityMeshFacesGroupsCount; ++igroup)
+    {
+        meshData.mFacesGroupsIndicesCount[igroup] += groupsStart[igroup + 1] * 6;
+        groupsStart[igroup + 1] += groupsStart[igroup];
+    }
+
+    const std::vector<CityVertex3D> sourceVertices(meshData.mBlocksVertices.begin() + baseVerticesCount, meshData.mBlocksVertices.end());
+    const std::vector<DrawIndex> sourceIndices(meshData.mBlocksIndices.begin() + baseIndicesCount, meshData.mBlocksIndices.end());
+    for (int iface = 0; iface < facesCount; ++iface)
+    {
+        const int destFace = groupsStart[facesGroups[iface]]++;
+        for (int ivertex = 0; ivertex < 4; ++ivertex)
+        {
+            meshData.mBlocksVertices[baseVerticesCount + destFace * 4 + ivertex] = sourceVertices[iface * 4 + ivertex];
+        }
+        for (int iindex = 0; iindex < 6; ++iindex)
+        {
+            const DrawIndex sourceIndex = sourceIndices[iface * 6 + iindex];
+            meshData.mBlocksIndices[baseIndicesCount + destFace * 6 + iindex] = sourceIndex + (destFace - iface) * 4;
+        }
+    }
 }
 
-bool GameMapHelpers::BuildMapMesh(GameMapManager& cityScape, const Rect& area, CityMeshData& meshData)
+bool GameMapHelpers::IsBlockFaceHidden(GameMapManager& cityScape, int x, int y, int z, eBlockFace face, const MapBlockInfo* blockInfo)
 {
-    // preallocate
-    meshData.mBlocksIndices.reserve(4 * 1024 * 1024);
-    meshData.mBlocksVertices.reserve(4 * 1024 * 1024);
+    // flat faces are transparent and may be drawn at opposite side of block
+    if (blockInfo->mIsFlat)
+        return false;
 
-    // prepare
-    for (int tilez = 0; tilez < MAP_LAYERS_COUNT; ++tilez)
-    for (int tiley = 0; tiley < area.h; ++tiley)
-    for (int tilex = 0; tilex < area.w; ++tilex)
+    // side of neighbour block which touches face
+    eBlockFace neighbourFace = eBlockFace_Lid;
+    switch (face)
+    {
+        case eBlockFace_W: --x; neighbourFace = eBlockFace_E; break;
+        case eBlockFace_E: ++x; neighbourFace = eBlockFace_W; break;
+        case eBlockFace_N: --y; neighbourFace = eBlockFace_S; break;
+        case eBlockFace_S: ++y; neighbourFace = eBlockFace_N; break;
+        case eBlockFace_Lid: ++z; break;
+        default: break;
+    }
+
+    // blocks outside of map are clamped copies of edge blocks, not real neighbours
+    if (x < 0 || x >= MAP_DIMENSIONS || y < 0 || y >= MAP_DIMENSIONS || z == MAP_LAYERS_COUNT)
+        return false;
+
+    const MapBlockInfo* neighbourBlock = cityScape.GetBlockClamp(x, y, z);
+    if (neighbourBlock->mGroundType != eGroundType_Building || neighbourBlock->mSlopeType != 0 || neighbourBlock->mIsFlat)
+        return false;
+
+    // face is fully covered only if neighbour is closed cube, otherwise face can be seen through its open sides
+    if (neighbourBlock->mFaces[eBlockFace_Lid] == 0)
+        return false;
+
+    if (face == eBlockFace_Lid)
+    {
+        return neighbourBlock->mFaces[eBlockFace_W] != 0 && neighbourBlock->mFaces[eBlockFace_E] != 0 && 
+            neighbourBlock->mFaces[eBlockFace_N] != 0 && neighbourBlock->mFaces[eBlockFace_S] != 0;
+    }
+    return neighbourBlock->mFaces[neighbourFace] != 0;
+}
+
+unsigned int GameMapHelpers::GetBlockFaceMergeKey(eBlockFace face, const MapBlockInfo* blockInfo)
+{
+    // geometry of slopes and flat faces is not aligned to block grid
+    if (blockInfo->mSlopeType != 0 || blockInfo->mIsFlat)
+        return 0;
+
+    // key includes everything that affects face texture mapping and color
+    unsigned int mergeKey = blockInfo->mFaces[face];
+    if (face == eBlockFace_Lid)
+    {
+        mergeKey |= (blockInfo->mLidRotation << 8) | (blockInfo->mRemap << 10);
+    }
+    else
+    {
+        mergeKey |= ((blockInfo->mFlipLeftRightFaces ? 1 : 0) << 18) | ((blockInfo->mFlipTopBottomFaces ? 1 : 0) << 19);
+    }
+    return mergeKey;
+}
+
+void GameMapHelpers::StretchBlockFace(CityMeshData& meshData, int baseVertexIndex, int axisA, int axisB, int extentA, int extentB)
+{
+    CityVertex3D* vertices = &meshData.mBlocksVertices[baseVertexIndex];
+
+    // corners of face within its plane, 0 or 1 along each axis
+    float minA = vertices[0].mPosition[axisA];
+    float minB = vertices[0].mPosition[axisB];
+    for (int ivertex = 1; ivertex < 4; ++ivertex)
     {
-        if (MapBlockInfo* blockInfo = cityScape.GetBlockClamp(tilex + area.x, tiley + area.y, tilez))
+        minA = std::min(minA, vertices[ivertex].mPosition[axisA]);
+        minB = std::min(minB, vertices[ivertex].mPosition[axisB]);
+    }
+
+    int cornersA[4];
+    int cornersB[4];
+    for (int ivertex = 0; ivertex < 4; ++ivertex)
+    {
+        cornersA[ivertex] = (vertices[ivertex].mPosition[axisA] - minA) > (METERS_PER_MAP_UNIT * 0.5f) ? 1 : 0;
+        cornersB[ivertex] = (vertices[ivertex].mPosition[axisB] - minB) > (METERS_PER_MAP_UNIT * 0.5f) ? 1 : 0;
+    }
+
+    // texture mapping over face is affine, lid rotation and flips included,
+    // so it gets extended over merged blocks and repeats per each block
+    glm::vec2 texOrigin;
+    for (int ivertex = 0; ivertex < 4; ++ivertex)
+    {
+        if (cornersA[ivertex] == 0 && cornersB[ivertex] == 0)
         {
-            for (int iface = 0; iface < eBlockFace_COUNT; ++iface)
-            {
-                if (blockInfo->mFaces[iface] == 0)
-                    continue;
+            texOrigin = glm::vec2(vertices[ivertex].mTexcoord);
+        }
+    }
 
-                eBlockFace faceid = (eBlockFace) iface;
-                PutBlockFace(cityScape, meshData, tilex + area.x, tiley + area.y, tilez, faceid, blockInfo);
-            }
+    glm::vec2 texAxisA;
+    glm::vec2 texAxisB;
+    for (int ivertex = 0; ivertex < 4; ++ivertex)
+    {
+        if (cornersA[ivertex] == 1 && cornersB[ivertex] == 0)
+        {
+            texAxisA = glm::vec2(vertices[ivertex].mTexcoord) - texOrigin;
+        }
+        if (cornersA[ivertex] == 0 && cornersB[ivertex] == 1)
+        {
+            texAxisB = glm::vec2(vertices[ivertex].mTexcoord) - texOrigin;
         }
     }
-    return true;
+
+    for (int ivertex = 0; ivertex < 4; ++ivertex)
+    {
+        CityVertex3D& currVertex = vertices[ivertex];
+        currVertex.mPosition[axisA] += cornersA[ivertex] * (extentA - 1) * METERS_PER_MAP_UNIT;
+        currVertex.mPosition[axisB] += cornersB[ivertex] * (extentB - 1) * METERS_PER_MAP_UNIT;
+
+        const glm::vec2 texcoord = texOrigin + 
+            texAxisA * (float) (cornersA[ivertex] * extentA) + 
+            texAxisB * (float) (cornersB[ivertex] * extentB);
+        currVertex.mTexcoord.x = texcoord.x;
+        currVertex.mTexcoord.y = texcoord.y;
+    }
 }
 
-void GameMapHelpers::PutBlockFace(GameMapManager& cityScape, CityMeshData& meshData, int x, int y, int z, eBlockFace face, MapBlockInfo* blockInfo)
+void GameMapHelpers::PutBlockFace(GameMapManager& cityScape, CityMeshData& meshData, int x, int y, int z, eBlockFace face, const MapBlockInfo* blockInfo)
 {
     assert(blockInfo && blockInfo->mFaces[face]);
     eBlockType blockType = (face == eBlockFace_Lid) ? eBlockType_Lid : eBlockType_Side;
@@ -253,6 +568,44 @@ void GameMapHelpers::PutBlockFace(GameMapManager& cityScape, CityMeshData& meshD
 }
 
 float GameMapHelpers::GetSlopeHeight(int slopeType, float coord_x, float coord_y)
+{
+    debug_assert(coord_x >= 0.0f && coord_x <= 1.0f);
+    debug_assert(coord_y >= 0.0f && coord_y <= 1.0f);
+    debug_assert(slopeType >= 0 && slopeType <= MaxValidSlopeType);
+
+    const SlopePlane& plane = SlopePlanes.mPlanes[slopeType & (SlopeTypesCount - 1)];
+    return EvaluateSlopePlane(plane, coord_x, coord_y);
+}
+
+void GameMapHelpers::GetSlopeHeights(const unsigned char* slopeTypes, const float* coord_x, const float* coord_y, int count, float* outHeights)
+{
+    debug_assert(slopeTypes && coord_x && coord_y && outHeights);
+
+    int icurr = 0;
+#ifdef GAME_MAP_HELPERS_SSE
+    for (; icurr + 4 <= count; icurr += 4)
+    {
+        // load planes of 4 slopes and transpose them to low, high, weightX and weightY lanes
+        __m128 low = _mm_load_ps(&SlopePlanes.mPlanes[slopeTypes[icurr + 0] & (SlopeTypesCount - 1)].mLow);
+        __m128 high = _mm_load_ps(&SlopePlanes.mPlanes[slopeTypes[icurr + 1] & (SlopeTypesCount - 1)].mLow);
+        __m128 weightx = _mm_load_ps(&SlopePlanes.mPlanes[slopeTypes[icurr + 2] & (SlopeTypesCount - 1)].mLow);
+        __m128 weighty = _mm_load_ps(&SlopePlanes.mPlanes[slopeTypes[icurr + 3] & (SlopeTypesCount - 1)].mLow);
+        _MM_TRANSPOSE4_PS(low, high, weightx, weighty);
+
+        // same evaluation order as glm::lerp: low * (1 - factor) + high * factor
+        __m128 factor = _mm_add_ps(_mm_mul_ps(weightx, _mm_loadu_ps(coord_x + icurr)), _mm_mul_ps(weighty, _mm_loadu_ps(coord_y + icurr)));
+        __m128 heights = _mm_add_ps(_mm_mul_ps(low, _mm_sub_ps(_mm_set1_ps(1.0f), factor)), _mm_mul_ps(high, factor));
+        _mm_storeu_ps(outHeights + icurr, heights);
+    }
+#endif
+    for (; icurr < count; ++icurr)
+    {
+        const SlopePlane& plane = SlopePlanes.mPlanes[slopeTypes[icurr] & (SlopeTypesCount - 1)];
+        outHeights[icurr] = EvaluateSlopePlane(plane, coord_x[icurr], coord_y[icurr]);
+    }
+}
+
+float GameMapHelpers::GetSlopeHeightReference(int slopeType, float coord_x, float coord_y)
 {
     debug_assert(coord_x >= 0.0f && coord_x <= 1.0f);
     debug_assert(coord_y >= 0.0f && coord_y <= 1.0f);
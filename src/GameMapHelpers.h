@@ -3,6 +3,17 @@
 #include "GameDefs.h"
 #include "VertexFormats.h"
 
+// city mesh faces are ordered by layer and direction so that groups which cannot be seen may be skipped on draw
+enum { CityMeshFacesGroupsCount = MAP_LAYERS_COUNT * eBlockFace_COUNT };
+
+// get faces group of map block face
+// @param layer: Map layer
+// @param face: Block face direction
+inline int GetCityMeshFacesGroup(int layer, eBlockFace face)
+{
+    return layer * eBlockFace_COUNT + face;
+}
+
 // defines map mesh data
 template<typename TVertexType>
 struct MeshData
@@ -13,25 +24,34 @@ public:
     {
         mBlocksVertices.clear();
         mBlocksIndices.clear();
+        mFacesGroupsIndicesCount.clear();
     }
 public:
     std::vector<TVertexType> mBlocksVertices;
     std::vector<DrawIndex> mBlocksIndices;
+    std::vector<unsigned int> mFacesGroupsIndicesCount; // number of indices in each faces group, groups follow one by one
 };
 
 using CityMeshData = MeshData<CityVertex3D>;
 
+// slope types above are not used by map blocks
+const int MaxValidSlopeType = 44;
+
 class GameMapManager;
 class GameMapHelpers final
 {
 public:
     // construct mesh for specified city area and layer
+    // faces covered by neighbour solid blocks are dropped and same adjacent faces are merged into larger quads,
+    // merged quads rely on repeating of blocks texture
+    // generated faces are ordered by faces groups, see CityMeshFacesGroupsCount
     // @param cityScape: City scape data
     // @param area: Target map rect
     // @param layerIndex: Target map layer, see MAP_LAYERS_COUNT
     // @param meshData: Output mesh data
+    // @param outSourceTrianglesCount: Output number of triangles before optimization, optional
     static bool BuildMapMesh(GameMapManager& city, const Rect& area, int layerIndex, CityMeshData& meshData);
-    static bool BuildMapMesh(GameMapManager& city, const Rect& area, CityMeshData& meshData);
+    static bool BuildMapMesh(GameMapManager& city, const Rect& area, CityMeshData& meshData, int* outSourceTrianglesCount = nullptr);
 
     // compute height for specific block slope type
     // @param slopeType: Slope type
@@ -39,7 +59,22 @@ public:
     // @return slope height specified in map units [0, 1]
     static float GetSlopeHeight(int slopeType, float x, float y);
 
+    // compute heights for multiple block slopes at once, results are bit-exact with GetSlopeHeight
+    // @param slopeTypes: Slope types
+    // @param x, y: Positions within blocks [0, 1]
+    // @param count: Number of elements
+    // @param outHeights: Output slope heights specified in map units [0, 1]
+    static void GetSlopeHeights(const unsigned char* slopeTypes, const float* x, const float* y, int count, float* outHeights);
+
+    // reference slope height implementation, used to build slope planes table
+    static float GetSlopeHeightReference(int slopeType, float x, float y);
+
 private:
     // internals
-    static void PutBlockFace(GameMapManager& city, CityMeshData& meshData, int x, int y, int z, eBlockFace face, MapBlockInfo* blockInfo);
+    static void BuildLayersMesh(GameMapManager& city, const Rect& area, int firstLayer, int numLayers, CityMeshData& meshData, 
+        int* outSourceTrianglesCount);
+    static void PutBlockFace(GameMapManager& city, CityMeshData& meshData, int x, int y, int z, eBlockFace face, const MapBlockInfo* blockInfo);
+    static void StretchBlockFace(CityMeshData& meshData, int baseVertexIndex, int axisA, int axisB, int extentA, int extentB);
+    static bool IsBlockFaceHidden(GameMapManager& city, int x, int y, int z, eBlockFace face, const MapBlockInfo* blockInfo);
+    static unsigned int GetBlockFaceMergeKey(eBlockFace face, const MapBlockInfo* blockInfo);
 };
\ No newline at end of file
@@ -1,5 +1,6 @@
 #include "stdafx.h"
 #include "GameMapManager.h"
+#include "TaskManager.h"
 
 GameMapManager gGameMap;
 
@@ -27,60 +28,197 @@ struct GTAFileHeaderCMP
     int nav_data_size;
 };
 
-bool GameMapManager::LoadFromFile(const std::string& filename)
+// decoded map data cache file
+enum
 {
-    Cleanup();
+    MAP_CACHE_FOURCC = 0x434D3343, // C3MC
+    MAP_CACHE_VERSION = 5,
+    MAP_CACHE_BLOCK_RECORD_SIZE = 11, // blocks palette is stored field by field, one byte per field
+};
 
-    gConsole.LogMessage(eLogMessage_Info, "Loading map '%s'", filename.c_str());
+struct MapCacheHeader
+{
+    unsigned int mFourCC;
+    unsigned int mVersion;
+    unsigned int mBlockRecordSize;
+    int mStyleNumber;
+    unsigned int mStartupObjectsCount;
+    unsigned int mBlocksPaletteSize;
+    unsigned long long mSourceHash; // hash of source map file content
+    unsigned long long mPayloadChecksum;
+};
 
-    std::ifstream file;
-    if (!gFiles.OpenBinaryFile(filename, file))
+// header, chunk layers, heightfield and startup objects are stored as is, so they must not contain padding bytes
+static_assert(sizeof(MapCacheHeader) == sizeof(unsigned int) * 6 + sizeof(unsigned long long) * 2, "Map cache header has padding");
+static_assert(sizeof(MapBlocksChunkLayer) == sizeof(MapBlockIndex) * MAP_CHUNK_DIMENSIONS * MAP_CHUNK_DIMENSIONS, "Chunk layer has padding");
+static_assert(sizeof(MapHeightfieldCell) == sizeof(unsigned char) * 2, "Heightfield cell has padding");
+static_assert(sizeof(StartupObjectPosStruct) == sizeof(unsigned short) * 8, "Startup object has padding");
+
+//////////////////////////////////////////////////////////////////////////
+
+inline unsigned short ReadUInt16(const unsigned char* sourceData)
+{
+    return sourceData[0] | (sourceData[1] << 8);
+}
+
+// compute 64 bit FNV-1a hash, data is processed with 8 bytes words,
+// result does not depend on how data is split into appended parts
+class DataHasher
+{
+public:
+    void Append(const void* sourceData, size_t sourceLength)
     {
-        gConsole.LogMessage(eLogMessage_Warning, "Cannot open map data file '%s'", filename.c_str());
-        return false;
+        const unsigned char* dataBytes = static_cast<const unsigned char*>(sourceData);
+        if (mPendingLength > 0)
+        {
+            const size_t copyLength = std::min(sourceLength, WordSize - mPendingLength);
+            memcpy(mPendingBytes + mPendingLength, dataBytes, copyLength);
+            mPendingLength += copyLength;
+            dataBytes += copyLength;
+            sourceLength -= copyLength;
+            if (mPendingLength < WordSize)
+                return;
+
+            AppendWord(mPendingBytes);
+            mPendingLength = 0;
+        }
+        for (; sourceLength >= WordSize; sourceLength -= WordSize)
+        {
+            AppendWord(dataBytes);
+            dataBytes += WordSize;
+        }
+        if (sourceLength > 0)
+        {
+            memcpy(mPendingBytes, dataBytes, sourceLength);
+            mPendingLength = sourceLength;
+        }
     }
 
-    GTAFileHeaderCMP header;
-    if (!cxx::read_from_stream(file, header) || header.version_code != GTA_CMPFILE_VERSION_CODE)
+    // get hash of all appended data, trailing bytes which do not fill whole word are processed one by one
+    unsigned long long GetHash() const
     {
-        gConsole.LogMessage(eLogMessage_Warning, "Cannot read header of map data file '%s'", filename.c_str());
-        return false;
+        unsigned long long resultHash = mHash;
+        for (size_t ibyte = 0; ibyte < mPendingLength; ++ibyte)
+        {
+            resultHash = (resultHash ^ mPendingBytes[ibyte]) * FnvPrime;
+        }
+        return resultHash;
     }
 
-    if (!ReadCompressedMapData(file, header.column_size, header.block_size))
+private:
+    void AppendWord(const unsigned char* wordData)
     {
-        gConsole.LogMessage(eLogMessage_Warning, "Cannot read compressed map data from '%s'", filename.c_str());
-        return false;
+        unsigned long long dataWord;
+        memcpy(&dataWord, wordData, sizeof(dataWord));
+        mHash = (mHash ^ dataWord) * FnvPrime;
     }
 
-    if (!ReadStartupObjects(file, header.object_pos_size))
+private:
+    static const size_t WordSize = sizeof(unsigned long long);
+    static const unsigned long long FnvPrime = 1099511628211ULL;
+
+    unsigned long long mHash = 14695981039346656037ULL;
+    unsigned char mPendingBytes[WordSize];
+    size_t mPendingLength = 0;
+};
+
+static void WriteBlockRecord(const MapBlockInfo& blockInfo, unsigned char* recordData)
+{
+    static_assert(eBlockFace_COUNT == 5, "Block faces count changed");
+    recordData[0] = blockInfo.mRemap;
+    recordData[1] = static_cast<unsigned char>(blockInfo.mGroundType);
+    recordData[2] = static_cast<unsigned char>(blockInfo.mLidRotation);
+    recordData[3] = blockInfo.mTrafficLight;
+    recordData[4] = blockInfo.mFaces[eBlockFace_W];
+    recordData[5] = blockInfo.mFaces[eBlockFace_E];
+    recordData[6] = blockInfo.mFaces[eBlockFace_N];
+    recordData[7] = blockInfo.mFaces[eBlockFace_S];
+    recordData[8] = blockInfo.mFaces[eBlockFace_Lid];
+    recordData[9] = blockInfo.mSlopeType;
+    recordData[10] = 
+        (blockInfo.mUpDirection ? 0x01 : 0) | 
+        (blockInfo.mDownDirection ? 0x02 : 0) | 
+        (blockInfo.mLeftDirection ? 0x04 : 0) | 
+        (blockInfo.mRightDirection ? 0x08 : 0) | 
+        (blockInfo.mIsFlat ? 0x10 : 0) | 
+        (blockInfo.mFlipTopBottomFaces ? 0x20 : 0) | 
+        (blockInfo.mFlipLeftRightFaces ? 0x40 : 0) | 
+        (blockInfo.mIsRailway ? 0x80 : 0);
+}
+
+static void ReadBlockRecord(const unsigned char* recordData, MapBlockInfo& blockInfo)
+{
+    blockInfo.mRemap = recordData[0];
+    blockInfo.mGroundType = static_cast<eGroundType>(recordData[1]);
+    blockInfo.mLidRotation = static_cast<eLidRotation>(recordData[2]);
+    blockInfo.mTrafficLight = recordData[3];
+    blockInfo.mFaces[eBlockFace_W] = recordData[4];
+    blockInfo.mFaces[eBlockFace_E] = recordData[5];
+    blockInfo.mFaces[eBlockFace_N] = recordData[6];
+    blockInfo.mFaces[eBlockFace_S] = recordData[7];
+    blockInfo.mFaces[eBlockFace_Lid] = recordData[8];
+    blockInfo.mSlopeType = recordData[9];
+    blockInfo.mUpDirection = (recordData[10] & 0x01) > 0;
+    blockInfo.mDownDirection = (recordData[10] & 0x02) > 0;
+    blockInfo.mLeftDirection = (recordData[10] & 0x04) > 0;
+    blockInfo.mRightDirection = (recordData[10] & 0x08) > 0;
+    blockInfo.mIsFlat = (recordData[10] & 0x10) > 0;
+    blockInfo.mFlipTopBottomFaces = (recordData[10] & 0x20) > 0;
+    blockInfo.mFlipLeftRightFaces = (recordData[10] & 0x40) > 0;
+    blockInfo.mIsRailway = (recordData[10] & 0x80) > 0;
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+GameMapManager::GameMapManager()
+    : mBlocksGroundBits(BlocksAttributesCount)
+    , mBlocksSlopeTypes(BlocksAttributesCount)
+    , mBlocksFaceBits(BlocksAttributesCount)
+{
+    for (std::vector<MapHeightfieldCell>& currVariant: mHeightfield)
     {
-        gConsole.LogMessage(eLogMessage_Warning, "Cannot read map startup objects from '%s'", filename.c_str());
+        currVariant.resize(BlocksAttributesCount);
+    }
+}
+
+bool GameMapManager::LoadFromFile(const std::string& filename)
+{
+    Cleanup();
+
+    gConsole.LogMessage(eLogMessage_Info, "Loading map '%s'", filename.c_str());
+
+    int styleNumber = 0;
+    if (!ReadCityScapeData(filename, eMapLoadFlags_MappedFile | eMapLoadFlags_UseCache, styleNumber))
+    {
+        Cleanup();
         return false;
     }
 
     // load corresponding style data
-    std::string styleName = cxx::va("STYLE%03d.G24", header.style_number);
+    std::string styleName = cxx::va("STYLE%03d.G24", styleNumber);
     if (!mStyleData.LoadFromFile(styleName))
     {
         Cleanup();
         return false;
     }
+    mMapFileName = filename;
     return true;
 }
 
 void GameMapManager::Cleanup()
 {
     mStyleData.Cleanup();
-    for (int tiley = 0; tiley < MAP_DIMENSIONS; ++tiley)
-    for (int tilex = 0; tilex < MAP_DIMENSIONS; ++tilex)
+    mMapChunks.Cleanup();
+    std::fill(mBlocksGroundBits.begin(), mBlocksGroundBits.end(), 0);
+    std::fill(mBlocksSlopeTypes.begin(), mBlocksSlopeTypes.end(), 0);
+    std::fill(mBlocksFaceBits.begin(), mBlocksFaceBits.end(), 0);
+    for (std::vector<MapHeightfieldCell>& currVariant: mHeightfield)
     {
-        for (int tilez = 0; tilez < MAP_LAYERS_COUNT; ++tilez)
-        {
-            memset(&mMapTiles[tilez][tiley][tilex], 0, Sizeof_BlockInfo);
-        }
+        std::fill(currVariant.begin(), currVariant.end(), MapHeightfieldCell());
     }
+    memset(mOccupancyCells, 0, sizeof(mOccupancyCells));
     mStartupObjects.clear();
+    mMapFileName.clear();
 }
 
 bool GameMapManager::IsLoaded() const
@@ -88,11 +226,372 @@ bool GameMapManager::IsLoaded() const
     return mStyleData.IsLoaded();
 }
 
-bool GameMapManager::ReadCompressedMapData(std::ifstream& file, int columnLength, int blocksLength)
+bool GameMapManager::ReadCityScapeData(const std::string& filename, eMapLoadFlags loadFlags, int& styleNumber)
+{
+    const unsigned char* sourceData = nullptr;
+    size_t sourceLength = 0;
+
+    // map data gets decoded directly from file view without copying it into intermediate buffers
+    cxx::mapped_file mappedFile;
+    if ((loadFlags & eMapLoadFlags_MappedFile) != 0)
+    {
+        if (gFiles.MapBinaryFile(filename, mappedFile))
+        {
+            sourceData = mappedFile.get_data();
+            sourceLength = mappedFile.get_size();
+        }
+        else
+        {
+            gConsole.LogMessage(eLogMessage_Debug, "Cannot map file '%s' into memory, fallback to stream", filename.c_str());
+        }
+    }
+
+    // cached data is valid only for exactly the same source file content, so whole file has to be hashed
+    std::vector<unsigned char> fileContent;
+    std::string cachePath;
+    unsigned long long sourceHash = 0;
+    if ((loadFlags & eMapLoadFlags_UseCache) != 0 && GetMapCachePath(filename, cachePath))
+    {
+        if (sourceData == nullptr)
+        {
+            if (!gFiles.ReadBinaryFile(filename, fileContent))
+            {
+                gConsole.LogMessage(eLogMessage_Warning, "Cannot read map data file '%s'", filename.c_str());
+                return false;
+            }
+            sourceData = fileContent.data();
+            sourceLength = fileContent.size();
+        }
+
+        sourceHash = ComputeDataHash(sourceData, sourceLength);
+        if (ReadMapCache(cachePath, sourceHash, mMapChunks, mHeightfield, mStartupObjects, styleNumber))
+        {
+            // heightfield is stored in cache
+            BuildBlocksAttributes();
+            BuildOccupancyCells();
+            return true;
+        }
+    }
+
+    // file content which is already in memory gets decoded in place, otherwise it is read from stream field by field
+    bool isDecoded = (sourceData == nullptr) ? 
+        ReadCityScapeStream(filename, mMapChunks, mStartupObjects, styleNumber) :
+        DecodeCityScapeData(filename, sourceData, sourceLength, mMapChunks, mStartupObjects, styleNumber);
+    if (!isDecoded)
+        return false;
+
+    gConsole.LogMessage(eLogMessage_Debug, "Map blocks: %d unique, %d KB in memory", mMapChunks.GetBlocksPaletteSize(), 
+        (int) (mMapChunks.GetMemoryUsage() / 1024));
+
+    BuildBlocksAttributes();
+    BuildOccupancyCells();
+    BuildHeightfield();
+
+    if (!cachePath.empty())
+    {
+        WriteMapCache(cachePath, sourceHash, styleNumber);
+    }
+    return true;
+}
+
+bool GameMapManager::GetMapCachePath(const std::string& filename, std::string& cachePath) const
+{
+    if (gFiles.mCacheDirectoryPath.empty())
+        return false;
+
+    std::string mapName = cxx::get_name_without_extension(filename);
+    cachePath = cxx::va("%s/%s.mapcache", gFiles.mCacheDirectoryPath.c_str(), mapName.c_str());
+    return true;
+}
+
+unsigned long long GameMapManager::ComputeDataHash(const void* sourceData, size_t sourceLength)
+{
+    DataHasher hasher;
+    hasher.Append(sourceData, sourceLength);
+    return hasher.GetHash();
+}
+
+bool GameMapManager::ReadMapCache(const std::string& cachePath, unsigned long long sourceHash, GameMapChunks& mapChunks, 
+    std::vector<MapHeightfieldCell>* heightfield, std::vector<StartupObjectPosStruct>& startupObjects, int& styleNumber) const
+{
+    if (!cxx::is_file_exists(cachePath))
+        return false;
+
+    cxx::mapped_file cacheFile;
+    if (!cacheFile.open(cachePath))
+        return false;
+
+    const unsigned char* cacheData = cacheFile.get_data();
+
+    MapCacheHeader header;
+    if (cacheFile.get_size() < sizeof(header))
+        return false;
+
+    memcpy(&header, cacheData, sizeof(header));
+    if (header.mFourCC != MAP_CACHE_FOURCC || header.mVersion != MAP_CACHE_VERSION || header.mSourceHash != sourceHash ||
+        header.mBlockRecordSize != MAP_CACHE_BLOCK_RECORD_SIZE)
+    {
+        gConsole.LogMessage(eLogMessage_Debug, "Map cache '%s' is outdated", cachePath.c_str());
+        return false;
+    }
+
+    // blocks palette is followed by chunk layers presence flags and indices of allocated chunk layers
+    mapChunks.Cleanup();
+
+    const int chunkLayersCount = MapChunksPerSide * MapChunksPerSide * MAP_LAYERS_COUNT;
+    const size_t paletteDataLength = header.mBlocksPaletteSize * MAP_CACHE_BLOCK_RECORD_SIZE;
+    if (header.mBlocksPaletteSize < 1 || header.mBlocksPaletteSize > MaxMapBlocksPaletteSize || 
+        cacheFile.get_size() < sizeof(header) + paletteDataLength + chunkLayersCount)
+    {
+        gConsole.LogMessage(eLogMessage_Warning, "Map cache '%s' is corrupted", cachePath.c_str());
+        return false;
+    }
+
+    const unsigned char* paletteData = cacheData + sizeof(header);
+    const unsigned char* chunkLayersFlags = paletteData + paletteDataLength;
+    const int allocatedChunkLayersCount = (int) std::count_if(chunkLayersFlags, chunkLayersFlags + chunkLayersCount, 
+        [](unsigned char flag) { return flag != 0; });
+
+    const size_t chunksDataLength = chunkLayersCount + allocatedChunkLayersCount * sizeof(MapBlocksChunkLayer);
+    const size_t heightfieldDataLength = BlocksAttributesCount * sizeof(MapHeightfieldCell);
+    const size_t objectsDataLength = header.mStartupObjectsCount * sizeof(StartupObjectPosStruct);
+    const size_t payloadLength = paletteDataLength + chunksDataLength + heightfieldDataLength * HeightfieldVariantsCount + objectsDataLength;
+    if (cacheFile.get_size() != sizeof(header) + payloadLength)
+    {
+        gConsole.LogMessage(eLogMessage_Warning, "Map cache '%s' is corrupted", cachePath.c_str());
+        return false;
+    }
+
+    // payload is stored contiguously, hasher gives same result as for separately written parts
+    DataHasher payloadHasher;
+    payloadHasher.Append(paletteData, payloadLength);
+    if (header.mPayloadChecksum != payloadHasher.GetHash())
+    {
+        gConsole.LogMessage(eLogMessage_Warning, "Map cache '%s' is corrupted", cachePath.c_str());
+        return false;
+    }
+
+    std::vector<MapBlockInfo> blocksPalette(header.mBlocksPaletteSize);
+    for (unsigned int iblock = 0; iblock < header.mBlocksPaletteSize; ++iblock)
+    {
+        ReadBlockRecord(paletteData + iblock * MAP_CACHE_BLOCK_RECORD_SIZE, blocksPalette[iblock]);
+    }
+    mapChunks.SetBlocksPalette(blocksPalette.data(), header.mBlocksPaletteSize);
+
+    const unsigned char* chunkLayerData = chunkLayersFlags + chunkLayersCount;
+    for (int ichunkLayer = 0; ichunkLayer < chunkLayersCount; ++ichunkLayer)
+    {
+        if (chunkLayersFlags[ichunkLayer] == 0)
+            continue;
+
+        const int chunkIndex = ichunkLayer / MAP_LAYERS_COUNT;
+        MapBlocksChunkLayer* chunkLayer = mapChunks.AllocateChunkLayer(chunkIndex % MapChunksPerSide, 
+            chunkIndex / MapChunksPerSide, ichunkLayer % MAP_LAYERS_COUNT);
+        memcpy(chunkLayer, chunkLayerData, sizeof(MapBlocksChunkLayer));
+        chunkLayerData += sizeof(MapBlocksChunkLayer);
+    }
+
+    const unsigned char* heightfieldData = chunkLayerData;
+    for (int ivariant = 0; ivariant < HeightfieldVariantsCount; ++ivariant)
+    {
+        std::vector<MapHeightfieldCell>& currVariant = heightfield[ivariant];
+        currVariant.resize(BlocksAttributesCount);
+        memcpy(currVariant.data(), heightfieldData, heightfieldDataLength);
+        heightfieldData += heightfieldDataLength;
+    }
+
+    const unsigned char* objectsData = heightfieldData;
+    startupObjects.resize(header.mStartupObjectsCount);
+    if (objectsDataLength)
+    {
+        memcpy(startupObjects.data(), objectsData, objectsDataLength);
+    }
+
+    styleNumber = header.mStyleNumber;
+    return true;
+}
+
+bool GameMapManager::WriteMapCache(const std::string& cachePath, unsigned long long sourceHash, int styleNumber) const
+{
+    if (!cxx::is_directory_exists(gFiles.mCacheDirectoryPath))
+    {
+        cxx::ensure_path_exists(gFiles.mCacheDirectoryPath);
+    }
+
+    // only allocated chunk layers are stored
+    std::vector<const MapBlocksChunkLayer*> chunkLayers;
+    for (int chunky = 0; chunky < MapChunksPerSide; ++chunky)
+    for (int chunkx = 0; chunkx < MapChunksPerSide; ++chunkx)
+    {
+        for (int ilayer = 0; ilayer < MAP_LAYERS_COUNT; ++ilayer)
+        {
+            chunkLayers.push_back(mMapChunks.GetChunkLayer(chunkx, chunky, ilayer));
+        }
+    }
+
+    std::vector<unsigned char> chunkLayersFlags(chunkLayers.size());
+    for (size_t ichunkLayer = 0; ichunkLayer < chunkLayers.size(); ++ichunkLayer)
+    {
+        chunkLayersFlags[ichunkLayer] = chunkLayers[ichunkLayer] ? 1 : 0;
+    }
+
+    // blocks are written field by field, so padding bytes never get into file
+    const int blocksPaletteSize = mMapChunks.GetBlocksPaletteSize();
+    std::vector<unsigned char> paletteData(blocksPaletteSize * MAP_CACHE_BLOCK_RECORD_SIZE);
+    for (int iblock = 0; iblock < blocksPaletteSize; ++iblock)
+    {
+        WriteBlockRecord(*mMapChunks.GetPaletteBlock((MapBlockIndex) iblock), paletteData.data() + iblock * MAP_CACHE_BLOCK_RECORD_SIZE);
+    }
+
+    const size_t heightfieldDataLength = BlocksAttributesCount * sizeof(MapHeightfieldCell);
+    const size_t objectsDataLength = mStartupObjects.size() * sizeof(StartupObjectPosStruct);
+
+    MapCacheHeader header;
+    header.mFourCC = MAP_CACHE_FOURCC;
+    header.mVersion = MAP_CACHE_VERSION;
+    header.mBlockRecordSize = MAP_CACHE_BLOCK_RECORD_SIZE;
+    header.mStyleNumber = styleNumber;
+    header.mStartupObjectsCount = (unsigned int) mStartupObjects.size();
+    header.mBlocksPaletteSize = (unsigned int) blocksPaletteSize;
+    header.mSourceHash = sourceHash;
+
+    // payload parts are hashed in the same order as they are written
+    DataHasher payloadHasher;
+    payloadHasher.Append(paletteData.data(), paletteData.size());
+    payloadHasher.Append(chunkLayersFlags.data(), chunkLayersFlags.size());
+    for (const MapBlocksChunkLayer* currChunkLayer: chunkLayers)
+    {
+        if (currChunkLayer)
+        {
+            payloadHasher.Append(currChunkLayer, sizeof(MapBlocksChunkLayer));
+        }
+    }
+    for (const std::vector<MapHeightfieldCell>& currVariant: mHeightfield)
+    {
+        payloadHasher.Append(currVariant.data(), heightfieldDataLength);
+    }
+    payloadHasher.Append(mStartupObjects.data(), objectsDataLength);
+    header.mPayloadChecksum = payloadHasher.GetHash();
+
+    std::ofstream file (cachePath, std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!file.is_open())
+    {
+        gConsole.LogMessage(eLogMessage_Warning, "Cannot create map cache '%s'", cachePath.c_str());
+        return false;
+    }
+
+    bool isWritten = file.write(reinterpret_cast<const char*>(&header), sizeof(header)) &&
+        file.write(reinterpret_cast<const char*>(paletteData.data()), paletteData.size()) &&
+        file.write(reinterpret_cast<const char*>(chunkLayersFlags.data()), chunkLayersFlags.size());
+    for (const MapBlocksChunkLayer* currChunkLayer: chunkLayers)
+    {
+        if (currChunkLayer && isWritten)
+        {
+            isWritten = !!file.write(reinterpret_cast<const char*>(currChunkLayer), sizeof(MapBlocksChunkLayer));
+        }
+    }
+    for (const std::vector<MapHeightfieldCell>& currVariant: mHeightfield)
+    {
+        isWritten = isWritten && file.write(reinterpret_cast<const char*>(currVariant.data()), heightfieldDataLength);
+    }
+    isWritten = isWritten && file.write(reinterpret_cast<const char*>(mStartupObjects.data()), objectsDataLength);
+
+    if (!isWritten)
+    {
+        // partially written cache will be rejected on next read by size check
+        gConsole.LogMessage(eLogMessage_Warning, "Cannot write map cache '%s'", cachePath.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool GameMapManager::ReadCityScapeStream(const std::string& filename, GameMapChunks& mapChunks, 
+    std::vector<StartupObjectPosStruct>& startupObjects, int& styleNumber) const
+{
+    std::ifstream file;
+    if (!gFiles.OpenBinaryFile(filename, file))
+    {
+        gConsole.LogMessage(eLogMessage_Warning, "Cannot open map data file '%s'", filename.c_str());
+        return false;
+    }
+
+    GTAFileHeaderCMP header;
+    if (!cxx::read_from_stream(file, header) || header.version_code != GTA_CMPFILE_VERSION_CODE || 
+        header.column_size < 0 || header.block_size < 0 || header.object_pos_size < 0)
+    {
+        gConsole.LogMessage(eLogMessage_Warning, "Cannot read header of map data file '%s'", filename.c_str());
+        return false;
+    }
+
+    if (!ReadCompressedMapData(file, header.column_size, header.block_size, mapChunks))
+    {
+        gConsole.LogMessage(eLogMessage_Warning, "Cannot read compressed map data from '%s'", filename.c_str());
+        return false;
+    }
+
+    if (!ReadStartupObjects(file, header.object_pos_size, startupObjects))
+    {
+        gConsole.LogMessage(eLogMessage_Warning, "Cannot read map startup objects from '%s'", filename.c_str());
+        return false;
+    }
+
+    styleNumber = header.style_number;
+    return true;
+}
+
+bool GameMapManager::DecodeCityScapeData(const std::string& filename, const unsigned char* sourceData, size_t sourceLength, 
+    GameMapChunks& mapChunks, std::vector<StartupObjectPosStruct>& startupObjects, int& styleNumber) const
+{
+    GTAFileHeaderCMP header;
+    if (sourceLength < sizeof(header))
+    {
+        gConsole.LogMessage(eLogMessage_Warning, "Cannot read header of map data file '%s'", filename.c_str());
+        return false;
+    }
+
+    memcpy(&header, sourceData, sizeof(header));
+    if (header.version_code != GTA_CMPFILE_VERSION_CODE || header.column_size < 0 || header.block_size < 0 || header.object_pos_size < 0)
+    {
+        gConsole.LogMessage(eLogMessage_Warning, "Cannot read header of map data file '%s'", filename.c_str());
+        return false;
+    }
+
+    // map data sections follows header in strict order
+    const size_t baseDataLength = MAP_DIMENSIONS * MAP_DIMENSIONS * sizeof(int);
+    const size_t dataLength = sizeof(header) + baseDataLength + header.column_size + header.block_size + header.object_pos_size;
+    if (sourceLength < dataLength)
+    {
+        gConsole.LogMessage(eLogMessage_Warning, "Map data file '%s' is truncated", filename.c_str());
+        return false;
+    }
+
+    const unsigned char* baseData = sourceData + sizeof(header);
+    const unsigned char* columnData = baseData + baseDataLength;
+    const unsigned char* blocksData = columnData + header.column_size;
+    const unsigned char* objectsData = blocksData + header.block_size;
+
+    if (!ReadCompressedMapData(reinterpret_cast<const int*>(baseData), 
+        reinterpret_cast<const unsigned short*>(columnData), header.column_size, blocksData, header.block_size, mapChunks))
+    {
+        gConsole.LogMessage(eLogMessage_Warning, "Cannot read compressed map data from '%s'", filename.c_str());
+        return false;
+    }
+
+    if (!ReadStartupObjects(objectsData, header.object_pos_size, startupObjects))
+    {
+        gConsole.LogMessage(eLogMessage_Warning, "Cannot read map startup objects from '%s'", filename.c_str());
+        return false;
+    }
+
+    styleNumber = header.style_number;
+    return true;
+}
+
+bool GameMapManager::ReadCompressedMapData(std::ifstream& file, int columnLength, int blocksLength, GameMapChunks& mapChunks) const
 {
     // reading base data
-    const int baseDataLength = MAP_DIMENSIONS * MAP_DIMENSIONS * sizeof(int);
-    if (!file.read(reinterpret_cast<char*>(mBaseTilesData), baseDataLength))
+    std::vector<int> baseData(MAP_DIMENSIONS * MAP_DIMENSIONS);
+    if (!file.read(reinterpret_cast<char*>(baseData.data()), baseData.size() * sizeof(int)))
         return false;
 
     // reading column data
@@ -106,15 +605,15 @@ bool GameMapManager::ReadCompressedMapData(std::ifstream& file, int columnLength
             return false;
     }
 
-    std::vector<MapBlockInfo> blocksData;
+    std::vector<MapBlockInfo> blocksList;
 
     const int blockSize = sizeof(unsigned short) + sizeof(unsigned char) * 6;
     if (blocksLength)
     {
         assert((blocksLength % blockSize) == 0);
-        blocksData.resize(blocksLength / blockSize);
+        blocksList.resize(blocksLength / blockSize);
 
-        for (MapBlockInfo& blockInfo: blocksData)
+        for (MapBlockInfo& blockInfo: blocksList)
         {
             unsigned short type_map;
             READ_I16(file, type_map);
@@ -146,40 +645,233 @@ bool GameMapManager::ReadCompressedMapData(std::ifstream& file, int columnLength
         }
     }
 
-    // decompress
+    return BuildMapChunks(baseData.data(), columnData.data(), (int) columnData.size(), blocksList, mapChunks);
+}
+
+bool GameMapManager::ReadCompressedMapData(const int* baseData, const unsigned short* columnData, int columnLength, 
+    const unsigned char* blocksData, int blocksLength, GameMapChunks& mapChunks) const
+{
+    const int columnElementsCount = columnLength / sizeof(unsigned short);
+    assert((columnLength % sizeof(unsigned short)) == 0);
+
+    std::vector<MapBlockInfo> blocksList;
 
+    const int blockSize = sizeof(unsigned short) + sizeof(unsigned char) * 6;
+    if (blocksLength)
+    {
+        assert((blocksLength % blockSize) == 0);
+        blocksList.resize(blocksLength / blockSize);
+
+        const unsigned char* blockData = blocksData;
+        for (MapBlockInfo& blockInfo: blocksList)
+        {
+            unsigned short type_map = ReadUInt16(blockData);
+
+            blockInfo.mUpDirection = (type_map & 0x01) > 0;
+            blockInfo.mDownDirection = (type_map & 0x02) > 0;
+            blockInfo.mLeftDirection = (type_map & 0x04) > 0;
+            blockInfo.mRightDirection = (type_map & 0x08) > 0;
+            blockInfo.mGroundType = static_cast<eGroundType>((type_map >> 4) & 0x07);
+            blockInfo.mIsFlat = (type_map & 0x80) > 0;
+            blockInfo.mSlopeType = (type_map >> 8) & 0x3F;
+            blockInfo.mLidRotation = static_cast<eLidRotation>((type_map >> 14) & 0x03);
+
+            unsigned char type_map_ext = blockData[2];
+
+            blockInfo.mTrafficLight = (type_map_ext & 0x07);
+            blockInfo.mRemap = (type_map_ext >> 3) & 0x03;
+            blockInfo.mFlipTopBottomFaces = (type_map_ext & 0x20) > 0;
+            blockInfo.mFlipLeftRightFaces = (type_map_ext & 0x40) > 0;
+            blockInfo.mIsRailway = (type_map_ext & 0x80) > 0;
+
+            // read sides
+            blockInfo.mFaces[eBlockFace_W] = blockData[3];
+            blockInfo.mFaces[eBlockFace_E] = blockData[4];
+            blockInfo.mFaces[eBlockFace_N] = blockData[5];
+            blockInfo.mFaces[eBlockFace_S] = blockData[6];
+            blockInfo.mFaces[eBlockFace_Lid] = blockData[7];
+
+            blockData += blockSize;
+        }
+    }
+
+    return BuildMapChunks(baseData, columnData, columnElementsCount, blocksList, mapChunks);
+}
+
+bool GameMapManager::BuildMapChunks(const int* baseData, const unsigned short* columnData, int columnElementsCount, 
+    const std::vector<MapBlockInfo>& blocksList, GameMapChunks& mapChunks) const
+{
+    const int blocksCount = (int) blocksList.size();
+
+    // each distinct block data goes to palette once, map cells keep palette indices
+    mapChunks.Cleanup();
+
+    // blocks are ordered by fields, so padding bytes do not produce duplicates
+    std::map<MapBlockInfo, MapBlockIndex> paletteLookup;
+    std::vector<MapBlockIndex> paletteIndices(blocksCount);
+    for (int iblock = 0; iblock < blocksCount; ++iblock)
+    {
+        const MapBlockInfo& blockData = blocksList[iblock];
+        auto found_iterator = paletteLookup.find(blockData);
+        if (found_iterator == paletteLookup.end())
+        {
+            found_iterator = paletteLookup.emplace(blockData, mapChunks.AddPaletteBlock(blockData)).first;
+        }
+        paletteIndices[iblock] = found_iterator->second;
+    }
+
+    // decompress, chunk layers get allocated on first non air block
     for (int tiley = 0; tiley < MAP_DIMENSIONS; ++tiley)
     for (int tilex = 0; tilex < MAP_DIMENSIONS; ++tilex)
     {
-        const int columnElement = mBaseTilesData[tiley][tilex] / sizeof(unsigned short);
-        assert((mBaseTilesData[tiley][tilex] % sizeof(unsigned short)) == 0);
+        const int baseOffset = baseData[tiley * MAP_DIMENSIONS + tilex];
+        const int columnElement = baseOffset / sizeof(unsigned short);
+        assert((baseOffset % sizeof(unsigned short)) == 0);
+        if (baseOffset < 0 || columnElement >= columnElementsCount || columnData[columnElement] > MAP_LAYERS_COUNT)
+            return false;
+
         const int columnHeight = MAP_LAYERS_COUNT - columnData[columnElement];
-        for (int tilez = 0; tilez < columnHeight; ++tilez)
+        if (columnElement + columnHeight >= columnElementsCount)
+            return false;
+
+        for (int tilez = 0; tilez < MAP_LAYERS_COUNT; ++tilez)
         {
+            if (tilez >= columnHeight)
+                break;
+
             int srcBlock = columnData[columnElement + columnHeight - tilez];
-            mMapTiles[tilez][tiley][tilex] = blocksData[srcBlock];
+            if (srcBlock >= blocksCount)
+                return false;
+
+            mapChunks.SetBlockIndex(tilex, tiley, tilez, paletteIndices[srcBlock]);
         }
     }
     //FixShiftedBits();
     return true;
 }
 
-MapBlockInfo* GameMapManager::GetBlock(int coordx, int coordz, int layer) const
+const MapBlockInfo* GameMapManager::GetBlock(int coordx, int coordz, int layer) const
 {
     debug_assert(layer > -1 && layer < MAP_LAYERS_COUNT);
     debug_assert(coordx > -1 && coordx < MAP_DIMENSIONS);
     debug_assert(coordz > -1 && coordz < MAP_DIMENSIONS);
-    // remember kids, don't try this at home!
-    return const_cast<MapBlockInfo*> (&mMapTiles[layer][coordz][coordx]);
+    return mMapChunks.GetBlock(coordx, coordz, layer);
 }
 
-MapBlockInfo* GameMapManager::GetBlockClamp(int coordx, int coordz, int layer) const
+const MapBlockInfo* GameMapManager::GetBlockClamp(int coordx, int coordz, int layer) const
 {
     layer = glm::clamp(layer, 0, MAP_LAYERS_COUNT - 1);
     coordx = glm::clamp(coordx, 0, MAP_DIMENSIONS - 1);
     coordz = glm::clamp(coordz, 0, MAP_DIMENSIONS - 1);
-    // remember kids, don't try this at home!
-    return const_cast<MapBlockInfo*> (&mMapTiles[layer][coordz][coordx]);
+    return mMapChunks.GetBlock(coordx, coordz, layer);
+}
+
+void GameMapManager::SetBlock(int coordx, int coordy, int layer, const MapBlockInfo& blockInfo)
+{
+    debug_assert(layer > -1 && layer < MAP_LAYERS_COUNT);
+    debug_assert(coordx > -1 && coordx < MAP_DIMENSIONS);
+    debug_assert(coordy > -1 && coordy < MAP_DIMENSIONS);
+
+    mMapChunks.SetBlock(coordx, coordy, layer, blockInfo);
+
+    // only single column of derived data is affected
+    BuildColumnAttributes(coordx, coordy);
+    BuildColumnHeightfield(coordx, coordy);
+    BuildOccupancyCell(coordx / OccupancyCellSize, coordy / OccupancyCellSize);
+
+    const Rect changedArea { coordx, coordy, 1, 1 };
+    for (MapBlocksChangeListener* currListener: mBlocksChangeListeners)
+    {
+        currListener->MapBlocksChanged(changedArea);
+    }
+}
+
+void GameMapManager::AttachBlocksChangeListener(MapBlocksChangeListener* listener)
+{
+    debug_assert(listener);
+    if (cxx::contains(mBlocksChangeListeners, listener))
+        return;
+
+    mBlocksChangeListeners.push_back(listener);
+}
+
+void GameMapManager::DetachBlocksChangeListener(MapBlocksChangeListener* listener)
+{
+    cxx::erase_elements(mBlocksChangeListeners, listener);
+}
+
+void GameMapManager::BuildBlocksAttributes()
+{
+    for (int tiley = 0; tiley < MAP_DIMENSIONS; ++tiley)
+    for (int tilex = 0; tilex < MAP_DIMENSIONS; ++tilex)
+    {
+        BuildColumnAttributes(tilex, tiley);
+    }
+}
+
+void GameMapManager::BuildColumnAttributes(int coordx, int coordy)
+{
+    for (int tilez = 0; tilez < MAP_LAYERS_COUNT; ++tilez)
+    {
+        const MapBlockInfo& currBlock = *mMapChunks.GetBlock(coordx, coordy, tilez);
+
+        unsigned char groundBits = (currBlock.mGroundType & eMapGroundBits_TypeMask);
+        if (currBlock.mUpDirection) groundBits |= eMapGroundBits_UpDirection;
+        if (currBlock.mDownDirection) groundBits |= eMapGroundBits_DownDirection;
+        if (currBlock.mLeftDirection) groundBits |= eMapGroundBits_LeftDirection;
+        if (currBlock.mRightDirection) groundBits |= eMapGroundBits_RightDirection;
+        if (currBlock.mIsRailway) groundBits |= eMapGroundBits_Railway;
+
+        unsigned char faceBits = 0;
+        for (int iface = 0; iface < eBlockFace_COUNT; ++iface)
+        {
+            if (currBlock.mFaces[iface])
+            {
+                faceBits |= BIT(iface);
+            }
+        }
+
+        const int attributesIndex = GetBlockAttributesIndexClamp(coordx, coordy, tilez);
+        mBlocksGroundBits[attributesIndex] = groundBits;
+        mBlocksSlopeTypes[attributesIndex] = currBlock.mSlopeType;
+        mBlocksFaceBits[attributesIndex] = faceBits;
+    }
+}
+
+void GameMapManager::BuildOccupancyCells()
+{
+    for (int celly = 0; celly < OccupancyCellsDimensions; ++celly)
+    for (int cellx = 0; cellx < OccupancyCellsDimensions; ++cellx)
+    {
+        BuildOccupancyCell(cellx, celly);
+    }
+}
+
+void GameMapManager::BuildOccupancyCell(int cellx, int celly)
+{
+    for (int tilez = 0; tilez < MAP_LAYERS_COUNT; ++tilez)
+    {
+        mOccupancyCells[tilez][celly][cellx] = false;
+    }
+
+    for (int tiley = celly * OccupancyCellSize; tiley < (celly + 1) * OccupancyCellSize; ++tiley)
+    for (int tilex = cellx * OccupancyCellSize; tilex < (cellx + 1) * OccupancyCellSize; ++tilex)
+    {
+        const int columnIndex = GetBlockAttributesIndexClamp(tilex, tiley, 0);
+        for (int tilez = 0; tilez < MAP_LAYERS_COUNT; ++tilez)
+        {
+            const int groundType = (mBlocksGroundBits[columnIndex + tilez] & eMapGroundBits_TypeMask);
+            if (groundType == eGroundType_Air && mBlocksSlopeTypes[columnIndex + tilez] == 0)
+                continue;
+
+            // ground surface of block reaches into the layer above
+            mOccupancyCells[tilez][celly][cellx] = true;
+            if (tilez + 1 < MAP_LAYERS_COUNT)
+            {
+                mOccupancyCells[tilez + 1][celly][cellx] = true;
+            }
+        }
+    }
 }
 
 void GameMapManager::FixShiftedBits()
@@ -200,8 +892,9 @@ void GameMapManager::FixShiftedBits()
     {
         for (int tilez = 0; tilez < MAP_LAYERS_COUNT - 2; ++tilez)
         {
-            MapBlockInfo& currBlock = mMapTiles[tilez][tiley][tilex];
-            MapBlockInfo& aboveBlock = mMapTiles[tilez + 1][tiley][tilex];
+            // blocks data is shared, so modified copy goes back into map
+            MapBlockInfo currBlock = *mMapChunks.GetBlock(tilex, tiley, tilez);
+            const MapBlockInfo aboveBlock = *mMapChunks.GetBlock(tilex, tiley, tilez + 1);
 
             currBlock.mLeftDirection = aboveBlock.mLeftDirection;
             currBlock.mRightDirection = aboveBlock.mRightDirection;
@@ -209,20 +902,22 @@ void GameMapManager::FixShiftedBits()
             currBlock.mUpDirection = aboveBlock.mUpDirection;
             currBlock.mGroundType = aboveBlock.mGroundType;
             currBlock.mTrafficLight = aboveBlock.mTrafficLight;
+            mMapChunks.SetBlock(tilex, tiley, tilez, currBlock);
         }
 
         // top most block set to air
-        MapBlockInfo& topBlock = mMapTiles[MAP_LAYERS_COUNT - 1][tiley][tilex];
+        MapBlockInfo topBlock = *mMapChunks.GetBlock(tilex, tiley, MAP_LAYERS_COUNT - 1);
         topBlock.mLeftDirection = 0;
         topBlock.mRightDirection = 0;
         topBlock.mDownDirection = 0;
         topBlock.mUpDirection = 0;
         topBlock.mGroundType = eGroundType_Air;
         topBlock.mTrafficLight = 0;
+        mMapChunks.SetBlock(tilex, tiley, MAP_LAYERS_COUNT - 1, topBlock);
     }
 }
 
-float GameMapManager::GetHeightAtPosition(const glm::vec3& position, bool excludeWater) const
+inline int GameMapManager::GetSurfaceAtPosition(const MapHeightfieldCell* columns, const glm::vec3& position, float& surfaceHeight, glm::vec2& subPosition) const
 {
     // get map block position in which we are located
     glm::ivec3 mapBlock {
@@ -230,136 +925,371 @@ float GameMapManager::GetHeightAtPosition(const glm::vec3& position, bool exclud
         Convert::MetersToMapUnits(position.y) + 0.5f,
         Convert::MetersToMapUnits(position.z)
     };
-    float currentHeight = (float) mapBlock.y; // set current height to ground, map units
-    for (; currentHeight > 0.0f;)
+
+    // there is nothing to fall through below first layer
+    if (mapBlock.y < 1)
     {
-        MapBlockInfo* blockData = GetBlockClamp(mapBlock.x, mapBlock.z, mapBlock.y); // y is map layer
+        surfaceHeight = (float) mapBlock.y;
+        subPosition = glm::vec2(0.0f);
+        return 0;
+    }
 
-        // compute slope height
-        if (blockData->mSlopeType) 
-        {
-            // subposition within block
-            float cx = Convert::MetersToMapUnits(position.x) - mapBlock.x;
-            float cy = Convert::MetersToMapUnits(position.z) - mapBlock.z;
+    const MapHeightfieldCell* columnCells = &columns[GetBlockAttributesIndexClamp(mapBlock.x, mapBlock.z, 0)];
+
+    MapHeightfieldCell surfaceCell = columnCells[std::min(mapBlock.y, MAP_LAYERS_COUNT - 1)];
+    int surfaceLayer = surfaceCell.mHeight;
+    if (mapBlock.y >= MAP_LAYERS_COUNT && surfaceLayer == (MAP_LAYERS_COUNT - 1))
+    {
+        // top block is solid, so position above map stays at its height
+        surfaceLayer = mapBlock.y;
+    }
+
+    surfaceHeight = (float) surfaceLayer;
 
-            currentHeight += GameMapHelpers::GetSlopeHeight(blockData->mSlopeType, cx, cy);
+    // subposition within block
+    subPosition.x = Convert::MetersToMapUnits(position.x) - mapBlock.x;
+    subPosition.y = Convert::MetersToMapUnits(position.z) - mapBlock.z;
+    return surfaceCell.mSlopeType;
+}
 
-            break;
+inline float GameMapManager::ComputeHeightAtPosition(const MapHeightfieldCell* columns, const glm::vec3& position) const
+{
+    float currentHeight = 0.0f;
+    glm::vec2 subPosition;
+
+    int slopeType = GetSurfaceAtPosition(columns, position, currentHeight, subPosition);
+    if (slopeType)
+    {
+        currentHeight += GameMapHelpers::GetSlopeHeight(slopeType, subPosition.x, subPosition.y);
+    }
+    return Convert::MapUnitsToMeters(currentHeight);
+}
+
+float GameMapManager::GetHeightAtPosition(const glm::vec3& position, bool excludeWater) const
+{
+    return ComputeHeightAtPosition(mHeightfield[excludeWater ? HeightfieldExcludeWater : HeightfieldWithWater].data(), position);
+}
+
+void GameMapManager::GetHeightAtPositions(const glm::vec3* positions, int count, float* outHeights, bool excludeWater) const
+{
+    debug_assert(positions && outHeights);
+
+    const MapHeightfieldCell* columns = mHeightfield[excludeWater ? HeightfieldExcludeWater : HeightfieldWithWater].data();
+
+    // slopes are evaluated in batches, flat surface has zero slope height
+    const int BatchSize = 64;
+
+    unsigned char slopeTypes[BatchSize];
+    float coordsx[BatchSize];
+    float coordsy[BatchSize];
+    float slopeHeights[BatchSize];
+
+    for (int ibatch = 0; ibatch < count; ibatch += BatchSize)
+    {
+        const int batchCount = std::min(count - ibatch, BatchSize);
+        for (int icurr = 0; icurr < batchCount; ++icurr)
+        {
+            glm::vec2 subPosition;
+            slopeTypes[icurr] = (unsigned char) GetSurfaceAtPosition(columns, positions[ibatch + icurr], outHeights[ibatch + icurr], subPosition);
+            coordsx[icurr] = subPosition.x;
+            coordsy[icurr] = subPosition.y;
         }
 
-        if (blockData->mGroundType == eGroundType_Air || (blockData->mGroundType == eGroundType_Water && excludeWater)) // fall through non solid block
+        GameMapHelpers::GetSlopeHeights(slopeTypes, coordsx, coordsy, batchCount, slopeHeights);
+
+        for (int icurr = 0; icurr < batchCount; ++icurr)
         {
-            currentHeight -= 1.0f;
-            mapBlock.y -= 1;
-            continue;
+            outHeights[ibatch + icurr] = Convert::MapUnitsToMeters(outHeights[ibatch + icurr] + slopeHeights[icurr]);
         }
+    }
+}
 
-        break; // bail out
+void GameMapManager::BuildHeightfield()
+{
+    for (int tiley = 0; tiley < MAP_DIMENSIONS; ++tiley)
+    for (int tilex = 0; tilex < MAP_DIMENSIONS; ++tilex)
+    {
+        BuildColumnHeightfield(tilex, tiley);
     }
-    return Convert::MapUnitsToMeters(currentHeight);
 }
 
-bool GameMapManager::TraceSegment2D(const glm::vec2& origin, const glm::vec2& destination, float height, glm::vec2& outPoint)
+void GameMapManager::BuildColumnHeightfield(int coordx, int coordy)
 {
-    glm::ivec2 mapcoord_start = origin;
-    glm::ivec2 mapcoord_end = destination;
+    const int columnIndex = GetBlockAttributesIndexClamp(coordx, coordy, 0);
+    const unsigned char* columnGroundBits = &mBlocksGroundBits[columnIndex];
+    const unsigned char* columnSlopeTypes = &mBlocksSlopeTypes[columnIndex];
+
+    for (int ivariant = 0; ivariant < HeightfieldVariantsCount; ++ivariant)
+    {
+        const bool excludeWater = (ivariant == HeightfieldExcludeWater);
 
-    int mapcoord_z = (int) height;
+        MapHeightfieldCell* columnCells = &mHeightfield[ivariant][columnIndex];
+        for (int startLayer = 0; startLayer < MAP_LAYERS_COUNT; ++startLayer)
+        {
+            // walk down until first slope or solid block
+            int currentLayer = startLayer;
+            int slopeType = 0;
+            for (; currentLayer > 0; --currentLayer)
+            {
+                slopeType = columnSlopeTypes[currentLayer];
+                if (slopeType)
+                    break;
 
-    glm::vec2 direction = glm::normalize(destination - origin);
+                const int groundType = (columnGroundBits[currentLayer] & eMapGroundBits_TypeMask);
+                if (groundType == eGroundType_Air || (groundType == eGroundType_Water && excludeWater)) // fall through non solid block
+                    continue;
 
-    // find all cells intersecting with line
+                break;
+            }
+            columnCells[startLayer].mHeight = (unsigned char) currentLayer;
+            columnCells[startLayer].mSlopeType = (unsigned char) slopeType;
+        }
+    }
+}
 
-    float posX = origin.x;
-    float posY = origin.y;
+bool GameMapManager::TraceSegment(const glm::vec3& origin, const glm::vec3& destination, MapTraceResult& outResult, bool excludeWater) const
+{
+    return TraceSegmentInternal(origin, destination, excludeWater, true, outResult);
+}
 
-    glm::ivec2 mapcoord_curr = mapcoord_start;
+void GameMapManager::TraceSegments(const glm::vec3* origins, const glm::vec3* destinations, int count, MapTraceResult* outResults, bool excludeWater) const
+{
+    debug_assert(origins && destinations && outResults);
 
-    float sideDistX;
-    float sideDistY;
+    // segments are processed in groups, small batches stay on calling thread
+    const int SegmentsPerTask = 256;
+    const int numTasks = (count + SegmentsPerTask - 1) / SegmentsPerTask;
+    gTaskManager.ParallelFor(numTasks, [this, origins, destinations, count, outResults, excludeWater](int itask)
+    {
+        const int lastSegment = std::min(count, (itask + 1) * SegmentsPerTask);
+        for (int icurr = itask * SegmentsPerTask; icurr < lastSegment; ++icurr)
+        {
+            TraceSegmentInternal(origins[icurr], destinations[icurr], excludeWater, true, outResults[icurr]);
+        }
+    });
+}
 
-    //length of ray from one x or y-side to next x or y-side
-    float deltaDistX = std::abs(1.0f / direction.x);
-    float deltaDistY = std::abs(1.0f / direction.y);
+bool GameMapManager::HasLineOfSight(const glm::vec3& origin, const glm::vec3& destination) const
+{
+    MapTraceResult traceResult;
+    return !TraceSegmentInternal(origin, destination, true, true, traceResult);
+}
 
-    //what direction to step in x or y-direction (either +1 or -1)
-    int stepX;
-    int stepY;
+bool GameMapManager::TraceSegmentInternal(const glm::vec3& origin, const glm::vec3& destination, bool excludeWater, bool skipEmptyCells, MapTraceResult& outResult) const
+{
+    outResult.mHasHit = false;
 
-    int side; //was a NS or a EW wall hit?
+    // grid space is shifted by half block vertically, 
+    // so block at layer N occupies heights [N - 0.5, N + 0.5) map units, same as for physics contacts
+    const glm::vec3 start {
+        Convert::MetersToMapUnits(origin.x),
+        Convert::MetersToMapUnits(origin.y) + 0.5f,
+        Convert::MetersToMapUnits(origin.z)
+    };
+    const glm::vec3 end {
+        Convert::MetersToMapUnits(destination.x),
+        Convert::MetersToMapUnits(destination.y) + 0.5f,
+        Convert::MetersToMapUnits(destination.z)
+    };
+    const glm::vec3 direction = end - start;
+    const glm::ivec3 bounds {MAP_DIMENSIONS, MAP_LAYERS_COUNT, MAP_DIMENSIONS};
 
-    //calculate step and initial sideDist
-    if (direction.x < 0.0f)
+    // clip segment to map bounds
+    float tmin = 0.0f;
+    float tmax = 1.0f;
+    for (int iaxis = 0; iaxis < 3; ++iaxis)
     {
-        stepX = -1;
-        sideDistX = (posX - mapcoord_curr.x) * deltaDistX;
+        if (direction[iaxis] == 0.0f)
+        {
+            if (start[iaxis] < 0.0f || start[iaxis] >= bounds[iaxis])
+                return false;
+
+            continue;
+        }
+
+        float t0 = (0.0f - start[iaxis]) / direction[iaxis];
+        float t1 = (bounds[iaxis] - start[iaxis]) / direction[iaxis];
+        if (t0 > t1)
+        {
+            std::swap(t0, t1);
+        }
+        tmin = std::max(tmin, t0);
+        tmax = std::min(tmax, t1);
+        if (tmin > tmax)
+            return false;
     }
-    else
+
+    // time of crossing block boundary, it must be computed the same way everywhere to keep traversal consistent
+    auto CrossingTime = [&start, &direction](int iaxis, int boundary)
+    {
+        return (boundary - start[iaxis]) / direction[iaxis];
+    };
+
+    // block boundary which is never crossed within segment
+    const float NeverCrossed = 2.0f;
+
+    glm::ivec3 step;
+    for (int iaxis = 0; iaxis < 3; ++iaxis)
     {
-        stepX = 1;
-        sideDistX = (mapcoord_curr.x + 1.0f - posX) * deltaDistX;
+        step[iaxis] = (direction[iaxis] > 0.0f) ? 1 : (direction[iaxis] < 0.0f) ? -1 : 0;
     }
 
-    if (direction.y < 0.0f)
+    float tcurr = tmin;
+    bool isStartBlock = true;
+    for (;;)
     {
-        stepY = -1;
-        sideDistY = (posY - mapcoord_curr.y) * deltaDistY;
+        // locate block at current position, gets redone each time when empty coarse cell is skipped;
+        // boundaries crossed exactly at current position count as passed, same as when stepping block by block
+        glm::ivec3 block;
+        glm::vec3 tnext;
+        for (int iaxis = 0; iaxis < 3; ++iaxis)
+        {
+            int blockCoord = (int) std::floor(start[iaxis] + direction[iaxis] * tcurr);
+            if (step[iaxis] > 0)
+            {
+                while (CrossingTime(iaxis, blockCoord + 1) <= tcurr) ++blockCoord;
+                while (CrossingTime(iaxis, blockCoord) > tcurr) --blockCoord;
+            }
+            else if (step[iaxis] < 0)
+            {
+                while (CrossingTime(iaxis, blockCoord) <= tcurr) --blockCoord;
+                while (CrossingTime(iaxis, blockCoord + 1) > tcurr) ++blockCoord;
+            }
+            block[iaxis] = glm::clamp(blockCoord, 0, bounds[iaxis] - 1);
+            tnext[iaxis] = step[iaxis] ? CrossingTime(iaxis, block[iaxis] + (step[iaxis] > 0 ? 1 : 0)) : NeverCrossed;
+        }
+
+        for (;;)
+        {
+            const float texit = std::min(std::min(tnext.x, tnext.y), std::min(tnext.z, tmax));
+            if (skipEmptyCells && !mOccupancyCells[block.y][block.z / OccupancyCellSize][block.x / OccupancyCellSize])
+            {
+                // coarse cells are per layer, so vertical exit is the same as for block
+                float tcoarse = std::min(tnext.y, tmax);
+                for (int iaxis = 0; iaxis < 3; iaxis += 2)
+                {
+                    if (step[iaxis] == 0)
+                        continue;
+
+                    const int cellCoord = block[iaxis] / OccupancyCellSize + (step[iaxis] > 0 ? 1 : 0);
+                    tcoarse = std::min(tcoarse, CrossingTime(iaxis, cellCoord * OccupancyCellSize));
+                }
+
+                if (tcoarse >= tmax)
+                    return false;
+
+                if (tcoarse > tcurr)
+                {
+                    tcurr = tcoarse;
+                    isStartBlock = false;
+                    break;
+                }
+            }
+
+            // segment which only touches block edge or corner passes by
+            float hitT = 0.0f;
+            int hitLayer = 0;
+            if ((texit > tcurr || isStartBlock) && 
+                TraceBlock(block, start, direction, tcurr, texit, isStartBlock, excludeWater, hitT, hitLayer))
+            {
+                outResult.mHasHit = true;
+                outResult.mHitFraction = hitT;
+                outResult.mHitPoint = origin + (destination - origin) * hitT;
+                outResult.mHitBlock = glm::ivec3(block.x, hitLayer, block.z);
+                return true;
+            }
+
+            if (texit >= tmax)
+                return false;
+
+            // step to next block across nearest boundary
+            const int iaxis = (tnext.x < tnext.y) ? (tnext.x < tnext.z ? 0 : 2) : (tnext.y < tnext.z ? 1 : 2);
+            block[iaxis] += step[iaxis];
+            if (block[iaxis] < 0 || block[iaxis] >= bounds[iaxis])
+                return false;
+
+            tcurr = tnext[iaxis];
+            tnext[iaxis] = CrossingTime(iaxis, block[iaxis] + (step[iaxis] > 0 ? 1 : 0));
+            isStartBlock = false;
+        }
     }
-    else
+}
+
+bool GameMapManager::TraceBlock(const glm::ivec3& block, const glm::vec3& start, const glm::vec3& direction, 
+    float tenter, float texit, bool isStartBlock, bool excludeWater, float& outHitT, int& outHitLayer) const
+{
+    const int columnIndex = GetBlockAttributesIndexClamp(block.x, block.z, 0);
+
+    // solid block
+    if (mBlocksSlopeTypes[columnIndex + block.y] == 0 && 
+        (mBlocksGroundBits[columnIndex + block.y] & eMapGroundBits_TypeMask) == eGroundType_Building)
     {
-        stepY = 1;
-        sideDistY = (mapcoord_curr.y + 1.0f - posY) * deltaDistY;
+        outHitT = tenter;
+        outHitLayer = block.y;
+        return true;
     }
 
-    //perform DDA
-    const int MaxSteps = 16;
-    for (int istep = 0; ; ++istep)
+    const glm::vec3 enterPoint = start + direction * tenter;
+    const glm::vec3 exitPoint = start + direction * texit;
+
+    // ground surface of block at layer N is within heights [N, N + 1] map units,
+    // so surfaces of current and below layers are checked
+    bool hasHit = false;
+    for (int currLayer = block.y; currLayer >= 0 && currLayer >= block.y - 1; --currLayer)
     {
-        if (istep == MaxSteps)
-            return false;
+        const int slopeType = mBlocksSlopeTypes[columnIndex + currLayer];
+        if (slopeType == 0)
+        {
+            const int groundType = (mBlocksGroundBits[columnIndex + currLayer] & eMapGroundBits_TypeMask);
+            if (groundType == eGroundType_Air || groundType == eGroundType_Building || (groundType == eGroundType_Water && excludeWater))
+                continue;
+        }
 
-        //jump to next map square, OR in x-direction, OR in y-direction
-        if (sideDistX < sideDistY)
+        // surface is planar within block, so distance from segment to it changes linearly
+        const float surfaceBase = currLayer + 0.5f;
+        const float enterDistance = enterPoint.y - (surfaceBase + GameMapHelpers::GetSlopeHeight(slopeType,
+            glm::clamp(enterPoint.x - block.x, 0.0f, 1.0f), 
+            glm::clamp(enterPoint.z - block.z, 0.0f, 1.0f)));
+        const float exitDistance = exitPoint.y - (surfaceBase + GameMapHelpers::GetSlopeHeight(slopeType,
+            glm::clamp(exitPoint.x - block.x, 0.0f, 1.0f), 
+            glm::clamp(exitPoint.z - block.z, 0.0f, 1.0f)));
+
+        float hitT = 0.0f;
+        if (enterDistance < 0.0f)
+        {
+            if (isStartBlock) // segment starts below surface
+                continue;
+
+            hitT = tenter;
+        }
+        else if (exitDistance < 0.0f)
         {
-            sideDistX += deltaDistX;
-            mapcoord_curr.x += stepX;
-            side = 0;
+            hitT = tenter + (texit - tenter) * (enterDistance / (enterDistance - exitDistance));
         }
         else
         {
-            sideDistY += deltaDistY;
-            mapcoord_curr.y += stepY;
-            side = 1;
+            continue;
         }
 
-        // detect hit
-        MapBlockInfo* blockData = GetBlockClamp(mapcoord_curr.x, mapcoord_curr.y, mapcoord_z);
-        if (blockData->mGroundType == eGroundType_Building)
+        if (!hasHit || hitT < outHitT)
         {
-            float perpWallDist;
-            if (side == 0) perpWallDist = (mapcoord_curr.x - posX + (1 - stepX) / 2) / direction.x;
-            else           perpWallDist = (mapcoord_curr.y - posY + (1 - stepY) / 2) / direction.y;
-
-            outPoint = (origin + direction * perpWallDist);
-            return true;
+            outHitT = hitT;
+            outHitLayer = currLayer;
+            hasHit = true;
         }
-
-        if (mapcoord_curr == mapcoord_end)
-            break;
     }
-
-    return false;
+    return hasHit;
 }
 
-bool GameMapManager::ReadStartupObjects(std::ifstream& file, int dataSize)
+bool GameMapManager::ReadStartupObjects(std::ifstream& file, int dataSize, std::vector<StartupObjectPosStruct>& startupObjects) const
 {
     const unsigned int RecordSize = 14;
     debug_assert(dataSize % RecordSize == 0);
 
     int numRecords = dataSize / RecordSize;
 
-    mStartupObjects.resize(numRecords);
-    for (StartupObjectPosStruct& currRecord: mStartupObjects)
+    startupObjects.resize(numRecords);
+    for (StartupObjectPosStruct& currRecord: startupObjects)
     {
         READ_I16(file, currRecord.mX);
         READ_I16(file, currRecord.mY);
@@ -376,7 +1306,41 @@ bool GameMapManager::ReadStartupObjects(std::ifstream& file, int dataSize)
     // remove duplicates -
     // objects list contains a number of identical car records for some reason
     // so it better get rid of them
-    std::set<StartupObjectPosStruct> uniqueObjects {mStartupObjects.begin(), mStartupObjects.end()};
-    mStartupObjects.assign(uniqueObjects.begin(), uniqueObjects.end());
+    std::set<StartupObjectPosStruct> uniqueObjects {startupObjects.begin(), startupObjects.end()};
+    startupObjects.assign(uniqueObjects.begin(), uniqueObjects.end());
+    return true;
+}
+
+bool GameMapManager::ReadStartupObjects(const unsigned char* sourceData, int dataSize, std::vector<StartupObjectPosStruct>& startupObjects) const
+{
+    const unsigned int RecordSize = 14;
+    debug_assert(dataSize % RecordSize == 0);
+
+    int numRecords = dataSize / RecordSize;
+
+    startupObjects.resize(numRecords);
+
+    const unsigned char* recordData = sourceData;
+    for (StartupObjectPosStruct& currRecord: startupObjects)
+    {
+        currRecord.mX = ReadUInt16(recordData + 0);
+        currRecord.mY = ReadUInt16(recordData + 2);
+        currRecord.mZ = ReadUInt16(recordData + 4);
+
+        currRecord.mType = recordData[6];
+        currRecord.mRemap = recordData[7];
+
+        currRecord.mRotation = ReadUInt16(recordData + 8);
+        currRecord.mPitch = ReadUInt16(recordData + 10);
+        currRecord.mRoll = ReadUInt16(recordData + 12);
+
+        recordData += RecordSize;
+    }
+
+    // remove duplicates -
+    // objects list contains a number of identical car records for some reason
+    // so it better get rid of them
+    std::set<StartupObjectPosStruct> uniqueObjects {startupObjects.begin(), startupObjects.end()};
+    startupObjects.assign(uniqueObjects.begin(), uniqueObjects.end());
     return true;
 }
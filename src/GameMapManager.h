@@ -2,6 +2,44 @@
 
 #include "GameDefs.h"
 #include "StyleData.h"
+#include "GameMapChunks.h"
+
+// map data loading options
+enum eMapLoadFlags: unsigned int
+{
+    eMapLoadFlags_None = 0,
+    eMapLoadFlags_MappedFile = BIT(0), // decode data directly from memory mapped file
+    eMapLoadFlags_UseCache = BIT(1), // read decoded data from cache if it is up to date, otherwise write it
+};
+
+decl_enum_as_flags(eMapLoadFlags);
+
+// bit-packed ground attributes of map block, see GameMapManager::GetGroundBitsClamp
+enum eMapGroundBits: unsigned char
+{
+    eMapGroundBits_TypeMask = 0x07, // eGroundType
+    eMapGroundBits_UpDirection = BIT(3),
+    eMapGroundBits_DownDirection = BIT(4),
+    eMapGroundBits_LeftDirection = BIT(5),
+    eMapGroundBits_RightDirection = BIT(6),
+    eMapGroundBits_Railway = BIT(7),
+};
+
+// precomputed ground surface of map column for specific start layer
+struct MapHeightfieldCell
+{
+    unsigned char mHeight; // surface height in map units, slope elevation goes on top of it
+    unsigned char mSlopeType; // 0 if surface is flat
+};
+
+// map segment trace hit information
+struct MapTraceResult
+{
+    glm::vec3 mHitPoint; // meters
+    glm::ivec3 mHitBlock; // map units: x, layer, y
+    float mHitFraction = 0.0f; // position of hit along segment [0, 1]
+    bool mHasHit = false;
+};
 
 /*
     1 map unit == 4.0 meters (see gamedefs)
@@ -27,16 +65,38 @@
     |________|_ _ _ _ _ _ _ _ 0.0 meters (0 map units)
 */
 
+// receives notifications about modifications of map blocks
+class MapBlocksChangeListener
+{
+public:
+    virtual ~MapBlocksChangeListener()
+    {
+    }
+
+    // Map blocks were changed
+    // @param area: Changed blocks location, all layers, map units
+    virtual void MapBlocksChanged(const Rect& area)
+    {
+    }
+};
+
 // this class manages GTA map and style data which get loaded from CMP/G24-files
 class GameMapManager final: public cxx::noncopyable
 {
+    friend class DebugSelfTests;
+
 public:
     // public for convenience
     StyleData mStyleData;
 
     std::vector<StartupObjectPosStruct> mStartupObjects;
 
+    // readonly
+    std::string mMapFileName; // currently loaded map
+
 public:
+    GameMapManager();
+
     // load map data from specific file, returns false on error
     // @param filename: Target file name
     bool LoadFromFile(const std::string& filename);
@@ -49,32 +109,165 @@ public:
 
     // get map block info at specific location
     // note that location coords should never exceed MAP_DIMENSIONS for x,y and MAP_LAYERS_COUNT for layer
+    // blocks with same data share single palette entry, so returned data must not be modified
     // @param coordx, coordy, layer: Block location
-    MapBlockInfo* GetBlock(int coordx, int coordy, int layer) const;
-    MapBlockInfo* GetBlockClamp(int coordx, int coordy, int layer) const;
+    const MapBlockInfo* GetBlock(int coordx, int coordy, int layer) const;
+    const MapBlockInfo* GetBlockClamp(int coordx, int coordy, int layer) const;
+
+    // replace map block data at specific location, derived attributes get updated and listeners get notified
+    // @param coordx, coordy, layer: Block location
+    // @param blockInfo: New block data
+    void SetBlock(int coordx, int coordy, int layer, const MapBlockInfo& blockInfo);
+
+    // add or remove receiver of map blocks modifications notifications
+    // @param listener: Listener
+    void AttachBlocksChangeListener(MapBlocksChangeListener* listener);
+    void DetachBlocksChangeListener(MapBlocksChangeListener* listener);
+
+    // get frequently accessed attributes of map block at specific location, coords are clamped
+    // these read compact per column arrays and should be preferred over GetBlockClamp in hot paths
+    // @param coordx, coordy, layer: Block location
+    inline eGroundType GetGroundTypeClamp(int coordx, int coordy, int layer) const
+    {
+        return (eGroundType) (mBlocksGroundBits[GetBlockAttributesIndexClamp(coordx, coordy, layer)] & eMapGroundBits_TypeMask);
+    }
+    inline unsigned char GetGroundBitsClamp(int coordx, int coordy, int layer) const
+    {
+        return mBlocksGroundBits[GetBlockAttributesIndexClamp(coordx, coordy, layer)];
+    }
+    inline unsigned char GetSlopeTypeClamp(int coordx, int coordy, int layer) const
+    {
+        return mBlocksSlopeTypes[GetBlockAttributesIndexClamp(coordx, coordy, layer)];
+    }
+    // @returns bit per each non empty block face, see eBlockFace
+    inline unsigned char GetFaceBitsClamp(int coordx, int coordy, int layer) const
+    {
+        return mBlocksFaceBits[GetBlockAttributesIndexClamp(coordx, coordy, layer)];
+    }
 
     // Get real height at specified map point
     // @param position: Current position on map, meters
     float GetHeightAtPosition(const glm::vec3& position, bool excludeWater = true) const;
 
-    // get intersection with solid blocks on specific map layer, ignores slopes
-    // @param origin: Start position
-    // @param destination: End position
-    // @param height: Z coord which is map layer
-    // @param outPoint: Intersection point
+    // Get real heights at specified map points at once
+    // @param positions: Current positions on map, meters
+    // @param count: Number of positions
+    // @param outHeights: Output heights, must have room for count elements
+    void GetHeightAtPositions(const glm::vec3* positions, int count, float* outHeights, bool excludeWater = true) const;
+
+    // Get nearest intersection of segment with solid blocks and ground surfaces including slopes, works across all layers
+    // Ground surfaces which contain segment start are ignored
+    // @param origin: Start position, meters
+    // @param destination: End position, meters
+    // @param outResult: Hit information
+    // @param excludeWater: Whether water surface is ignored
     // @returns true if intersection detected or false otherwise
-    bool TraceSegment2D(const glm::vec2& origin, const glm::vec2& destination, float height, glm::vec2& outPoint);
+    bool TraceSegment(const glm::vec3& origin, const glm::vec3& destination, MapTraceResult& outResult, bool excludeWater = true) const;
+
+    // Trace multiple segments at once, large batches are distributed between worker threads
+    // @param origins, destinations: Segments start and end positions, meters
+    // @param count: Number of segments
+    // @param outResults: Output hits information, must have room for count elements
+    void TraceSegments(const glm::vec3* origins, const glm::vec3* destinations, int count, MapTraceResult* outResults, bool excludeWater = true) const;
+
+    // Test whether points are visible from each other
+    // @param origin, destination: Positions, meters
+    bool HasLineOfSight(const glm::vec3& origin, const glm::vec3& destination) const;
 
 private:
     // Reading map data internals
-    // @param file: Source stream
-    bool ReadCompressedMapData(std::ifstream& file, int columnLength, int blockLength);
-    bool ReadStartupObjects(std::ifstream& file, int dataSize);
+    // @param filename: Source file name
+    // @param loadFlags: Loading options
+    // @param sourceData, sourceLength: File content
+    // @param mapChunks, startupObjects: Output decoded data
+    // @param styleNumber: Output style data file number
+    bool ReadCityScapeData(const std::string& filename, eMapLoadFlags loadFlags, int& styleNumber);
+    bool ReadCityScapeStream(const std::string& filename, GameMapChunks& mapChunks, std::vector<StartupObjectPosStruct>& startupObjects, int& styleNumber) const;
+    bool DecodeCityScapeData(const std::string& filename, const unsigned char* sourceData, size_t sourceLength, 
+        GameMapChunks& mapChunks, std::vector<StartupObjectPosStruct>& startupObjects, int& styleNumber) const;
+    bool ReadCompressedMapData(std::ifstream& file, int columnLength, int blocksLength, GameMapChunks& mapChunks) const;
+    bool ReadCompressedMapData(const int* baseData, const unsigned short* columnData, int columnLength, const unsigned char* blocksData, int blocksLength, 
+        GameMapChunks& mapChunks) const;
+    bool BuildMapChunks(const int* baseData, const unsigned short* columnData, int columnElementsCount, const std::vector<MapBlockInfo>& blocksList, 
+        GameMapChunks& mapChunks) const;
+    bool ReadStartupObjects(std::ifstream& file, int dataSize, std::vector<StartupObjectPosStruct>& startupObjects) const;
+    bool ReadStartupObjects(const unsigned char* sourceData, int dataSize, std::vector<StartupObjectPosStruct>& startupObjects) const;
     void FixShiftedBits();
 
+    // Fill compact blocks attributes arrays from blocks data
+    void BuildBlocksAttributes();
+    void BuildColumnAttributes(int coordx, int coordy);
+
+    // Fill heightfield from compact blocks attributes
+    void BuildHeightfield();
+    void BuildColumnHeightfield(int coordx, int coordy);
+
+    // Find surface below position using precomputed heightfield
+    // @param columns: Heightfield variant
+    // @param position: Position on map, meters
+    // @param surfaceHeight: Output surface height without slope, map units
+    // @param subPosition: Output position within surface block
+    // @returns slope type of surface block
+    inline int GetSurfaceAtPosition(const MapHeightfieldCell* columns, const glm::vec3& position, float& surfaceHeight, glm::vec2& subPosition) const;
+
+    // Compute height using precomputed heightfield
+    // @param columns: Heightfield variant
+    // @param position: Position on map, meters
+    inline float ComputeHeightAtPosition(const MapHeightfieldCell* columns, const glm::vec3& position) const;
+
+    inline int GetBlockAttributesIndexClamp(int coordx, int coordy, int layer) const
+    {
+        coordx = glm::clamp(coordx, 0, MAP_DIMENSIONS - 1);
+        coordy = glm::clamp(coordy, 0, MAP_DIMENSIONS - 1);
+        layer = glm::clamp(layer, 0, MAP_LAYERS_COUNT - 1);
+        return (coordy * MAP_DIMENSIONS + coordx) * MAP_LAYERS_COUNT + layer;
+    }
+
+    // Segment trace internals, trace is done in grid space where each map block is unit cube
+    // @param skipEmptyCells: Whether coarse occupancy cells are used to skip empty space
+    bool TraceSegmentInternal(const glm::vec3& origin, const glm::vec3& destination, bool excludeWater, bool skipEmptyCells, MapTraceResult& outResult) const;
+    bool TraceBlock(const glm::ivec3& block, const glm::vec3& start, const glm::vec3& direction, 
+        float tenter, float texit, bool isStartBlock, bool excludeWater, float& outHitT, int& outHitLayer) const;
+
+    // Fill coarse occupancy cells from compact blocks attributes
+    void BuildOccupancyCells();
+    void BuildOccupancyCell(int cellx, int celly);
+
+    // Decoded map data cache internals, cache files are stored next to user config
+    // @param filename: Source file name
+    // @param sourceHash: Hash of source file content
+    // @param cachePath: Cache file path
+    // @param mapChunks, heightfield, startupObjects: Output cached data, heightfield points to all variants
+    // @param styleNumber: Style data file number
+    bool GetMapCachePath(const std::string& filename, std::string& cachePath) const;
+    bool ReadMapCache(const std::string& cachePath, unsigned long long sourceHash, GameMapChunks& mapChunks, 
+        std::vector<MapHeightfieldCell>* heightfield, std::vector<StartupObjectPosStruct>& startupObjects, int& styleNumber) const;
+    bool WriteMapCache(const std::string& cachePath, unsigned long long sourceHash, int styleNumber) const;
+
+    // Compute hash of source file content which identifies its cache file
+    // @param sourceData, sourceLength: File content
+    static unsigned long long ComputeDataHash(const void* sourceData, size_t sourceLength);
+
 private:
-    MapBlockInfo mMapTiles[MAP_LAYERS_COUNT][MAP_DIMENSIONS][MAP_DIMENSIONS]; // z, y, x
-    int mBaseTilesData[MAP_DIMENSIONS][MAP_DIMENSIONS]; // y x
+    GameMapChunks mMapChunks;
+
+    // structure of arrays copy of frequently accessed blocks fields, 
+    // blocks of single map column are stored sequentially from bottom to top layer
+    enum { BlocksAttributesCount = MAP_DIMENSIONS * MAP_DIMENSIONS * MAP_LAYERS_COUNT };
+    std::vector<unsigned char> mBlocksGroundBits; // eMapGroundBits
+    std::vector<unsigned char> mBlocksSlopeTypes;
+    std::vector<unsigned char> mBlocksFaceBits;
+
+    // surface of each map column for every start layer, with water treated as solid ground or not
+    // cells have the same layout as blocks attributes
+    enum { HeightfieldWithWater, HeightfieldExcludeWater, HeightfieldVariantsCount };
+    std::vector<MapHeightfieldCell> mHeightfield[HeightfieldVariantsCount];
+
+    // coarse occupancy of each map layer, cell is empty if trace cannot hit anything within its blocks
+    enum { OccupancyCellSize = 8, OccupancyCellsDimensions = MAP_DIMENSIONS / OccupancyCellSize };
+    bool mOccupancyCells[MAP_LAYERS_COUNT][OccupancyCellsDimensions][OccupancyCellsDimensions]; // layer, y, x
+
+    std::vector<MapBlocksChangeListener*> mBlocksChangeListeners;
 };
 
 extern GameMapManager gGameMap;
\ No newline at end of file
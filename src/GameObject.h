@@ -9,6 +9,7 @@ class DebugRenderer;
 class GameObject: public cxx::noncopyable
 {
     friend class GameObjectsManager;
+    friend class GameObjectsGrid;
     friend class MapRenderer;
 
 public:
@@ -84,4 +85,8 @@ private:
     bool mMarkedForDeletion = false;
 
     unsigned int mLastRenderFrame = 0; // render frames counter
+
+    // location in objects grid, see GameObjectsGrid
+    int mGridCellIndex = -1;
+    int mGridSlotIndex = -1;
 };
\ No newline at end of file
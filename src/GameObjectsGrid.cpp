@@ -0,0 +1,120 @@
+#include "stdafx.h"
+#include "GameObjectsGrid.h"
+#include "GameObject.h"
+
+GameObjectsGrid::~GameObjectsGrid()
+{
+    Cleanup();
+}
+
+void GameObjectsGrid::Setup(float cellSize)
+{
+    debug_assert(cellSize > 0.0f);
+
+    Cleanup();
+
+    const float mapSize = Convert::MapUnitsToMeters(MAP_DIMENSIONS * 1.0f);
+
+    mCellSize = cellSize;
+    mCellsPerSide = (int) std::ceil(mapSize / cellSize);
+    mCells.resize(mCellsPerSide * mCellsPerSide);
+}
+
+void GameObjectsGrid::Cleanup()
+{
+    for (std::vector<GameObject*>& currCell: mCells)
+    {
+        for (GameObject* currObject: currCell)
+        {
+            currObject->mGridCellIndex = -1;
+            currObject->mGridSlotIndex = -1;
+        }
+    }
+    mCells.clear();
+    mCellsPerSide = 0;
+    mCellSize = 0.0f;
+    mMaxObjectRadius = 0.0f;
+    mObjectsCount = 0;
+}
+
+void GameObjectsGrid::UpdateObject(GameObject* gameObject, const glm::vec2& position, float radius)
+{
+    debug_assert(gameObject);
+    debug_assert(mCellsPerSide > 0);
+
+    mMaxObjectRadius = std::max(mMaxObjectRadius, radius);
+
+    const int cellIndex = GetCellIndex(position);
+    if (gameObject->mGridCellIndex == cellIndex)
+        return;
+
+    RemoveObject(gameObject);
+
+    std::vector<GameObject*>& cell = mCells[cellIndex];
+    gameObject->mGridCellIndex = cellIndex;
+    gameObject->mGridSlotIndex = (int) cell.size();
+    cell.push_back(gameObject);
+    ++mObjectsCount;
+}
+
+void GameObjectsGrid::RemoveObject(GameObject* gameObject)
+{
+    debug_assert(gameObject);
+
+    if (gameObject->mGridCellIndex == -1)
+        return;
+
+    debug_assert(gameObject->mGridCellIndex < (int) mCells.size());
+    std::vector<GameObject*>& cell = mCells[gameObject->mGridCellIndex];
+    debug_assert(cell[gameObject->mGridSlotIndex] == gameObject);
+
+    // move last object of cell to freed slot
+    GameObject* lastObject = cell.back();
+    lastObject->mGridSlotIndex = gameObject->mGridSlotIndex;
+    cell[gameObject->mGridSlotIndex] = lastObject;
+    cell.pop_back();
+
+    gameObject->mGridCellIndex = -1;
+    gameObject->mGridSlotIndex = -1;
+    --mObjectsCount;
+}
+
+void GameObjectsGrid::QueryObjects(const glm::vec2& areaMin, const glm::vec2& areaMax, std::vector<GameObject*>& outObjects) const
+{
+    outObjects.clear();
+    if (mCellsPerSide == 0)
+        return;
+
+    // objects are stored by center, so area is extended to catch ones that stick out of their cells
+    const glm::vec2 extent { mMaxObjectRadius, mMaxObjectRadius };
+    const int minCell = GetCellIndex(areaMin - extent);
+    const int maxCell = GetCellIndex(areaMax + extent);
+
+    const int minCellx = minCell % mCellsPerSide;
+    const int minCelly = minCell / mCellsPerSide;
+    const int maxCellx = maxCell % mCellsPerSide;
+    const int maxCelly = maxCell / mCellsPerSide;
+    for (int celly = minCelly; celly <= maxCelly; ++celly)
+    {
+        for (int cellx = minCellx; cellx <= maxCellx; ++cellx)
+        {
+            const std::vector<GameObject*>& cell = mCells[celly * mCellsPerSide + cellx];
+            outObjects.insert(outObjects.end(), cell.begin(), cell.end());
+        }
+    }
+}
+
+bool GameObjectsGrid::ContainsObject(GameObject* gameObject) const
+{
+    debug_assert(gameObject);
+    return gameObject->mGridCellIndex != -1;
+}
+
+int GameObjectsGrid::GetCellIndex(const glm::vec2& position) const
+{
+    // clamp before conversion, far points of huge areas may not fit in int
+    const float maxCell = (mCellsPerSide - 1) * 1.0f;
+    const int cellx = (int) glm::clamp(std::floor(position.x / mCellSize), 0.0f, maxCell);
+    const int celly = (int) glm::clamp(std::floor(position.y / mCellSize), 0.0f, maxCell);
+    return celly * mCellsPerSide + cellx;
+}
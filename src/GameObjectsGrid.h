@@ -0,0 +1,55 @@
+#pragma once
+
+#include "GameDefs.h"
+
+class GameObject;
+
+// uniform grid over map area which keeps game objects by location of their sprites,
+// each object is kept in single cell containing its center so it must be updated once object moves,
+// objects outside of map are kept in border cells
+class GameObjectsGrid final: public cxx::noncopyable
+{
+public:
+    ~GameObjectsGrid();
+
+    // Setup empty grid covering whole map
+    // @param cellSize: Cell width and depth in meters
+    void Setup(float cellSize);
+
+    // Remove all objects from grid and free cells
+    void Cleanup();
+
+    // Put object to cell at its location, does nothing if object did not leave its current cell
+    // @param gameObject: Object
+    // @param position: Object center, x and z world coordinates
+    // @param radius: Distance from center to farthest point of object on horizontal plane
+    void UpdateObject(GameObject* gameObject, const glm::vec2& position, float radius);
+
+    // Remove object from grid, does nothing if object is not in grid
+    // @param gameObject: Object
+    void RemoveObject(GameObject* gameObject);
+
+    // Find objects that may overlap area, cells are expanded by largest radius of objects so none gets missed
+    // @param areaMin, areaMax: Area bounds, x and z world coordinates
+    // @param outObjects: Output objects list, it gets cleared first
+    void QueryObjects(const glm::vec2& areaMin, const glm::vec2& areaMax, std::vector<GameObject*>& outObjects) const;
+
+    // Test whether object is in grid
+    // @param gameObject: Object
+    bool ContainsObject(GameObject* gameObject) const;
+
+    // Get number of objects in grid
+    inline int GetObjectsCount() const { return mObjectsCount; }
+
+private:
+    // get index of cell containing point, out of map points are clamped to border cells
+    // @param position: Point, x and z world coordinates
+    int GetCellIndex(const glm::vec2& position) const;
+
+private:
+    std::vector<std::vector<GameObject*>> mCells; // row by row
+    int mCellsPerSide = 0;
+    float mCellSize = 0.0f;
+    float mMaxObjectRadius = 0.0f; // never shrinks until cleanup
+    int mObjectsCount = 0;
+};
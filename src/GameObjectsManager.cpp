@@ -278,6 +278,8 @@ void GameObjectsManager::DestroyGameObject(GameObject* object)
     cxx::erase_elements(mDeleteObjectsList, object);
     cxx::erase_elements(mAllObjectsList, object);
 
+    gRenderManager.mMapRenderer.RemoveGameObject(object);
+
     switch (object->mClassID)
     {
         case eGameObjectClass_Pedestrian:
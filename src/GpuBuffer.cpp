@@ -68,8 +68,29 @@ void GpuBuffer::SetUnbound()
     }
 }
 
+void GpuBuffer::RecreateBufferObject()
+{
+    SetUnbound();
+
+    // persistent mapping gets released along with buffer object
+    ::glDeleteBuffers(1, &mResourceHandle);
+    glCheckError();
+    ::glGenBuffers(1, &mResourceHandle);
+    glCheckError();
+
+    mPersistentData = nullptr;
+    mBufferLength = 0;
+    mBufferCapacity = 0;
+}
+
 bool GpuBuffer::Setup(eBufferUsage bufferUsage, unsigned int bufferLength, const void* dataBuffer)
 {
+    // storage of persistent buffer is immutable
+    if (IsBufferPersistent())
+    {
+        RecreateBufferObject();
+    }
+
     unsigned int paddedContentLength = (bufferLength + 15U) & (~15U);
 
     mBufferLength = bufferLength;
@@ -103,9 +124,44 @@ bool GpuBuffer::Setup(eBufferUsage bufferUsage, unsigned int bufferLength, const
     return true;
 }
 
+bool GpuBuffer::SetupPersistent(unsigned int bufferLength)
+{
+    debug_assert(bufferLength > 0);
+
+    // immutable storage cannot be respecified, new buffer object is required
+    if (IsBufferInited())
+    {
+        RecreateBufferObject();
+    }
+
+    unsigned int paddedContentLength = (bufferLength + 15U) & (~15U);
+
+    ScopedBufferBinder scopedBind (mGraphicsContext, this);
+    GLenum bufferTargetGL = EnumToGL(mContent);
+    GLbitfield storageFlagsGL = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    ::glBufferStorage(bufferTargetGL, paddedContentLength, nullptr, storageFlagsGL);
+    glCheckError();
+
+    void* pMappedData = ::glMapBufferRange(bufferTargetGL, 0, paddedContentLength, storageFlagsGL);
+    glCheckError();
+    if (pMappedData == nullptr)
+    {
+        debug_assert(false);
+        // buffer object have immutable storage at this point
+        RecreateBufferObject();
+        return false;
+    }
+
+    mBufferLength = bufferLength;
+    mBufferCapacity = paddedContentLength;
+    mUsageHint = eBufferUsage_Stream;
+    mPersistentData = pMappedData;
+    return true;
+}
+
 bool GpuBuffer::Resize(unsigned int newLength)
 {
-    if (!IsBufferInited())
+    if (!IsBufferInited() || IsBufferPersistent())
     {
         debug_assert(false);
         return false;
@@ -165,14 +221,14 @@ bool GpuBuffer::Resize(unsigned int newLength)
 
 bool GpuBuffer::SubData(unsigned int dataOffset, unsigned int dataLength, const void* dataSource)
 {
-    if (!IsBufferInited())
+    if (!IsBufferInited() || IsBufferPersistent())
     {
         debug_assert(false);
         return false;
     }
 
     debug_assert(dataLength && dataSource);
-    debug_assert(dataOffset + dataLength < mBufferCapacity);
+    debug_assert(dataOffset + dataLength <= mBufferCapacity);
 
     ScopedBufferBinder scopedBind (mGraphicsContext, this);
     GLenum bufferTargetGL = EnumToGL(mContent);
@@ -189,7 +245,7 @@ void* GpuBuffer::Lock(BufferAccessBits accessBits)
 
 void* GpuBuffer::Lock(BufferAccessBits accessBits, unsigned int bufferOffset, unsigned int dataLength)
 {
-    if (!IsBufferInited())
+    if (!IsBufferInited() || IsBufferPersistent())
     {
         debug_assert(false);
         return nullptr;
@@ -220,7 +276,7 @@ void* GpuBuffer::Lock(BufferAccessBits accessBits, unsigned int bufferOffset, un
 
 bool GpuBuffer::Unlock()
 {
-    if (!IsBufferInited())
+    if (!IsBufferInited() || IsBufferPersistent())
     {
         debug_assert(false);
         return false;
@@ -235,7 +291,7 @@ bool GpuBuffer::Unlock()
 
 void GpuBuffer::Invalidate()
 {
-    if (!IsBufferInited())
+    if (!IsBufferInited() || IsBufferPersistent())
     {
         debug_assert(false);
         return;
@@ -12,6 +12,7 @@ public:
     eBufferUsage mUsageHint;
     unsigned int mBufferLength; // user requested length, bytes
     unsigned int mBufferCapacity; // actually allocated length, bytes
+    void* mPersistentData = nullptr; // mapped memory of persistent buffer, null for regular buffers
 
 public:
     // @param bufferContent: Content type stored in buffer, cannot be changed 
@@ -25,6 +26,14 @@ public:
     // @returns false if out of memory
     bool Setup(eBufferUsage bufferUsage, unsigned int bufferLength, const void* dataBuffer);
 
+    // Will drop buffer data and allocate immutable chunk of gpu memory which stays mapped for writing until buffer is destroyed,
+    // mapping is coherent so written data is visible to subsequent draw calls without explicit flush,
+    // client must not write to regions which are still in use by gpu
+    // Requires eGraphicsFeature_BufferStorage
+    // @param bufferLength: Data length
+    // @returns false on fail
+    bool SetupPersistent(unsigned int bufferLength);
+
     // Upload source data to buffer replacing old content
     // @param dataOffset: Offset within buffer to write in bytes
     // @param dataLength: Size of data to write in bytes
@@ -68,8 +77,12 @@ public:
     // Test whether buffer is created
     bool IsBufferInited() const;
 
+    // Test whether buffer data is persistently mapped
+    inline bool IsBufferPersistent() const { return mPersistentData != nullptr; }
+
 private:
     void SetUnbound();
+    void RecreateBufferObject();
 
 private:
     GraphicsContext& mGraphicsContext;
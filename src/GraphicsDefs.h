@@ -14,6 +14,7 @@ using GpuProgramHandle = unsigned int;
 using GpuBufferHandle = unsigned int;
 using GpuTextureHandle = unsigned int;
 using GpuVertexArrayHandle = unsigned int;
+using GpuFenceHandle = void*;
 using GpuVariableLocation = int;
 
 // predefined value for unspecified render program variable location
@@ -328,9 +329,12 @@ enum eVertexAttributeFormat
 {
     eVertexAttributeFormat_2F,      // 2 floats
     eVertexAttributeFormat_3F,      // 3 floats
+    eVertexAttributeFormat_4F,      // 4 floats
     eVertexAttributeFormat_4UB,     // 4 unsigned bytes
     eVertexAttributeFormat_1US,     // 1 unsigned short
     eVertexAttributeFormat_2US,     // 2 unsigned shorts
+    eVertexAttributeFormat_4B,      // 4 signed bytes
+    eVertexAttributeFormat_4S,      // 4 signed shorts
     eVertexAttributeFormat_Unknown
 };
 
@@ -360,9 +364,12 @@ inline unsigned int GetAttributeComponentCount(eVertexAttributeFormat attributeF
     {
         case eVertexAttributeFormat_2F: return 2;
         case eVertexAttributeFormat_3F: return 3;
+        case eVertexAttributeFormat_4F: return 4;
         case eVertexAttributeFormat_4UB: return 4;
         case eVertexAttributeFormat_1US: return 1;
         case eVertexAttributeFormat_2US: return 2;
+        case eVertexAttributeFormat_4B: return 4;
+        case eVertexAttributeFormat_4S: return 4;
     }
     debug_assert(false);
     return 0;
@@ -376,9 +383,12 @@ inline unsigned int GetAttributeSizeBytes(eVertexAttributeFormat attributeFormat
     {
         case eVertexAttributeFormat_2F: return 2 * sizeof(float);
         case eVertexAttributeFormat_3F: return 3 * sizeof(float);
+        case eVertexAttributeFormat_4F: return 4 * sizeof(float);
         case eVertexAttributeFormat_4UB: return 4 * sizeof(unsigned char);
         case eVertexAttributeFormat_1US: return 1 * sizeof(unsigned short);
         case eVertexAttributeFormat_2US: return 2 * sizeof(unsigned short);
+        case eVertexAttributeFormat_4B: return 4 * sizeof(signed char);
+        case eVertexAttributeFormat_4S: return 4 * sizeof(short);
     }
     debug_assert(false);
     return 0;
@@ -424,6 +434,7 @@ public:
     SingleAttribute mAttributes[eVertexAttribute_COUNT];
     unsigned int mDataStride = 0; // common to all attributes
     unsigned int mBaseOffset = 0; // additional offset in bytes within source vertex buffer, affects on all attribues
+    unsigned int mInstanceDivisor = 0; // if non zero, attributes advance once per specified number of instances rather than per vertex
 };
 
 // standard engine vertex definition
@@ -509,11 +520,25 @@ enum eBufferContent
 {
     eBufferContent_Vertices,
     eBufferContent_Indices,
+    eBufferContent_DrawIndirect, // indexed draw commands, see DrawIndexedCommand
     eBufferContent_COUNT
 };
 
 decl_enum_strings(eBufferContent);
 
+// defines single indexed draw, memory layout matches indirect draw command expected by gpu
+struct DrawIndexedCommand
+{
+public:
+    unsigned int mIndicesCount;
+    unsigned int mInstanceCount;
+    unsigned int mFirstIndex; // offset within index buffer, elements
+    int mBaseVertex;
+    unsigned int mBaseInstance;
+};
+
+const unsigned int Sizeof_DrawIndexedCommand = sizeof(DrawIndexedCommand);
+
 enum eBufferUsage
 {
     eBufferUsage_Static, // The data store contents will be modified once and used many times
@@ -543,6 +568,7 @@ enum eRenderUniform
     eRenderUniform_ViewProjectionMatrix,
     eRenderUniform_NormalMatrix,         
     eRenderUniform_CameraPosition, // world space camera position
+    eRenderUniform_AnimationCycle, // game cycles elapsed since animation started
     eRenderUniform_COUNT
 };
 
@@ -701,6 +727,8 @@ enum eGraphicsFeature
 {
     eGraphicsFeature_NPOT_Textures,
     eGraphicsFeature_ABGR,
+    eGraphicsFeature_MultiDrawIndirect,
+    eGraphicsFeature_BufferStorage,
     eGraphicsFeature_COUNT
 };
 
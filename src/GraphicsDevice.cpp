@@ -525,6 +525,60 @@ GpuBuffer* GraphicsDevice::CreateBuffer(eBufferContent bufferContent, eBufferUsa
     return bufferObject;
 }
 
+GpuFenceHandle GraphicsDevice::CreateFence()
+{
+    if (!IsDeviceInited())
+    {
+        debug_assert(false);
+        return nullptr;
+    }
+    GLsync fenceGL = ::glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    glCheckError();
+    return fenceGL;
+}
+
+void GraphicsDevice::WaitFence(GpuFenceHandle fence)
+{
+    if (!IsDeviceInited())
+    {
+        debug_assert(false);
+        return;
+    }
+    debug_assert(fence);
+
+    const GLuint64 WaitTimeoutNanoseconds = 1000000; // 1 ms
+
+    // first check is done without flush, in most cases fence is signaled already
+    GLbitfield waitFlagsGL = 0;
+    GLuint64 waitTimeout = 0;
+    for (;;)
+    {
+        GLenum waitResult = ::glClientWaitSync((GLsync) fence, waitFlagsGL, waitTimeout);
+        glCheckError();
+        if (waitResult != GL_TIMEOUT_EXPIRED)
+        {
+            debug_assert(waitResult != GL_WAIT_FAILED);
+            break;
+        }
+        waitFlagsGL = GL_SYNC_FLUSH_COMMANDS_BIT;
+        waitTimeout = WaitTimeoutNanoseconds;
+    }
+}
+
+void GraphicsDevice::DestroyFence(GpuFenceHandle fence)
+{
+    if (!IsDeviceInited())
+    {
+        debug_assert(false);
+        return;
+    }
+    if (fence)
+    {
+        ::glDeleteSync((GLsync) fence);
+        glCheckError();
+    }
+}
+
 void GraphicsDevice::BindVertexBuffer(GpuBuffer* sourceBuffer, const VertexFormat& streamDefinition)
 {
     if (!IsDeviceInited())
@@ -772,6 +826,88 @@ void GraphicsDevice::RenderIndexedPrimitives(ePrimitiveType primitive, eIndicesT
     glCheckError();
 }
 
+void GraphicsDevice::RenderIndexedPrimitivesInstanced(ePrimitiveType primitive, eIndicesType indices, unsigned int offset, unsigned int numIndices, unsigned int numInstances)
+{
+    if (!IsDeviceInited())
+    {
+        debug_assert(false);
+        return;
+    }
+
+    GpuBuffer* indexBuffer = mGraphicsContext.mCurrentBuffers[eBufferContent_Indices];
+    GpuBuffer* vertexBuffer = mGraphicsContext.mCurrentBuffers[eBufferContent_Vertices];
+    debug_assert(indexBuffer && vertexBuffer && mGraphicsContext.mCurrentProgram);
+
+    GLenum primitives = EnumToGL(primitive);
+    GLenum indicesTypeGL = EnumToGL(indices);
+    ::glDrawElementsInstanced(primitives, numIndices, indicesTypeGL, BUFFER_OFFSET(offset), numInstances);
+    glCheckError();
+}
+
+void GraphicsDevice::RenderIndexedPrimitives(ePrimitiveType primitive, eIndicesType indices, const DrawIndexedCommand* commands, int numCommands)
+{
+    if (!IsDeviceInited())
+    {
+        debug_assert(false);
+        return;
+    }
+
+    GpuBuffer* indexBuffer = mGraphicsContext.mCurrentBuffers[eBufferContent_Indices];
+    GpuBuffer* vertexBuffer = mGraphicsContext.mCurrentBuffers[eBufferContent_Vertices];
+    debug_assert(indexBuffer && vertexBuffer && mGraphicsContext.mCurrentProgram);
+    debug_assert(commands || numCommands == 0);
+
+    if (numCommands < 1)
+        return;
+
+    const unsigned int indexSize = (indices == eIndicesType_i16) ? sizeof(unsigned short) : sizeof(unsigned int);
+
+    mMultiDrawCounts.resize(numCommands);
+    mMultiDrawOffsets.resize(numCommands);
+    for (int icommand = 0; icommand < numCommands; ++icommand)
+    {
+        debug_assert(commands[icommand].mBaseVertex == 0);
+        mMultiDrawCounts[icommand] = (int) commands[icommand].mIndicesCount;
+        mMultiDrawOffsets[icommand] = BUFFER_OFFSET(commands[icommand].mFirstIndex * indexSize);
+    }
+
+    GLenum primitives = EnumToGL(primitive);
+    GLenum indicesTypeGL = EnumToGL(indices);
+    ::glMultiDrawElements(primitives, mMultiDrawCounts.data(), indicesTypeGL, mMultiDrawOffsets.data(), numCommands);
+    glCheckError();
+}
+
+void GraphicsDevice::RenderIndexedPrimitivesIndirect(ePrimitiveType primitive, eIndicesType indices, GpuBuffer* commandsBuffer, unsigned int offset, int numCommands)
+{
+    if (!IsDeviceInited())
+    {
+        debug_assert(false);
+        return;
+    }
+
+    GpuBuffer* indexBuffer = mGraphicsContext.mCurrentBuffers[eBufferContent_Indices];
+    GpuBuffer* vertexBuffer = mGraphicsContext.mCurrentBuffers[eBufferContent_Vertices];
+    debug_assert(indexBuffer && vertexBuffer && mGraphicsContext.mCurrentProgram);
+    debug_assert(commandsBuffer && commandsBuffer->mContent == eBufferContent_DrawIndirect);
+    debug_assert(mCaps.mFeatures[eGraphicsFeature_MultiDrawIndirect]);
+
+    if (numCommands < 1)
+        return;
+
+    if (mGraphicsContext.mCurrentBuffers[eBufferContent_DrawIndirect] != commandsBuffer)
+    {
+        GLenum bufferTargetGL = EnumToGL(eBufferContent_DrawIndirect);
+        mGraphicsContext.mCurrentBuffers[eBufferContent_DrawIndirect] = commandsBuffer;
+        ::glBindBuffer(bufferTargetGL, commandsBuffer->mResourceHandle);
+        glCheckError();
+    }
+
+    GLenum primitives = EnumToGL(primitive);
+    GLenum indicesTypeGL = EnumToGL(indices);
+    ::glMultiDrawElementsIndirect(primitives, indicesTypeGL, BUFFER_OFFSET(offset), numCommands, Sizeof_DrawIndexedCommand);
+    glCheckError();
+}
+
 void GraphicsDevice::RenderPrimitives(ePrimitiveType primitiveType, unsigned int firstIndex, unsigned int numElements)
 {
     if (!IsDeviceInited())
@@ -997,6 +1133,10 @@ void GraphicsDevice::SetupVertexAttributes(const VertexFormat& streamDefinition)
                 streamDefinition.mDataStride, BUFFER_OFFSET(attribute.mDataOffset + streamDefinition.mBaseOffset));
             glCheckError();
         }
+
+        // divisor is kept by attribute location, so it must be reset for regular vertex formats
+        ::glVertexAttribDivisor(currentProgram->mAttributes[iattribute], streamDefinition.mInstanceDivisor);
+        glCheckError();
     }
 }
 
@@ -1156,6 +1296,8 @@ void GraphicsDevice::QueryGraphicsDeviceCaps()
 {
     mCaps.mFeatures[eGraphicsFeature_NPOT_Textures] = (GLEW_ARB_texture_non_power_of_two == GL_TRUE);
     mCaps.mFeatures[eGraphicsFeature_ABGR] = (GLEW_EXT_abgr == GL_TRUE);
+    mCaps.mFeatures[eGraphicsFeature_MultiDrawIndirect] = (GLEW_VERSION_4_3 == GL_TRUE) || (GLEW_ARB_multi_draw_indirect == GL_TRUE);
+    mCaps.mFeatures[eGraphicsFeature_BufferStorage] = (GLEW_VERSION_4_4 == GL_TRUE) || (GLEW_ARB_buffer_storage == GL_TRUE);
 
     ::glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &mCaps.mMaxTextureBufferSize);
     glCheckError();
@@ -1166,6 +1308,8 @@ void GraphicsDevice::QueryGraphicsDeviceCaps()
     gConsole.LogMessage(eLogMessage_Info, "Graphics Device caps:");
     gConsole.LogMessage(eLogMessage_Info, " - max array texture layers: %d", mCaps.mMaxArrayTextureLayers);
     gConsole.LogMessage(eLogMessage_Info, " - max texture buffer size: %d bytes", mCaps.mMaxTextureBufferSize);
+    gConsole.LogMessage(eLogMessage_Info, " - multi draw indirect: %s", mCaps.mFeatures[eGraphicsFeature_MultiDrawIndirect] ? "yes" : "no");
+    gConsole.LogMessage(eLogMessage_Info, " - buffer storage: %s", mCaps.mFeatures[eGraphicsFeature_BufferStorage] ? "yes" : "no");
 }
 
 void GraphicsDevice::ActivateTextureUnit(eTextureUnit textureUnit)
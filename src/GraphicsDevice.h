@@ -75,6 +75,18 @@ public:
     GpuBuffer* CreateBuffer(eBufferContent bufferContent);
     GpuBuffer* CreateBuffer(eBufferContent bufferContent, eBufferUsage bufferUsage, unsigned int bufferLength, const void* dataBuffer);
 
+    // Insert fence into command stream, it gets signaled when gpu completes all previously issued commands
+    // Client is responsible for destroying fence
+    GpuFenceHandle CreateFence();
+
+    // Block until fence gets signaled
+    // @param fence: Fence handle
+    void WaitFence(GpuFenceHandle fence);
+
+    // Free fence object
+    // @param fence: Fence handle
+    void DestroyFence(GpuFenceHandle fence);
+
     // Set source buffer for geometries vertex data and setup layout for bound shader
     // @param sourceBuffer: Buffer reference or nullptr to unbind current
     // @param streamDefinition: Layout
@@ -125,6 +137,31 @@ public:
     void RenderIndexedPrimitives(ePrimitiveType primitive, eIndicesType indicesType, unsigned int offset, unsigned int numIndices);
     void RenderIndexedPrimitives(ePrimitiveType primitive, eIndicesType indicesType, unsigned int offset, unsigned int numIndices, unsigned int baseVertex);
 
+    // Render multiple instances of indexed geometry, per instance attributes are defined by vertex format instance divisor
+    // @param primitive: Type of primitives to render
+    // @param indicesType: Type of indices data
+    // @param offset: Offset within index buffer in bytes
+    // @param numIndices: Number of elements per instance
+    // @param numInstances: Number of instances
+    void RenderIndexedPrimitivesInstanced(ePrimitiveType primitive, eIndicesType indicesType, unsigned int offset, unsigned int numIndices, unsigned int numInstances);
+
+    // Render multiple ranges of indexed geometry with single call
+    // Instance count and base instance of commands are ignored
+    // @param primitive: Type of primitives to render
+    // @param indicesType: Type of indices data
+    // @param commands: Draw commands
+    // @param numCommands: Number of draw commands
+    void RenderIndexedPrimitives(ePrimitiveType primitive, eIndicesType indicesType, const DrawIndexedCommand* commands, int numCommands);
+
+    // Render multiple ranges of indexed geometry with single call, draw commands are sourced from gpu buffer
+    // Requires eGraphicsFeature_MultiDrawIndirect
+    // @param primitive: Type of primitives to render
+    // @param indicesType: Type of indices data
+    // @param commandsBuffer: Buffer with draw commands
+    // @param offset: Offset within commands buffer in bytes
+    // @param numCommands: Number of draw commands
+    void RenderIndexedPrimitivesIndirect(ePrimitiveType primitive, eIndicesType indicesType, GpuBuffer* commandsBuffer, unsigned int offset, int numCommands);
+
     // Render geometry
     // @param primitiveType: Type of primitives to render
     // @param firstIndex: Start position in attribute buffers, index
@@ -168,6 +205,10 @@ private:
     GraphicsContext mGraphicsContext;
     GLFWwindow* mGraphicsWindow;
     GLFWmonitor* mGraphicsMonitor;
+
+    // multi draw parameters, cached to avoid allocations
+    std::vector<int> mMultiDrawCounts;
+    std::vector<const void*> mMultiDrawOffsets;
 };
 
 extern GraphicsDevice gGraphicsDevice;
\ No newline at end of file
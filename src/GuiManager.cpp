@@ -32,10 +32,29 @@ void GuiManager::Deinit()
     gFontManager.Cleanup();
 }
 
-void GuiManager::RenderFrame()
+void GuiManager::PrepareFrame()
 {
-    mSpriteBatch.BeginBatch(SpriteBatch::DepthAxis_Z, eSpritesSortMode_None);
+    mHUDSnapshots.resize(gCarnageGame.mNumPlayers);
+    for (int icurr = 0; icurr < gCarnageGame.mNumPlayers; ++icurr)
+    {
+        CarnageGame::HumanCharacterSlot& currPlayer = gCarnageGame.mHumanSlot[icurr];
+        HUDSnapshot& currSnapshot = mHUDSnapshots[icurr];
+        currSnapshot.mViewportRect = currPlayer.mCharView.mCamera.mViewportRect;
+
+        mCamera2D.SetIdentity();
+        mCamera2D.mViewportRect = currSnapshot.mViewportRect;
+        mCamera2D.SetProjection(0.0f, mCamera2D.mViewportRect.w * 1.0f, mCamera2D.mViewportRect.h * 1.0f, 0.0f);
+
+        mSpriteBatch.BeginBatch(eSpritesSortMode_None);
 
+        GuiContext uiContext ( mCamera2D, mSpriteBatch );
+        currPlayer.mCharView.mHUD.DrawFrame(uiContext);
+        mSpriteBatch.DetachSprites(currSnapshot.mSprites);
+    }
+}
+
+void GuiManager::RenderFrame()
+{
     Rect prevScreenRect = gGraphicsDevice.mViewportRect;
     Rect prevScissorsBox = gGraphicsDevice.mScissorBox;
 
@@ -44,31 +63,30 @@ void GuiManager::RenderFrame()
         gGraphicsDevice.BindTexture(eTextureUnit_3, gSpriteManager.mPalettesTable);
         gGraphicsDevice.BindTexture(eTextureUnit_2, gSpriteManager.mPaletteIndicesTable);
 
-        gRenderManager.mSpritesProgram.Activate();
+        gRenderManager.mGuiSpritesProgram.Activate();
 
         RenderStates guiRenderStates = RenderStates()
             .Disable(RenderStateFlags_FaceCulling)
             .Disable(RenderStateFlags_DepthTest);
         gGraphicsDevice.SetRenderStates(guiRenderStates);
 
-        for (int icurr = 0; icurr < gCarnageGame.mNumPlayers; ++icurr)
+        for (HUDSnapshot& currSnapshot: mHUDSnapshots)
         {   
-            CarnageGame::HumanCharacterSlot& currPlayer = gCarnageGame.mHumanSlot[icurr];
             mCamera2D.SetIdentity();
-            mCamera2D.mViewportRect = currPlayer.mCharView.mCamera.mViewportRect;
+            mCamera2D.mViewportRect = currSnapshot.mViewportRect;
             mCamera2D.SetProjection(0.0f, mCamera2D.mViewportRect.w * 1.0f, mCamera2D.mViewportRect.h * 1.0f, 0.0f);
 
             gGraphicsDevice.SetViewportRect(mCamera2D.mViewportRect);
             gGraphicsDevice.SetScissorRect(mCamera2D.mViewportRect);
 
-            gRenderManager.mSpritesProgram.UploadCameraTransformMatrices(mCamera2D);
+            gRenderManager.mGuiSpritesProgram.UploadCameraTransformMatrices(mCamera2D);
 
-            GuiContext uiContext ( mCamera2D, mSpriteBatch );
-            currPlayer.mCharView.mHUD.DrawFrame(uiContext);
+            mSpriteBatch.BeginBatch(eSpritesSortMode_None);
+            mSpriteBatch.DrawSprites(currSnapshot.mSprites);
             mSpriteBatch.Flush();
         }
 
-        gRenderManager.mSpritesProgram.Deactivate();
+        gRenderManager.mGuiSpritesProgram.Deactivate();
     }
 
     { // draw imgui
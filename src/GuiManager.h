@@ -11,6 +11,10 @@ public:
     bool Initialize();
     void Deinit();
 
+    // capture heads-up-display of each player, must be called while game simulation is paused
+    void PrepareFrame();
+
+    // draw captured heads-up-display and debug ui, game state is not accessed
     void RenderFrame();
     void UpdateFrame();
 
@@ -23,6 +27,14 @@ public:
     void InputEvent(GamepadInputEvent& inputEvent) override;
 
 private:
+    // heads-up-display sprites of single player
+    struct HUDSnapshot
+    {
+        Rect mViewportRect;
+        std::vector<Sprite2D> mSprites;
+    };
+    std::vector<HUDSnapshot> mHUDSnapshots;
+
     SpriteBatch mSpriteBatch;
     GameCamera2D mCamera2D;
 };
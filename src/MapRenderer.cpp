@@ -2,6 +2,7 @@
 #include "MapRenderer.h"
 #include "RenderingManager.h"
 #include "GpuBuffer.h"
+#include "GpuProgram.h"
 #include "CarnageGame.h"
 #include "SpriteManager.h"
 #include "GpuTexture2D.h"
@@ -12,12 +13,15 @@
 #include "Vehicle.h"
 #include "RenderView.h"
 #include "TrafficManager.h"
+#include "TaskManager.h"
 
 //////////////////////////////////////////////////////////////////////////
 
 void MapRenderStats::FrameBegin()
 {
     mBlockChunksDrawnCount = 0;
+    mCityMeshDrawCallsCount = 0;
+    mCityMeshTrianglesDrawnCount = 0;
     mSpritesDrawnCount = 0;
 
     ++mRenderFramesCounter;
@@ -40,17 +44,34 @@ bool MapRenderer::Initialize()
     if (mCityMeshBufferV == nullptr || mCityMeshBufferI == nullptr)
         return false;
 
+    if (gGraphicsDevice.mCaps.mFeatures[eGraphicsFeature_MultiDrawIndirect])
+    {
+        mCityMeshCommandsBuffer = gGraphicsDevice.CreateBuffer(eBufferContent_DrawIndirect);
+        debug_assert(mCityMeshCommandsBuffer);
+    }
+
     if (!mSpriteBatch.Initialize())
     {
         gConsole.LogMessage(eLogMessage_Warning, "Cannot initialize sprites batch");
         return false;
     }
 
+    mObjectsGrid.Setup(Convert::MapUnitsToMeters(ObjectsGridCellDims * 1.0f));
+
+    gGameMap.AttachBlocksChangeListener(this);
     return true;
 }
-
+
 void MapRenderer::Deinit()
 {
+    gGameMap.DetachBlocksChangeListener(this);
+
+    mCityMeshVerticesAllocator.Cleanup();
+    mCityMeshIndicesAllocator.Cleanup();
+
+    mObjectsGrid.Cleanup();
+    mViewsPrepareData.clear();
+
     mSpriteBatch.Deinit();
     if (mCityMeshBufferV)
     {
@@ -63,56 +84,132 @@ void MapRenderer::Deinit()
         gGraphicsDevice.DestroyBuffer(mCityMeshBufferI);
         mCityMeshBufferI = nullptr;
     }
+
+    if (mCityMeshCommandsBuffer)
+    {
+        gGraphicsDevice.DestroyBuffer(mCityMeshCommandsBuffer);
+        mCityMeshCommandsBuffer = nullptr;
+    }
 }
 
 void MapRenderer::RenderFrameBegin()
 {
     mRenderStats.FrameBegin();
+
+    // chunks are being rebuilt on worker thread while level is loading
+    if (mHasDirtyChunks && !gCarnageGame.IsLoading())
+    {
+        UpdateDirtyChunks();
+    }
+
+    UpdateObjectsGrid();
 }
 
 void MapRenderer::RenderFrameEnd()
 {
     mRenderStats.FrameEnd();
 }
-
-void MapRenderer::RenderFrame(RenderView* renderview)
-{
-    debug_assert(renderview);
-
-    gGraphicsDevice.BindTexture(eTextureUnit_3, gSpriteManager.mPalettesTable);
-    gGraphicsDevice.BindTexture(eTextureUnit_2, gSpriteManager.mPaletteIndicesTable);
-
+
+void MapRenderer::PrepareFrame(const std::vector<RenderView*>& renderviews, std::vector<RenderViewSnapshot>& snapshots)
+{
+    const int viewsCount = (int) renderviews.size();
+    snapshots.resize(viewsCount);
+    if (mViewsPrepareData.size() < renderviews.size())
+    {
+        mViewsPrepareData.resize(viewsCount);
+    }
+
+    // views share only read access to map and game objects, each one has its own working data
+    gTaskManager.ParallelFor(viewsCount, [this, &renderviews, &snapshots](int iview)
+        {
+            PrepareView(renderviews[iview], snapshots[iview], mViewsPrepareData[iview]);
+        });
+
+    // objects can be visible in several views, so they are marked after all views are done
+    for (int iview = 0; iview < viewsCount; ++iview)
+    {
+        const ViewPrepareData& prepareData = mViewsPrepareData[iview];
+        const int spritesCount = (int) prepareData.mSpritesObjects.size();
+        for (int isprite = 0; isprite < spritesCount; ++isprite)
+        {
+            if (!cxx::frustum_mask_visible(prepareData.mSpritesVisibleMasks.data(), isprite))
+                continue;
+
+            prepareData.mSpritesObjects[isprite]->mLastRenderFrame = mRenderStats.mRenderFramesCounter;
+        }
+        mRenderStats.mSpritesDrawnCount += (int) snapshots[iview].mSprites.mSprites.size();
+        mRenderStats.mBlockChunksDrawnCount += prepareData.mBlockChunksCount;
+        mRenderStats.mCityMeshTrianglesDrawnCount += prepareData.mCityMeshTrianglesCount;
+    }
+}
+
+void MapRenderer::PrepareView(RenderView* renderview, RenderViewSnapshot& snapshot, ViewPrepareData& prepareData) const
+{
+    debug_assert(renderview);
+
+    snapshot.mCamera = renderview->mCamera;
+    snapshot.mSprites.Clear();
+
+    CollectCityMeshDrawCommands(snapshot, prepareData);
+
+    // collect sprites of game objects in grid cells which can be seen by camera,
+    // attached objects are not in grid and get collected along with the object to which they are attached
+    prepareData.mSpritesObjects.clear();
+    prepareData.mSpritesBounds.clear();
+
+    glm::vec2 visibleAreaMin;
+    glm::vec2 visibleAreaMax;
+    const float maxHeight = Convert::MapUnitsToMeters(MAP_LAYERS_COUNT * 1.0f);
+    if (snapshot.mCamera.GetVisibleArea(0.0f, maxHeight, visibleAreaMin, visibleAreaMax))
+    {
+        mObjectsGrid.QueryObjects(visibleAreaMin, visibleAreaMax, prepareData.mGridObjects);
+        for (GameObject* currObject: prepareData.mGridObjects)
+        {
+            CollectGameObject(currObject, prepareData);
+        }
+    }
+
+    // keep sprites which are visible on screen
+    const int spritesCount = (int) prepareData.mSpritesObjects.size();
+    prepareData.mSpritesVisibleMasks.resize((spritesCount + 3) / 4);
+    cxx::frustum_contains_many(snapshot.mCamera.mFrustum, prepareData.mSpritesBounds.data(), spritesCount, 
+        prepareData.mSpritesVisibleMasks.data());
+    for (int isprite = 0; isprite < spritesCount; ++isprite)
+    {
+        if (!cxx::frustum_mask_visible(prepareData.mSpritesVisibleMasks.data(), isprite))
+            continue;
+
+        snapshot.mSprites.mSprites.push_back(prepareData.mSpritesObjects[isprite]->mDrawSprite);
+    }
+
+    // sort and generate instances here so that only upload is left for render thread
+    snapshot.mSprites.Build(eSpritesSortMode_HeightAndDrawOrder);
+}
+
+void MapRenderer::RenderFrame(RenderViewSnapshot& snapshot)
+{
+    gGraphicsDevice.BindTexture(eTextureUnit_3, gSpriteManager.mPalettesTable);
+    gGraphicsDevice.BindTexture(eTextureUnit_2, gSpriteManager.mPaletteIndicesTable);
+
     if (gGameCheatsWindow.mEnableDrawCityMesh)
-    {
-        DrawCityMesh(renderview);
-    }
-
-    mSpriteBatch.BeginBatch(SpriteBatch::DepthAxis_Y, eSpritesSortMode_HeightAndDrawOrder);
-
-    // collect and render game objects sprites
-    for (GameObject* currObject: gGameObjectsManager.mAllObjectsList)
-    {
-        // attached objects must be drawn after the object to which they are attached
-        if (currObject->IsAttachedToObject())
-            continue;
-
-        DrawGameObject(renderview, currObject);
-    }
-
-    gRenderManager.mSpritesProgram.Activate();
-    gRenderManager.mSpritesProgram.UploadCameraTransformMatrices(renderview->mCamera);
-
-    RenderStates guiRenderStates = RenderStates()
-        .Disable(RenderStateFlags_FaceCulling)
-        .Disable(RenderStateFlags_DepthWrite);
-    gGraphicsDevice.SetRenderStates(guiRenderStates);
-
-    mSpriteBatch.Flush();
-
-    gRenderManager.mSpritesProgram.Deactivate();
+    {
+        DrawCityMesh(snapshot);
+    }
+
+    gRenderManager.mSpritesProgram.Activate();
+    gRenderManager.mSpritesProgram.UploadCameraTransformMatrices(snapshot.mCamera);
+
+    RenderStates guiRenderStates = RenderStates()
+        .Disable(RenderStateFlags_FaceCulling)
+        .Disable(RenderStateFlags_DepthWrite);
+    gGraphicsDevice.SetRenderStates(guiRenderStates);
+
+    mSpriteBatch.Flush(snapshot.mSprites);
+
+    gRenderManager.mSpritesProgram.Deactivate();
 }
 
-void MapRenderer::DrawGameObject(RenderView* renderview, GameObject* gameObject)
+void MapRenderer::CollectGameObject(GameObject* gameObject, ViewPrepareData& prepareData) const
 {
     if (gameObject->IsMarkedForDeletion() || gameObject->IsInvisibleFlag())
         return;
@@ -125,39 +222,82 @@ void MapRenderer::DrawGameObject(RenderView* renderview, GameObject* gameObject)
 
     if (!dbgSkipDraw)
     {
-        gameObject->PreDrawFrame();
+        // sprite bounds, it lies flat at its height
+        glm::vec2 spriteCorners[4];
+        gameObject->mDrawSprite.GetCorners(spriteCorners);
 
-        // detect if gameobject is visible on screen
-        const glm::vec2 spritePosition = (gameObject->mDrawSprite.mPosition + gameObject->mDrawSprite.GetOriginPoint());
-        float maxdistance = Convert::MapUnitsToMeters(10.0f); // todo: magic numbers
-        if (fabs(renderview->mCamera.mPosition.x - spritePosition.x) > maxdistance ||
-            fabs(renderview->mCamera.mPosition.z - spritePosition.y) > maxdistance)
-        {
-            // skip
-        }
-        else
-        {
-            mSpriteBatch.DrawSprite(gameObject->mDrawSprite);
+        const float spriteHeight = gameObject->mDrawSprite.mHeight;
+        glm::vec2 minCorner = glm::min(glm::min(spriteCorners[0], spriteCorners[1]), glm::min(spriteCorners[2], spriteCorners[3]));
+        glm::vec2 maxCorner = glm::max(glm::max(spriteCorners[0], spriteCorners[1]), glm::max(spriteCorners[2], spriteCorners[3]));
 
-            ++mRenderStats.mSpritesDrawnCount;
-            gameObject->mLastRenderFrame = mRenderStats.mRenderFramesCounter;
-        }
+        prepareData.mSpritesObjects.push_back(gameObject);
+        prepareData.mSpritesBounds.emplace_back(glm::vec3 { minCorner.x, spriteHeight, minCorner.y }, glm::vec3 { maxCorner.x, spriteHeight, maxCorner.y });
     }
 
     if (!gameObject->HasAttachedObjects())
         return;
 
-    // draw attached objects
+    // collect attached objects
     for (int ichild = 0; ; ++ichild)
     {
         GameObject* currentChild = gameObject->GetAttachedObject(ichild);
         if (currentChild == nullptr)
             break;
 
-        DrawGameObject(renderview, currentChild);
+        CollectGameObject(currentChild, prepareData);
     }
 }
 
+void MapRenderer::UpdateObjectsGrid()
+{
+    // sprites are refreshed once per frame and shared by all render views
+    for (GameObject* currObject: gGameObjectsManager.mAllObjectsList)
+    {
+        if (currObject->IsMarkedForDeletion() || currObject->IsInvisibleFlag())
+            continue;
+
+        currObject->PreDrawFrame();
+    }
+
+    for (GameObject* currObject: gGameObjectsManager.mAllObjectsList)
+    {
+        if (currObject->IsAttachedToObject())
+        {
+            mObjectsGrid.RemoveObject(currObject);
+            continue;
+        }
+
+        glm::vec2 boundsMin { std::numeric_limits<float>::max() };
+        glm::vec2 boundsMax { -std::numeric_limits<float>::max() };
+        ExtendObjectBounds(currObject, boundsMin, boundsMax);
+
+        const glm::vec2 halfSize = (boundsMax - boundsMin) * 0.5f;
+        mObjectsGrid.UpdateObject(currObject, boundsMin + halfSize, std::max(halfSize.x, halfSize.y));
+    }
+}
+
+void MapRenderer::ExtendObjectBounds(GameObject* gameObject, glm::vec2& boundsMin, glm::vec2& boundsMax) const
+{
+    glm::vec2 spriteCorners[4];
+    gameObject->mDrawSprite.GetCorners(spriteCorners);
+    for (const glm::vec2& currCorner: spriteCorners)
+    {
+        boundsMin = glm::min(boundsMin, currCorner);
+        boundsMax = glm::max(boundsMax, currCorner);
+    }
+
+    for (GameObject* currChild: gameObject->mAttachedObjects)
+    {
+        ExtendObjectBounds(currChild, boundsMin, boundsMax);
+    }
+}
+
+void MapRenderer::RemoveGameObject(GameObject* gameObject)
+{
+    debug_assert(gameObject);
+    mObjectsGrid.RemoveObject(gameObject);
+}
+
 void MapRenderer::RenderDebug(RenderView* renderview, DebugRenderer& debugRender)
 {
     debug_assert(renderview);
@@ -173,86 +313,540 @@ void MapRenderer::RenderDebug(RenderView* renderview, DebugRenderer& debugRender
     gTrafficManager.DebugDraw(debugRender);
 }
 
-void MapRenderer::DrawCityMesh(RenderView* renderview)
+void MapRenderer::CollectCityMeshDrawCommands(RenderViewSnapshot& snapshot, ViewPrepareData& prepareData) const
 {
-    RenderStates cityMeshRenderStates;
-
-    gGraphicsDevice.SetRenderStates(cityMeshRenderStates);
-
-    gRenderManager.mCityMeshProgram.Activate();
-    gRenderManager.mCityMeshProgram.UploadCameraTransformMatrices(renderview->mCamera);
-
-    if (mCityMeshBufferV && mCityMeshBufferI)
-    {
-        gGraphicsDevice.BindVertexBuffer(mCityMeshBufferV, CityVertex3D_Format::Get());
-        gGraphicsDevice.BindIndexBuffer(mCityMeshBufferI);
-        gGraphicsDevice.BindTexture(eTextureUnit_0, gSpriteManager.mBlocksTextureArray);
-        gGraphicsDevice.BindTexture(eTextureUnit_1, gSpriteManager.mBlocksIndicesTable);
-
-        for (const MapBlocksChunk& currChunk: mMapBlocksChunks)
-        {
-            if (!renderview->mCamera.mFrustum.contains(currChunk.mBounds))
-                continue;
-
-            gGraphicsDevice.RenderIndexedPrimitives(ePrimitiveType_Triangles, eIndicesType_i32, 
-                currChunk.mIndicesStart * Sizeof_DrawIndex, currChunk.mIndicesCount);
-
-            ++mRenderStats.mBlockChunksDrawnCount;
-        }
-    }
-    gRenderManager.mCityMeshProgram.Deactivate();
+    const cxx::frustum_t& cameraFrustum = snapshot.mCamera.mFrustum;
+    std::vector<int>& visibleChunks = prepareData.mVisibleChunks;
+    visibleChunks.clear();
+    if (mChunksTreeRoot != -1)
+    {
+        CollectVisibleChunks(cameraFrustum, mChunksTreeRoot, visibleChunks);
+    }
+    // keep chunks in buffer order so that their ranges can be merged
+    std::sort(visibleChunks.begin(), visibleChunks.end());
+
+    // collect visible faces groups of visible chunks
+    const glm::vec3& cameraPosition = snapshot.mCamera.mPosition;
+    std::vector<DrawIndexedCommand>& drawCommands = snapshot.mCityMeshDrawCommands;
+    drawCommands.clear();
+    prepareData.mBlockChunksCount = 0;
+    prepareData.mCityMeshTrianglesCount = 0;
+    for (int currChunkIndex: visibleChunks)
+    {
+        const MapBlocksChunk& currChunk = mMapBlocksChunks[currChunkIndex];
+
+        unsigned int groupsVisibleMasks[(CityMeshFacesGroupsCount + 3) / 4];
+        cxx::frustum_contains_many(cameraFrustum, currChunk.mFacesGroupsBounds, CityMeshFacesGroupsCount, groupsVisibleMasks);
+
+        for (int igroup = 0; igroup < CityMeshFacesGroupsCount; ++igroup)
+        {
+            const MapBlocksFacesGroup& currGroup = currChunk.mFacesGroups[igroup];
+            if (currGroup.mIndicesCount == 0 || !cxx::frustum_mask_visible(groupsVisibleMasks, igroup))
+                continue;
+
+            if (!IsFacesGroupFrontFacing(igroup, currChunk.mFacesGroupsBounds[igroup], cameraPosition))
+                continue;
+
+            // adjacent ranges are drawn with single command
+            const unsigned int firstIndex = currChunk.mIndicesStart + currGroup.mIndicesOffset;
+            if (!drawCommands.empty() && 
+                (drawCommands.back().mFirstIndex + drawCommands.back().mIndicesCount) == firstIndex)
+            {
+                drawCommands.back().mIndicesCount += currGroup.mIndicesCount;
+            }
+            else
+            {
+                DrawIndexedCommand drawCommand;
+                drawCommand.mIndicesCount = currGroup.mIndicesCount;
+                drawCommand.mInstanceCount = 1;
+                drawCommand.mFirstIndex = firstIndex;
+                drawCommand.mBaseVertex = 0;
+                drawCommand.mBaseInstance = 0;
+                drawCommands.push_back(drawCommand);
+            }
+            prepareData.mCityMeshTrianglesCount += currGroup.mIndicesCount / 3;
+        }
+
+        ++prepareData.mBlockChunksCount;
+    }
 }
 
-void MapRenderer::BuildMapMesh()
+void MapRenderer::DrawCityMesh(const RenderViewSnapshot& snapshot)
 {
-    CityMeshData blocksMesh;
-    for (int batchy = 0; batchy < BlocksBatchesPerSide; ++batchy)
+    RenderStates cityMeshRenderStates;
+
+    gGraphicsDevice.SetRenderStates(cityMeshRenderStates);
+
+    gRenderManager.mCityMeshProgram.Activate();
+    gRenderManager.mCityMeshProgram.UploadCameraTransformMatrices(snapshot.mCamera);
+
+    // animated blocks frames are picked in shader if indices table contains them
+    GpuProgram* cityMeshProgram = gRenderManager.mCityMeshProgram.mGpuProgram;
+    if (cityMeshProgram->IsUniformExists(eRenderUniform_AnimationCycle))
+    {
+        cityMeshProgram->SetUniform(eRenderUniform_AnimationCycle, gSpriteManager.GetBlocksAnimationCycle());
+    }
+
+    if (mCityMeshBufferV && mCityMeshBufferI)
     {
-        for (int batchx = 0; batchx < BlocksBatchesPerSide; ++batchx)
+        if (mCityMeshPacked)
+        {
+            gGraphicsDevice.BindVertexBuffer(mCityMeshBufferV, CityVertex3D_Packed_Format::Get());
+        }
+        else
         {
-            Rect mapArea { 
-                batchx * BlocksBatchDims - ExtraBlocksPerSide, 
-                batchy * BlocksBatchDims - ExtraBlocksPerSide,
-                BlocksBatchDims,
-                BlocksBatchDims };
+            gGraphicsDevice.BindVertexBuffer(mCityMeshBufferV, CityVertex3D_Format::Get());
+        }
+        gGraphicsDevice.BindIndexBuffer(mCityMeshBufferI);
+        gGraphicsDevice.BindTexture(eTextureUnit_0, gSpriteManager.mBlocksTextureArray);
+        gGraphicsDevice.BindTexture(eTextureUnit_1, gSpriteManager.mBlocksIndicesTable);
 
-            unsigned int prevVerticesCount = blocksMesh.mBlocksVertices.size();
-            unsigned int prevIndicesCount = blocksMesh.mBlocksIndices.size();
+        const std::vector<DrawIndexedCommand>& drawCommands = snapshot.mCityMeshDrawCommands;
+        const int numDrawCommands = (int) drawCommands.size();
+        if (numDrawCommands == 0)
+        {
+            // nothing to draw
+        }
+        else if (!gGameCheatsWindow.mEnableCityMeshMultiDraw)
+        {
+            for (const DrawIndexedCommand& currCommand: drawCommands)
+            {
+                gGraphicsDevice.RenderIndexedPrimitives(ePrimitiveType_Triangles, eIndicesType_i32, 
+                    currCommand.mFirstIndex * Sizeof_DrawIndex, currCommand.mIndicesCount);
+            }
+            mRenderStats.mCityMeshDrawCallsCount += numDrawCommands;
+        }
+        else if (mCityMeshCommandsBuffer)
+        {
+            // buffer storage gets orphaned so previous view commands are not overwritten while still in use
+            mCityMeshCommandsBuffer->Setup(eBufferUsage_Stream, numDrawCommands * Sizeof_DrawIndexedCommand, 
+                drawCommands.data());
+            gGraphicsDevice.RenderIndexedPrimitivesIndirect(ePrimitiveType_Triangles, eIndicesType_i32, 
+                mCityMeshCommandsBuffer, 0, numDrawCommands);
+            ++mRenderStats.mCityMeshDrawCallsCount;
+        }
+        else
+        {
+            gGraphicsDevice.RenderIndexedPrimitives(ePrimitiveType_Triangles, eIndicesType_i32, 
+                drawCommands.data(), numDrawCommands);
+            ++mRenderStats.mCityMeshDrawCallsCount;
+        }
+    }
+    gRenderManager.mCityMeshProgram.Deactivate();
+}
+
+void MapRenderer::BuildMapMesh()
+{
+    PrepareMapMesh();
+    UploadMapMesh();
+}
+
+void MapRenderer::PrepareMapMesh()
+{
+    auto startTime = std::chrono::high_resolution_clock::now();
 
-            MapBlocksChunk& currChunk = mMapBlocksChunks[batchy * BlocksBatchesPerSide + batchx];
+    // chunks are independent so their geometry is generated simultaneously into separate buffers
+    std::vector<CityMeshData> chunksMeshes(BlocksBatchCount);
+    std::vector<int> chunksSourceTriangles(BlocksBatchCount);
+    gTaskManager.ParallelFor(BlocksBatchCount, [this, &chunksMeshes, &chunksSourceTriangles](int ichunk)
+        {
+            const Rect mapArea = GetChunkMapArea(ichunk);
+
+            MapBlocksChunk& currChunk = mMapBlocksChunks[ichunk];
             currChunk.mBounds.mMin = glm::vec3 { mapArea.x * METERS_PER_MAP_UNIT, 0.0f, mapArea.y * METERS_PER_MAP_UNIT };
             currChunk.mBounds.mMax = glm::vec3 { 
                 (mapArea.x + mapArea.w) * METERS_PER_MAP_UNIT, MAP_LAYERS_COUNT * METERS_PER_MAP_UNIT, 
                 (mapArea.y + mapArea.h) * METERS_PER_MAP_UNIT};
 
-            currChunk.mVerticesStart = prevVerticesCount;
-            currChunk.mIndicesStart = prevIndicesCount;
-            
-            // append new geometry
-            GameMapHelpers::BuildMapMesh(gGameMap, mapArea, blocksMesh);
-            
-            currChunk.mVerticesCount = blocksMesh.mBlocksVertices.size() - prevVerticesCount;
-            currChunk.mIndicesCount = blocksMesh.mBlocksIndices.size() - prevIndicesCount;
-        }
+            GameMapHelpers::BuildMapMesh(gGameMap, mapArea, chunksMeshes[ichunk], &chunksSourceTriangles[ichunk]);
+            currChunk.SetupFacesGroups(chunksMeshes[ichunk]);
+        });
+
+    BuildChunksTree();
+
+    // chunks geometry offsets within shared buffers
+    unsigned int totalVerticesCount = 0;
+    unsigned int totalIndicesCount = 0;
+    for (int ichunk = 0; ichunk < BlocksBatchCount; ++ichunk)
+    {
+        MapBlocksChunk& currChunk = mMapBlocksChunks[ichunk];
+        currChunk.mVerticesStart = totalVerticesCount;
+        currChunk.mVerticesCount = chunksMeshes[ichunk].mBlocksVertices.size();
+        currChunk.mIndicesStart = totalIndicesCount;
+        currChunk.mIndicesCount = chunksMeshes[ichunk].mBlocksIndices.size();
+
+        totalVerticesCount += currChunk.mVerticesCount;
+        totalIndicesCount += currChunk.mIndicesCount;
+    }
+
+    // concatenate, chunk indices are relative to its own vertices so they get rebased
+    mCityMeshPacked = gSystem.mConfig.mPackedCityVertices;
+
+    CityMeshData& blocksMesh = mCityMeshData;
+    blocksMesh.Clear();
+    blocksMesh.mBlocksVertices.resize(mCityMeshPacked ? 0 : totalVerticesCount);
+    blocksMesh.mBlocksIndices.resize(totalIndicesCount);
+    mCityMeshPackedVertices.resize(mCityMeshPacked ? totalVerticesCount : 0);
+    gTaskManager.ParallelFor(BlocksBatchCount, [this, &chunksMeshes, &blocksMesh](int ichunk)
+        {
+            const MapBlocksChunk& currChunk = mMapBlocksChunks[ichunk];
+            const CityMeshData& chunkMesh = chunksMeshes[ichunk];
+
+            if (mCityMeshPacked)
+            {
+                for (unsigned int ivertex = 0; ivertex < currChunk.mVerticesCount; ++ivertex)
+                {
+                    mCityMeshPackedVertices[currChunk.mVerticesStart + ivertex].Set(chunkMesh.mBlocksVertices[ivertex]);
+                }
+            }
+            else
+            {
+                std::copy(chunkMesh.mBlocksVertices.begin(), chunkMesh.mBlocksVertices.end(), 
+                    blocksMesh.mBlocksVertices.begin() + currChunk.mVerticesStart);
+            }
+
+            std::transform(chunkMesh.mBlocksIndices.begin(), chunkMesh.mBlocksIndices.end(), 
+                blocksMesh.mBlocksIndices.begin() + currChunk.mIndicesStart, [&currChunk](DrawIndex index)
+                {
+                    return (DrawIndex) (index + currChunk.mVerticesStart);
+                });
+        });
+
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - startTime;
+    mRenderStats.mCityMeshBuildTime = (float) elapsed.count();
+    mRenderStats.mCityMeshTrianglesCount = totalIndicesCount / 3;
+    mRenderStats.mCityMeshSourceTrianglesCount = 0;
+    for (int currSourceTriangles: chunksSourceTriangles)
+    {
+        mRenderStats.mCityMeshSourceTrianglesCount += currSourceTriangles;
     }
+    mRenderStats.mCityMeshMemoryUsage = totalVerticesCount * (mCityMeshPacked ? Sizeof_CityVertex3D_Packed : Sizeof_CityVertex3D) + 
+        totalIndicesCount * Sizeof_DrawIndex;
+
+    gConsole.LogMessage(eLogMessage_Debug, "City mesh built in %.2f ms (%u vertices, %u triangles, %u before optimization, %u KB)", 
+        mRenderStats.mCityMeshBuildTime, totalVerticesCount, mRenderStats.mCityMeshTrianglesCount, 
+        mRenderStats.mCityMeshSourceTrianglesCount, mRenderStats.mCityMeshMemoryUsage / 1024);
+}
+
+void MapRenderer::UploadMapMesh()
+{
+    CityMeshData& blocksMesh = mCityMeshData;
+
+    const unsigned int totalVerticesCount = mCityMeshPacked ? mCityMeshPackedVertices.size() : blocksMesh.mBlocksVertices.size();
+    const unsigned int totalIndicesCount = blocksMesh.mBlocksIndices.size();
+    const void* vertexData = mCityMeshPacked ? (const void*) mCityMeshPackedVertices.data() : blocksMesh.mBlocksVertices.data();
+
+    // keep some free space in buffers for rebuilt chunks which geometry grows
+    const unsigned int verticesCapacity = totalVerticesCount + (totalVerticesCount / CityMeshReserveFraction);
+    const unsigned int indicesCapacity = totalIndicesCount + (totalIndicesCount / CityMeshReserveFraction);
+    mCityMeshVerticesAllocator.Setup(verticesCapacity, totalVerticesCount);
+    mCityMeshIndicesAllocator.Setup(indicesCapacity, totalIndicesCount);
 
     // upload map geometry to video memory
-    int totalVertexDataBytes = blocksMesh.mBlocksVertices.size() * Sizeof_CityVertex3D;
-    int totalIndexDataBytes = blocksMesh.mBlocksIndices.size() * Sizeof_DrawIndex;
+    const unsigned int vertexSize = mCityMeshPacked ? Sizeof_CityVertex3D_Packed : Sizeof_CityVertex3D;
+    const unsigned int totalVertexDataBytes = totalVerticesCount * vertexSize;
+    const unsigned int totalIndexDataBytes = totalIndicesCount * Sizeof_DrawIndex;
 
     // upload vertex data
-    mCityMeshBufferV->Setup(eBufferUsage_Static, totalVertexDataBytes, nullptr);
+    mCityMeshBufferV->Setup(eBufferUsage_Static, verticesCapacity * vertexSize, nullptr);
     if (void* pdata = mCityMeshBufferV->Lock(BufferAccess_Write))
     {
-        memcpy(pdata, blocksMesh.mBlocksVertices.data(), totalVertexDataBytes);
+        memcpy(pdata, vertexData, totalVertexDataBytes);
         mCityMeshBufferV->Unlock();
     }
 
     // upload index data
-    mCityMeshBufferI->Setup(eBufferUsage_Static, totalIndexDataBytes, nullptr);
+    mCityMeshBufferI->Setup(eBufferUsage_Static, indicesCapacity * Sizeof_DrawIndex, nullptr);
     if (void* pdata = mCityMeshBufferI->Lock(BufferAccess_Write))
     {
         memcpy(pdata, blocksMesh.mBlocksIndices.data(), totalIndexDataBytes);
         mCityMeshBufferI->Unlock();
     }
+
+    // release cpu side copy
+    mCityMeshData = CityMeshData();
+    mCityMeshPackedVertices = std::vector<CityVertex3D_Packed>();
+
+    // whole mesh is rebuilt so pending modifications are discarded, this is done here on main thread 
+    // because dirty state is read by RenderFrameBegin
+    mHasDirtyChunks = false;
+    for (MapBlocksChunk& currChunk: mMapBlocksChunks)
+    {
+        currChunk.mIsDirty = false;
+    }
+}
+
+void MapRenderer::MapBlocksChanged(const Rect& area)
+{
+    // faces of neighbour blocks may become visible or hidden, so one block around area is also affected
+    const int minBatchx = glm::clamp((area.x - 1 + ExtraBlocksPerSide) / BlocksBatchDims, 0, BlocksBatchesPerSide - 1);
+    const int minBatchy = glm::clamp((area.y - 1 + ExtraBlocksPerSide) / BlocksBatchDims, 0, BlocksBatchesPerSide - 1);
+    const int maxBatchx = glm::clamp((area.x + area.w + ExtraBlocksPerSide) / BlocksBatchDims, 0, BlocksBatchesPerSide - 1);
+    const int maxBatchy = glm::clamp((area.y + area.h + ExtraBlocksPerSide) / BlocksBatchDims, 0, BlocksBatchesPerSide - 1);
+
+    for (int batchy = minBatchy; batchy <= maxBatchy; ++batchy)
+    for (int batchx = minBatchx; batchx <= maxBatchx; ++batchx)
+    {
+        mMapBlocksChunks[batchy * BlocksBatchesPerSide + batchx].mIsDirty = true;
+    }
+    mHasDirtyChunks = true;
+}
+
+void MapRenderer::UpdateDirtyChunks()
+{
+    // city mesh is not uploaded yet, chunks stay dirty until it is
+    if (!mCityMeshBufferV->IsBufferInited() || !mCityMeshBufferI->IsBufferInited())
+        return;
+
+    mHasDirtyChunks = false;
+
+    std::vector<int> dirtyChunks;
+    for (int ichunk = 0; ichunk < BlocksBatchCount; ++ichunk)
+    {
+        if (mMapBlocksChunks[ichunk].mIsDirty)
+        {
+            mMapBlocksChunks[ichunk].mIsDirty = false;
+            dirtyChunks.push_back(ichunk);
+        }
+    }
+
+    auto startTime = std::chrono::high_resolution_clock::now();
+
+    std::vector<CityMeshData> chunksMeshes(dirtyChunks.size());
+    gTaskManager.ParallelFor((int) dirtyChunks.size(), [this, &dirtyChunks, &chunksMeshes](int idirty)
+        {
+            GameMapHelpers::BuildMapMesh(gGameMap, GetChunkMapArea(dirtyChunks[idirty]), chunksMeshes[idirty]);
+            mMapBlocksChunks[dirtyChunks[idirty]].SetupFacesGroups(chunksMeshes[idirty]);
+        });
+
+    auto AllocateRange = [](BufferRangeAllocator& allocator, GpuBuffer* buffer, unsigned int elementSize, 
+        unsigned int length, unsigned int& outOffset)
+        {
+            if (allocator.Allocate(length, outOffset))
+                return true;
+
+            // out of free space, buffer grows and keeps its content
+            const unsigned int newCapacity = allocator.GetCapacity() + 
+                std::max(length, allocator.GetCapacity() / CityMeshReserveFraction);
+            if (!buffer->Resize(newCapacity * elementSize))
+                return false;
+
+            allocator.Grow(newCapacity);
+            return allocator.Allocate(length, outOffset);
+        };
+
+    const unsigned int vertexSize = mCityMeshPacked ? Sizeof_CityVertex3D_Packed : Sizeof_CityVertex3D;
+    std::vector<CityVertex3D_Packed> packedVertices;
+    for (size_t idirty = 0; idirty < dirtyChunks.size(); ++idirty)
+    {
+        MapBlocksChunk& currChunk = mMapBlocksChunks[dirtyChunks[idirty]];
+        CityMeshData& chunkMesh = chunksMeshes[idirty];
+
+        // space of old geometry can be reused by new one
+        mCityMeshVerticesAllocator.Free(currChunk.mVerticesStart, currChunk.mVerticesCount);
+        mCityMeshIndicesAllocator.Free(currChunk.mIndicesStart, currChunk.mIndicesCount);
+        mRenderStats.mCityMeshTrianglesCount -= currChunk.mIndicesCount / 3;
+
+        currChunk.mVerticesCount = chunkMesh.mBlocksVertices.size();
+        currChunk.mIndicesCount = chunkMesh.mBlocksIndices.size();
+        bool isAllocated = AllocateRange(mCityMeshVerticesAllocator, mCityMeshBufferV, vertexSize, 
+            currChunk.mVerticesCount, currChunk.mVerticesStart);
+        if (isAllocated && !AllocateRange(mCityMeshIndicesAllocator, mCityMeshBufferI, Sizeof_DrawIndex, 
+            currChunk.mIndicesCount, currChunk.mIndicesStart))
+        {
+            mCityMeshVerticesAllocator.Free(currChunk.mVerticesStart, currChunk.mVerticesCount);
+            isAllocated = false;
+        }
+
+        if (!isAllocated)
+        {
+            gConsole.LogMessage(eLogMessage_Warning, "Cannot allocate city mesh buffers space for chunk %d", dirtyChunks[idirty]);
+
+            // chunk won't be drawn
+            currChunk.mVerticesStart = currChunk.mVerticesCount = 0;
+            currChunk.mIndicesStart = currChunk.mIndicesCount = 0;
+            continue;
+        }
+
+        if (currChunk.mIndicesCount == 0)
+            continue;
+
+        for (DrawIndex& currIndex: chunkMesh.mBlocksIndices)
+        {
+            currIndex += currChunk.mVerticesStart;
+        }
+
+        const void* vertexData = chunkMesh.mBlocksVertices.data();
+        if (mCityMeshPacked)
+        {
+            packedVertices.resize(currChunk.mVerticesCount);
+            for (unsigned int ivertex = 0; ivertex < currChunk.mVerticesCount; ++ivertex)
+            {
+                packedVertices[ivertex].Set(chunkMesh.mBlocksVertices[ivertex]);
+            }
+            vertexData = packedVertices.data();
+        }
+        mCityMeshBufferV->SubData(currChunk.mVerticesStart * vertexSize, currChunk.mVerticesCount * vertexSize, vertexData);
+        mCityMeshBufferI->SubData(currChunk.mIndicesStart * Sizeof_DrawIndex, currChunk.mIndicesCount * Sizeof_DrawIndex, 
+            chunkMesh.mBlocksIndices.data());
+
+        mRenderStats.mCityMeshTrianglesCount += currChunk.mIndicesCount / 3;
+    }
+    mRenderStats.mCityMeshChunksUpdatedCount += (int) dirtyChunks.size();
+
+    // chunks bounds and emptiness might change
+    BuildChunksTree();
+
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - startTime;
+    gConsole.LogMessage(eLogMessage_Debug, "City mesh chunks rebuilt in %.2f ms (%d chunks)", elapsed.count(), (int) dirtyChunks.size());
+}
+
+Rect MapRenderer::GetChunkMapArea(int chunkIndex) const
+{
+    debug_assert(chunkIndex > -1 && chunkIndex < BlocksBatchCount);
+
+    const int batchx = chunkIndex % BlocksBatchesPerSide;
+    const int batchy = chunkIndex / BlocksBatchesPerSide;
+
+    Rect mapArea { 
+        batchx * BlocksBatchDims - ExtraBlocksPerSide, 
+        batchy * BlocksBatchDims - ExtraBlocksPerSide,
+        BlocksBatchDims,
+        BlocksBatchDims };
+    return mapArea;
+}
+
+bool MapRenderer::IsFacesGroupFrontFacing(int groupIndex, const cxx::aabbox_t& groupBounds, const glm::vec3& position) const
+{
+    const eBlockFace groupFace = (eBlockFace) (groupIndex % eBlockFace_COUNT);
+    switch (groupFace)
+    {
+        case eBlockFace_W: return position.x < groupBounds.mMax.x;
+        case eBlockFace_E: return position.x > groupBounds.mMin.x;
+        case eBlockFace_N: return position.z < groupBounds.mMax.z;
+        case eBlockFace_S: return position.z > groupBounds.mMin.z;
+        case eBlockFace_Lid: return position.y > groupBounds.mMin.y;
+        default: break;
+    }
+    debug_assert(false);
+    return true;
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+void MapRenderer::MapBlocksChunk::SetupFacesGroups(const CityMeshData& chunkMesh)
+{
+    debug_assert(chunkMesh.mBlocksIndices.empty() || chunkMesh.mFacesGroupsIndicesCount.size() == CityMeshFacesGroupsCount);
+
+    glm::vec3 chunkMinPosition { std::numeric_limits<float>::max() };
+    glm::vec3 chunkMaxPosition { -std::numeric_limits<float>::max() };
+
+    unsigned int indicesOffset = 0;
+    for (int igroup = 0; igroup < CityMeshFacesGroupsCount; ++igroup)
+    {
+        MapBlocksFacesGroup& currGroup = mFacesGroups[igroup];
+        currGroup.mIndicesOffset = indicesOffset;
+        currGroup.mIndicesCount = chunkMesh.mFacesGroupsIndicesCount.empty() ? 0 : chunkMesh.mFacesGroupsIndicesCount[igroup];
+        mFacesGroupsBounds[igroup].clear();
+        if (currGroup.mIndicesCount == 0)
+            continue;
+
+        const glm::vec3& firstPosition = chunkMesh.mBlocksVertices[chunkMesh.mBlocksIndices[indicesOffset]].mPosition;
+        glm::vec3 minPosition = firstPosition;
+        glm::vec3 maxPosition = firstPosition;
+        for (unsigned int iindex = indicesOffset; iindex < indicesOffset + currGroup.mIndicesCount; ++iindex)
+        {
+            const glm::vec3& currPosition = chunkMesh.mBlocksVertices[chunkMesh.mBlocksIndices[iindex]].mPosition;
+            minPosition = glm::min(minPosition, currPosition);
+            maxPosition = glm::max(maxPosition, currPosition);
+        }
+        mFacesGroupsBounds[igroup] = cxx::aabbox_t(minPosition, maxPosition);
+        indicesOffset += currGroup.mIndicesCount;
+
+        chunkMinPosition = glm::min(chunkMinPosition, minPosition);
+        chunkMaxPosition = glm::max(chunkMaxPosition, maxPosition);
+    }
+
+    if (indicesOffset > 0)
+    {
+        mBounds = cxx::aabbox_t(chunkMinPosition, chunkMaxPosition);
+    }
+}
+
+void MapRenderer::BuildChunksTree()
+{
+    mChunksTree.clear();
+
+    cxx::aabbox_t rootBounds;
+    mChunksTreeRoot = BuildChunksTreeNode(0, 0, ChunksTreeDims, rootBounds);
+}
+
+int MapRenderer::BuildChunksTreeNode(int nodex, int nodey, int nodeSize, cxx::aabbox_t& outBounds)
+{
+    ChunksTreeNode treeNode;
+    treeNode.mIsLeaf = (nodeSize == 2);
+
+    glm::vec3 nodeMinPosition { std::numeric_limits<float>::max() };
+    glm::vec3 nodeMaxPosition { -std::numeric_limits<float>::max() };
+
+    bool hasChildren = false;
+    for (int ichild = 0; ichild < 4; ++ichild)
+    {
+        const int childSize = nodeSize / 2;
+        const int childx = nodex + (ichild % 2) * childSize;
+        const int childy = nodey + (ichild / 2) * childSize;
+
+        treeNode.mChildren[ichild] = -1;
+        if (childx >= BlocksBatchesPerSide || childy >= BlocksBatchesPerSide)
+            continue;
+
+        cxx::aabbox_t& childBounds = treeNode.mChildrenBounds[ichild];
+        if (treeNode.mIsLeaf)
+        {
+            const int chunkIndex = childy * BlocksBatchesPerSide + childx;
+            const MapBlocksChunk& currChunk = mMapBlocksChunks[chunkIndex];
+            if (currChunk.mIndicesCount == 0)
+                continue;
+
+            treeNode.mChildren[ichild] = chunkIndex;
+            childBounds = currChunk.mBounds;
+        }
+        else
+        {
+            treeNode.mChildren[ichild] = BuildChunksTreeNode(childx, childy, childSize, childBounds);
+            if (treeNode.mChildren[ichild] == -1)
+                continue;
+        }
+
+        nodeMinPosition = glm::min(nodeMinPosition, childBounds.mMin);
+        nodeMaxPosition = glm::max(nodeMaxPosition, childBounds.mMax);
+        hasChildren = true;
+    }
+
+    if (!hasChildren)
+        return -1;
+
+    outBounds = cxx::aabbox_t(nodeMinPosition, nodeMaxPosition);
+    mChunksTree.push_back(treeNode);
+    return (int) mChunksTree.size() - 1;
+}
+
+void MapRenderer::CollectVisibleChunks(const cxx::frustum_t& frustum, int nodeIndex, std::vector<int>& visibleChunks) const
+{
+    const ChunksTreeNode& treeNode = mChunksTree[nodeIndex];
+    const unsigned int visibleMask = cxx::frustum_contains_4(frustum, treeNode.mChildrenBounds);
+    for (int ichild = 0; ichild < 4; ++ichild)
+    {
+        if (treeNode.mChildren[ichild] == -1 || (visibleMask & BIT(ichild)) == 0)
+            continue;
+
+        if (treeNode.mIsLeaf)
+        {
+            visibleChunks.push_back(treeNode.mChildren[ichild]);
+        }
+        else
+        {
+            CollectVisibleChunks(frustum, treeNode.mChildren[ichild], visibleChunks);
+        }
+    }
 }
\ No newline at end of file
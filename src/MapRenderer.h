@@ -2,6 +2,10 @@
 
 #include "SpriteBatch.h"
 #include "GameDefs.h"
+#include "GameMapManager.h"
+#include "BufferRangeAllocator.h"
+#include "GameObjectsGrid.h"
+#include "GameCamera.h"
 
 class DebugRenderer;
 class RenderView;
@@ -16,29 +20,134 @@ public:
 
 public:
     int mBlockChunksDrawnCount = 0;  // per frame
+    int mCityMeshDrawCallsCount = 0; // per frame
+    unsigned int mCityMeshTrianglesDrawnCount = 0; // per frame
     int mSpritesDrawnCount = 0; // per frame
 
+    float mCityMeshBuildTime = 0.0f; // milliseconds spent to generate city mesh geometry
+    unsigned int mCityMeshTrianglesCount = 0;
+    unsigned int mCityMeshSourceTrianglesCount = 0; // before hidden faces removal and merging
+    unsigned int mCityMeshMemoryUsage = 0; // vertex and index data bytes
+    int mCityMeshChunksUpdatedCount = 0; // total chunks rebuilt after map blocks modifications
+
     unsigned int mRenderFramesCounter = 0; // gets incremented on every frame
 };
 
+// state of render view captured while game simulation is paused,
+// it is drawn while next game frame is being simulated so game objects must not be accessed
+struct RenderViewSnapshot
+{
+public:
+    GameCamera mCamera;
+    std::vector<DrawIndexedCommand> mCityMeshDrawCommands; // visible city mesh faces ranges
+    SpriteDrawList mSprites; // visible game objects sprites, sorted and batched
+};
+
 // renders map mesh, peds, cars and map objects
-class MapRenderer final: public cxx::noncopyable
+class MapRenderer final: public MapBlocksChangeListener
+    , public cxx::noncopyable
 {
+    friend class DebugSelfTests;
+
 public:
     MapRenderStats mRenderStats;
 
 public:
     bool Initialize();
     void Deinit();
+    // refresh game objects sprites and city mesh chunks, must be called while game simulation is paused
     void RenderFrameBegin();
-    void RenderFrame(RenderView* renderview);
+
+    // Capture cameras, visible city mesh chunks and game objects sprites of render views, must be called while game simulation is paused
+    // Views are prepared concurrently on worker threads, gpu is not accessed
+    // @param renderviews: Render views, their camera matrices must be computed
+    // @param snapshots: Output snapshots, one per render view
+    void PrepareFrame(const std::vector<RenderView*>& renderviews, std::vector<RenderViewSnapshot>& snapshots);
+
+    // Draw city mesh and sprites of captured render view, game state is not accessed
+    // @param snapshot: Render view snapshot
+    void RenderFrame(RenderViewSnapshot& snapshot);
+
+    // push debug info of game objects seen in current frame to debug draw queue, must be called while game simulation is paused
     void RenderDebug(RenderView* renderview, DebugRenderer& debugRender);
     void RenderFrameEnd();
     void BuildMapMesh();
 
+    // generate city mesh geometry on cpu side, gpu is not accessed so it can be done on worker thread
+    // renderer must not draw city while geometry is being prepared
+    void PrepareMapMesh();
+
+    // upload prepared city mesh geometry to gpu and release cpu side copy, pending chunks modifications are discarded
+    void UploadMapMesh();
+
+    // override MapBlocksChangeListener
+    void MapBlocksChanged(const Rect& area) override;
+
+    // Forget game object before it gets destroyed
+    // @param gameObject: Object
+    void RemoveGameObject(GameObject* gameObject);
+
 private:
-    void DrawCityMesh(RenderView* renderview);
-    void DrawGameObject(RenderView* renderview, GameObject* gameObject);
+    // per view culling working data, kept between frames to avoid allocations
+    struct ViewPrepareData
+    {
+        std::vector<int> mVisibleChunks;
+        std::vector<GameObject*> mGridObjects; // objects in visible grid cells
+        // game objects sprites visibility test list
+        std::vector<GameObject*> mSpritesObjects;
+        std::vector<cxx::aabbox_t> mSpritesBounds;
+        std::vector<unsigned int> mSpritesVisibleMasks;
+        // statistics, merged after all views are prepared
+        int mBlockChunksCount = 0;
+        unsigned int mCityMeshTrianglesCount = 0;
+    };
+
+    // capture state of single render view, may be called on worker thread
+    // @param renderview: Render view
+    // @param snapshot: Output snapshot
+    // @param prepareData: Working data of view
+    void PrepareView(RenderView* renderview, RenderViewSnapshot& snapshot, ViewPrepareData& prepareData) const;
+
+    // find visible faces groups of city mesh and merge them into draw commands
+    // @param snapshot: Render view snapshot, camera must be set
+    // @param prepareData: Working data of view
+    void CollectCityMeshDrawCommands(RenderViewSnapshot& snapshot, ViewPrepareData& prepareData) const;
+
+    void DrawCityMesh(const RenderViewSnapshot& snapshot);
+
+    // regenerate geometry of modified chunks and upload it in place of old one
+    void UpdateDirtyChunks();
+
+    // get map area covered by chunk including extra blocks around map
+    // @param chunkIndex: Chunk index
+    Rect GetChunkMapArea(int chunkIndex) const;
+
+    // test whether faces of group can be seen from position, faces pointing away are never visible
+    // @param groupIndex: Faces group index, see CityMeshFacesGroupsCount
+    // @param groupBounds: Faces group bounds
+    // @param position: Camera position
+    bool IsFacesGroupFrontFacing(int groupIndex, const cxx::aabbox_t& groupBounds, const glm::vec3& position) const;
+
+    // add sprites of game object and its attached objects to visibility test list
+    void CollectGameObject(GameObject* gameObject, ViewPrepareData& prepareData) const;
+
+    // refresh sprites of all game objects and move them to grid cells at their current locations
+    void UpdateObjectsGrid();
+
+    // extend bounds by sprites of game object and its attached objects
+    // @param gameObject: Object
+    // @param boundsMin, boundsMax: Bounds on horizontal plane, x and z world coordinates
+    void ExtendObjectBounds(GameObject* gameObject, glm::vec2& boundsMin, glm::vec2& boundsMax) const;
+
+    // rebuild chunks quadtree after chunks bounds changed
+    void BuildChunksTree();
+    int BuildChunksTreeNode(int nodex, int nodey, int nodeSize, cxx::aabbox_t& outBounds);
+
+    // find chunks in view frustum, whole subtrees are rejected at once
+    // @param frustum: View frustum
+    // @param nodeIndex: Quadtree node
+    // @param visibleChunks: Output chunk indices
+    void CollectVisibleChunks(const cxx::frustum_t& frustum, int nodeIndex, std::vector<int>& visibleChunks) const;
 
 private:
     enum
@@ -47,6 +156,15 @@ private:
         ExtraBlocksPerSide = 4,
         BlocksBatchesPerSide = ((MAP_DIMENSIONS + (ExtraBlocksPerSide * 2)) + BlocksBatchDims - 1) / BlocksBatchDims,
         BlocksBatchCount = BlocksBatchesPerSide * BlocksBatchesPerSide,
+        CityMeshReserveFraction = 16, // extra buffers space for edited chunks, 1/N of initial size
+        ChunksTreeDims = 16, // chunks per side of quadtree root, power of two
+        ObjectsGridCellDims = 8, // blocks per side of game objects grid cell
+    };
+    static_assert(BlocksBatchesPerSide <= ChunksTreeDims, "Chunks quadtree is too small");
+    // faces of chunk on single layer which point in same direction
+    struct MapBlocksFacesGroup
+    {
+        unsigned int mIndicesOffset = 0, mIndicesCount = 0; // relative to chunk indices start
     };
     struct MapBlocksChunk
     {
@@ -54,11 +172,43 @@ private:
         // index/vertex data offset in vbo
         unsigned int mIndicesStart = 0, mIndicesCount = 0;
         unsigned int mVerticesStart = 0, mVerticesCount = 0;
+        bool mIsDirty = false; // geometry is outdated and needs to be rebuilt
+        MapBlocksFacesGroup mFacesGroups[CityMeshFacesGroupsCount];
+        cxx::aabbox_t mFacesGroupsBounds[CityMeshFacesGroupsCount]; // kept apart for batched culling
+
+        // setup faces groups ranges and bounds from generated chunk geometry, chunk bounds get shrunk to fit faces
+        // @param chunkMesh: Chunk geometry, indices are relative to chunk vertices
+        void SetupFacesGroups(const CityMeshData& chunkMesh);
     };
     MapBlocksChunk mMapBlocksChunks[BlocksBatchCount];
+    bool mHasDirtyChunks = false;
+
+    // quadtree over chunks, children bounds of node are tested against frustum at once
+    struct ChunksTreeNode
+    {
+        cxx::aabbox_t mChildrenBounds[4];
+        int mChildren[4]; // child node index or chunk index on leaf level, -1 if there is no child
+        bool mIsLeaf = false;
+    };
+    std::vector<ChunksTreeNode> mChunksTree;
+    int mChunksTreeRoot = -1;
+
+    // game objects by location, only objects which are not attached to others are kept
+    GameObjectsGrid mObjectsGrid;
+
+    std::vector<ViewPrepareData> mViewsPrepareData;
 
     GpuBuffer* mCityMeshBufferV;
     GpuBuffer* mCityMeshBufferI;
+    GpuBuffer* mCityMeshCommandsBuffer = nullptr; // visible chunks draw commands, if multi draw indirect is supported
+
+    // chunks geometry sub-allocation within city mesh buffers, in vertices and indices
+    BufferRangeAllocator mCityMeshVerticesAllocator;
+    BufferRangeAllocator mCityMeshIndicesAllocator;
+
+    CityMeshData mCityMeshData; // prepared geometry waiting for upload
+    std::vector<CityVertex3D_Packed> mCityMeshPackedVertices; // prepared vertices in compact format
+    bool mCityMeshPacked = false; // city mesh vertex format, see SystemConfig
 
     SpriteBatch mSpriteBatch;
 };
\ No newline at end of file
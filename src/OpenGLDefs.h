@@ -40,6 +40,7 @@ inline GLenum EnumToGL(eBufferContent bufferContent)
     {
         case eBufferContent_Vertices: return GL_ARRAY_BUFFER;
         case eBufferContent_Indices: return GL_ELEMENT_ARRAY_BUFFER;
+        case eBufferContent_DrawIndirect: return GL_DRAW_INDIRECT_BUFFER;
     }
     debug_assert(false);
     return GL_ARRAY_BUFFER;
@@ -141,9 +142,12 @@ inline GLenum GetAttributeDataTypeGL(eVertexAttributeFormat attributeFormat)
     {
         case eVertexAttributeFormat_2F: return GL_FLOAT;
         case eVertexAttributeFormat_3F: return GL_FLOAT;
+        case eVertexAttributeFormat_4F: return GL_FLOAT;
         case eVertexAttributeFormat_4UB: return GL_UNSIGNED_BYTE;
         case eVertexAttributeFormat_1US: return GL_UNSIGNED_SHORT;
         case eVertexAttributeFormat_2US: return GL_UNSIGNED_SHORT;
+        case eVertexAttributeFormat_4B: return GL_BYTE;
+        case eVertexAttributeFormat_4S: return GL_SHORT;
     }
     debug_assert(false);
     return GL_UNSIGNED_BYTE;
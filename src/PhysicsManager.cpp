@@ -202,7 +202,7 @@ void PhysicsManager::CreateMapCollisionShape()
     for (int y = 0; y < MAP_DIMENSIONS; ++y)
     for (int layer = 0; layer < MAP_LAYERS_COUNT; ++layer)
     {
-        MapBlockInfo* blockData = gGameMap.GetBlock(x, y, layer);
+        const MapBlockInfo* blockData = gGameMap.GetBlock(x, y, layer);
         debug_assert(blockData);
 
         if (blockData->mGroundType != eGroundType_Building)
@@ -210,10 +210,10 @@ void PhysicsManager::CreateMapCollisionShape()
 
         // checek blox is inner
         {
-            MapBlockInfo* neighbourE = gGameMap.GetBlockClamp(x + 1, y, layer); 
-            MapBlockInfo* neighbourW = gGameMap.GetBlockClamp(x - 1, y, layer); 
-            MapBlockInfo* neighbourN = gGameMap.GetBlockClamp(x, y - 1, layer); 
-            MapBlockInfo* neighbourS = gGameMap.GetBlockClamp(x, y + 1, layer);
+            const MapBlockInfo* neighbourE = gGameMap.GetBlockClamp(x + 1, y, layer); 
+            const MapBlockInfo* neighbourW = gGameMap.GetBlockClamp(x - 1, y, layer); 
+            const MapBlockInfo* neighbourN = gGameMap.GetBlockClamp(x, y - 1, layer); 
+            const MapBlockInfo* neighbourS = gGameMap.GetBlockClamp(x, y + 1, layer);
 
             auto is_walkable = [](eGroundType gtype)
             {
@@ -426,11 +426,26 @@ void PhysicsManager::ProcessGravityStep()
     if (!gGameCheatsWindow.mEnableGravity)
         return;
 
-    // process vihicles
-    for (size_t i = 0, NumElements = mCarsBodiesList.size(); i < NumElements; ++i)
+    // process vihicles, steer and drive wheel per each car
+    const size_t NumCars = mCarsBodiesList.size();
+    mWheelsPositions.resize(NumCars * 2);
+    mWheelsHeights.resize(NumCars * 2);
+    for (size_t i = 0; i < NumCars; ++i)
     {
         CarPhysicsBody* currentBody = static_cast<CarPhysicsBody*>(mCarsBodiesList[i]);
-        ProcessGravityStep(currentBody);
+
+        glm::vec2 posSteerWheel = currentBody->GetWheelPosition(eCarWheel_Steer);
+        glm::vec2 posDriveWheel = currentBody->GetWheelPosition(eCarWheel_Drive);
+        mWheelsPositions[i * 2 + 0] = glm::vec3(posSteerWheel.x, currentBody->mHeight, posSteerWheel.y);
+        mWheelsPositions[i * 2 + 1] = glm::vec3(posDriveWheel.x, currentBody->mHeight, posDriveWheel.y);
+    }
+    gGameMap.GetHeightAtPositions(mWheelsPositions.data(), (int) mWheelsPositions.size(), mWheelsHeights.data(), false);
+    for (size_t i = 0; i < NumCars; ++i)
+    {
+        CarPhysicsBody* currentBody = static_cast<CarPhysicsBody*>(mCarsBodiesList[i]);
+
+        float groundHeight = std::max(mWheelsHeights[i * 2 + 0], mWheelsHeights[i * 2 + 1]);
+        ProcessGravityStep(currentBody, groundHeight);
     }
     // process pedestrians
     for (size_t i = 0, NumElements = mPedsBodiesList.size(); i < NumElements; ++i)
@@ -440,16 +455,8 @@ void PhysicsManager::ProcessGravityStep()
     }
 }
 
-void PhysicsManager::ProcessGravityStep(CarPhysicsBody* physicsBody)
+void PhysicsManager::ProcessGravityStep(CarPhysicsBody* physicsBody, float groundHeight)
 {
-    glm::vec2 posSteerWheel = physicsBody->GetWheelPosition(eCarWheel_Steer);
-    glm::vec2 posDriveWheel = physicsBody->GetWheelPosition(eCarWheel_Drive);
-
-    float heightSteerWheel = gGameMap.GetHeightAtPosition(glm::vec3(posSteerWheel.x, physicsBody->mHeight, posSteerWheel.y), false);
-    float heightDriveWheel = gGameMap.GetHeightAtPosition(glm::vec3(posDriveWheel.x, physicsBody->mHeight, posDriveWheel.y), false);
-
-    float groundHeight = std::max(heightSteerWheel, heightDriveWheel);
-
     if (physicsBody->mFalling)
     {
         // whether falling ends
@@ -540,8 +547,7 @@ bool PhysicsManager::HasCollisionPedVsMap(int mapx, int mapy, float height) cons
 
     // todo: temporary implementation
 
-    MapBlockInfo* blockData = gGameMap.GetBlockClamp(mapx, mapy, mapLayer);
-    return (blockData->mGroundType == eGroundType_Building);
+    return (gGameMap.GetGroundTypeClamp(mapx, mapy, mapLayer) == eGroundType_Building);
 }
 
 bool PhysicsManager::HasCollisionCarVsMap(b2Contact* contact, b2Fixture* fixtureCar, int mapx, int mapy) const
@@ -553,8 +559,7 @@ bool PhysicsManager::HasCollisionCarVsMap(b2Contact* contact, b2Fixture* fixture
 
     // todo: temporary implementation
 
-    MapBlockInfo* blockData = gGameMap.GetBlockClamp(mapx, mapy, mapLayer);
-    return (blockData->mGroundType == eGroundType_Building);
+    return (gGameMap.GetGroundTypeClamp(mapx, mapy, mapLayer) == eGroundType_Building);
 }
 
 bool PhysicsManager::HasCollisionPedVsCar(b2Contact* contact, PedPhysicsBody* ped, CarPhysicsBody* car) const
@@ -749,8 +754,7 @@ bool PhysicsManager::ProcessProjectileVsMap(b2Contact* contact, ProjectilePhysic
     // check same height
     int layer = (int) (Convert::MetersToMapUnits(projectile->mHeight) + 0.5f);
 
-    MapBlockInfo* mapBlock = gGameMap.GetBlockClamp(mapx, mapy, layer);
-    if (mapBlock->mGroundType != eGroundType_Building)
+    if (gGameMap.GetGroundTypeClamp(mapx, mapy, layer) != eGroundType_Building)
         return false;
 
     // get collision point
@@ -55,7 +55,7 @@ private:
 
     // apply gravity forces and correct y coord for objects
     void ProcessGravityStep();
-    void ProcessGravityStep(CarPhysicsBody* body);
+    void ProcessGravityStep(CarPhysicsBody* body, float groundHeight);
     void ProcessGravityStep(PedPhysicsBody* body);
 
     void ProcessSimulationStep();
@@ -103,6 +103,10 @@ private:
     std::vector<PhysicsBody*> mPedsBodiesList;
     std::vector<PhysicsBody*> mCarsBodiesList;
     std::vector<PhysicsBody*> mProjectileBodiesList;
+
+    // cars wheels ground heights are resolved at once
+    std::vector<glm::vec3> mWheelsPositions;
+    std::vector<float> mWheelsHeights;
 };
 
 extern PhysicsManager gPhysics;
\ No newline at end of file
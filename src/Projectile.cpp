@@ -148,9 +148,18 @@ void Projectile::ComputeDrawHeight(const glm::vec3& position)
 
     glm::vec2 corners[4];
     mDrawSprite.GetCorners(corners);
-    for (glm::vec2& currCorner: corners)
+
+    // query all corners at once
+    glm::vec3 cornerPositions[4];
+    for (int icorner = 0; icorner < 4; ++icorner)
+    {
+        cornerPositions[icorner] = glm::vec3(corners[icorner].x, position.y, corners[icorner].y);
+    }
+
+    float cornerHeights[4];
+    gGameMap.GetHeightAtPositions(cornerPositions, 4, cornerHeights);
+    for (float height: cornerHeights)
     {
-        float height = gGameMap.GetHeightAtPosition(glm::vec3(currCorner.x, position.y, currCorner.y));
         if (height > maxHeight)
         {
             maxHeight = height;
@@ -40,6 +40,11 @@ bool RenderProgram::Reinitialize()
         return false;
     }
 
+    if (!mSourceDefines.empty())
+    {
+        shaderSourceCode.insert(0, mSourceDefines);
+    }
+
     bool isCompiled = mGpuProgram->CompileSourceCode(shaderSourceCode.c_str());
     if (isCompiled)
     {
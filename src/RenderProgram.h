@@ -8,6 +8,9 @@ class RenderProgram: public cxx::noncopyable
 public:
     const char* const mSourceFileName; // immutable
 
+    // preprocessor definitions which are prepended to shader source, takes effect on next reinitialization
+    std::string mSourceDefines;
+
     // public for convenience, should not be modified directly
     GpuProgram* mGpuProgram = nullptr;
 
@@ -11,8 +11,6 @@ RenderView::~RenderView()
 void RenderView::DrawFrameBegin()
 {
     mCamera.ComputeMatricesAndFrustum();
-   
-    gGraphicsDevice.SetViewportRect(mCamera.mViewportRect);
 }
 
 void RenderView::DrawFrameEnd()
@@ -14,6 +14,7 @@ public:
     RenderView() = default;
     virtual ~RenderView();
 
+    // render view state is captured in between, game simulation is paused at that moment
     virtual void DrawFrameBegin();
     virtual void DrawFrameEnd();
 };
\ No newline at end of file
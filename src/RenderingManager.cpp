@@ -13,6 +13,7 @@ RenderingManager::RenderingManager()
     , mGuiTexColorProgram("shaders/gui.glsl")
     , mCityMeshProgram("shaders/city_mesh.glsl")
     , mSpritesProgram("shaders/sprites.glsl")
+    , mGuiSpritesProgram("shaders/sprites.glsl")
     , mDebugProgram("shaders/debug.glsl")
 {
 }
@@ -47,23 +48,48 @@ void RenderingManager::Deinit()
     FreeRenderPrograms();
 }
 
-void RenderingManager::RenderFrame()
+void RenderingManager::PrepareFrame()
 {
-    gGraphicsDevice.ClearScreen();
     gSpriteManager.RenderFrameBegin();
     mMapRenderer.RenderFrameBegin();
 
-    Rect viewportRectangle = gGraphicsDevice.mViewportRect;
     for (RenderView* currRenderview: mActiveRenderViews)
     {
         currRenderview->DrawFrameBegin();
-        mMapRenderer.RenderFrame(currRenderview);
+    }
+
+    // views are culled and their sprites are batched concurrently
+    mMapRenderer.PrepareFrame(mActiveRenderViews, mViewSnapshots);
+
+    // collect debug info for first human view only
+    if (!mActiveRenderViews.empty() && gGameCheatsWindow.mEnableDebugDraw)
+    {
+        mMapRenderer.RenderDebug(mActiveRenderViews[0], mDebugRenderer);
+    }
+
+    for (RenderView* currRenderview: mActiveRenderViews)
+    {
+        currRenderview->DrawFrameEnd();
+    }
+
+    gGuiManager.PrepareFrame();
+}
+
+void RenderingManager::RenderFrame()
+{
+    gGraphicsDevice.ClearScreen();
+
+    Rect viewportRectangle = gGraphicsDevice.mViewportRect;
+    for (size_t iview = 0; iview < mViewSnapshots.size(); ++iview)
+    {
+        RenderViewSnapshot& currSnapshot = mViewSnapshots[iview];
+        gGraphicsDevice.SetViewportRect(currSnapshot.mCamera.mViewportRect);
+        mMapRenderer.RenderFrame(currSnapshot);
 
         // draw debug info for first human view only
-        if (currRenderview == mActiveRenderViews[0] && gGameCheatsWindow.mEnableDebugDraw)
+        if (iview == 0 && gGameCheatsWindow.mEnableDebugDraw)
         {
-            mDebugRenderer.RenderFrameBegin(currRenderview);
-            mMapRenderer.RenderDebug(currRenderview, mDebugRenderer);
+            mDebugRenderer.RenderFrameBegin(currSnapshot.mCamera);
             mDebugRenderer.RenderFrameEnd();
         }
     }
@@ -71,13 +97,8 @@ void RenderingManager::RenderFrame()
 
     gGuiManager.RenderFrame();
 
-    for (RenderView* currRenderview: mActiveRenderViews)
-    {
-        currRenderview->DrawFrameEnd();
-    }
     mMapRenderer.RenderFrameEnd();
     gSpriteManager.RenderFrameEnd();
-    gGraphicsDevice.Present();
 }
 
 void RenderingManager::FreeRenderPrograms()
@@ -86,6 +107,7 @@ void RenderingManager::FreeRenderPrograms()
     mCityMeshProgram.Deinit();
     mGuiTexColorProgram.Deinit();
     mSpritesProgram.Deinit();
+    mGuiSpritesProgram.Deinit();
     mDebugProgram.Deinit();
 }
 
@@ -93,8 +115,19 @@ bool RenderingManager::InitRenderPrograms()
 {
     mDefaultTexColorProgram.Initialize();
     mGuiTexColorProgram.Initialize();
+
+    // city mesh vertex format is chosen once at startup
+    if (gSystem.mConfig.mPackedCityVertices)
+    {
+        mCityMeshProgram.mSourceDefines = cxx::va("#define CITY_VERTEX_PACKED\n#define CITY_VERTEX_POSITION_SCALE %f\n", 
+            METERS_PER_MAP_UNIT / CityVertex3D_Packed::PositionFixedPoint);
+    }
     mCityMeshProgram.Initialize(); 
     mSpritesProgram.Initialize();
+
+    // gui sprites are drawn on screen plane
+    mGuiSpritesProgram.mSourceDefines = "#define SPRITES_DEPTH_AXIS_Z\n";
+    mGuiSpritesProgram.Initialize();
     mDebugProgram.Initialize();
 
     return true;
@@ -108,6 +141,7 @@ void RenderingManager::ReloadRenderPrograms()
     mGuiTexColorProgram.Reinitialize();
     mDebugProgram.Reinitialize();
     mSpritesProgram.Reinitialize();
+    mGuiSpritesProgram.Reinitialize();
     mCityMeshProgram.Reinitialize();
 }
 
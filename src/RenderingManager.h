@@ -15,6 +15,7 @@ public:
     RenderProgram mCityMeshProgram;
     RenderProgram mGuiTexColorProgram;
     RenderProgram mSpritesProgram;
+    RenderProgram mGuiSpritesProgram;
     RenderProgram mDebugProgram;
 
     MapRenderer mMapRenderer;
@@ -33,7 +34,12 @@ public:
     // All loaded graphics resources must be destroyed here
     void Deinit();
 
-    // Render game frame routine
+    // Capture game state required to draw frame: cameras, sprites, debug lines and hud
+    // Must be called while game simulation is paused
+    void PrepareFrame();
+
+    // Draw captured frame, game state is not accessed so it may run while next game frame is simulated
+    // Frame is not presented, that is done by system once simulation is paused again
     void RenderFrame();
 
     // Force reload all render programs
@@ -48,6 +54,7 @@ private:
 
 private:
     DebugRenderer mDebugRenderer;
+    std::vector<RenderViewSnapshot> mViewSnapshots; // captured active render views
 };
 
 extern RenderingManager gRenderManager;
\ No newline at end of file
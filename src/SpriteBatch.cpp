@@ -4,12 +4,19 @@
 #include "SpriteManager.h"
 #include "RenderView.h"
 
-const unsigned int NumVerticesPerSprite = 4;
 const unsigned int NumIndicesPerSprite = 6;
+const unsigned int NumStreamingSprites = 4096; // initial capacity of single streaming segment
 
 bool SpriteBatch::Initialize()
 {
-    mSpritesList.reserve(1024);
+    mDrawList.mSprites.reserve(1024);
+
+    // regular buffer will be used for instances if streaming is not supported
+    mTrimeshBuffer.SetupStreaming(NumStreamingSprites * Sizeof_SpriteInstance3D, 0);
+
+    // all sprites share same quad, vertex index defines quad corner in shader
+    const DrawIndex quadIndices[NumIndicesPerSprite] = { 0, 1, 2, 1, 2, 3 };
+    mTrimeshBuffer.SetIndices(sizeof(quadIndices), quadIndices);
     return true;
 }
 
@@ -21,191 +28,220 @@ void SpriteBatch::Deinit()
 
 void SpriteBatch::Clear()
 {
-    mSpritesList.clear();
-    mDrawVertices.clear();
-    mDrawIndices.clear();
-    mBatchesList.clear();
+    mDrawList.Clear();
 }
 
 void SpriteBatch::DrawSprite(const Sprite2D& sourceSprite)
 {
-    mSpritesList.push_back(sourceSprite);
+    mDrawList.mSprites.push_back(sourceSprite);
+}
+
+void SpriteBatch::DrawSprites(const std::vector<Sprite2D>& sprites)
+{
+    mDrawList.mSprites.insert(mDrawList.mSprites.end(), sprites.begin(), sprites.end());
+}
+
+void SpriteBatch::DetachSprites(std::vector<Sprite2D>& outSprites)
+{
+    // lists are swapped so both keep their memory
+    outSprites.swap(mDrawList.mSprites);
+    mDrawList.mSprites.clear();
 }
 
 void SpriteBatch::Flush()
 {
-    if (!mSpritesList.empty())
-    {
-        SortSprites();
-        GenerateSpritesBatches();
-        RenderSpritesBatches();
+    if (!mDrawList.mSprites.empty())
+    {
+        mDrawList.SortSprites(mSortMode);
+
+        unsigned int totalInstanceCount = mDrawList.mSprites.size();
+
+        // write instances directly to gpu memory if possible
+        TrimeshStreamingData streamingData;
+        if (mTrimeshBuffer.IsStreaming() && mTrimeshBuffer.AllocateStreamingData(Sizeof_SpriteInstance3D, 
+            Sizeof_SpriteInstance3D * totalInstanceCount, 0, streamingData))
+        {
+            mDrawList.GenerateBatches(static_cast<SpriteInstance3D*>(streamingData.mVertices));
+            RenderSpritesBatches(mDrawList, streamingData.mBaseVertex);
+        }
+        else
+        {
+            mDrawList.mInstances.resize(totalInstanceCount);
+            mDrawList.GenerateBatches(mDrawList.mInstances.data());
+
+            mTrimeshBuffer.SetVertices(Sizeof_SpriteInstance3D * totalInstanceCount, mDrawList.mInstances.data());
+            RenderSpritesBatches(mDrawList, 0);
+        }
     }
     Clear();
 }
 
-void SpriteBatch::GenerateSpritesBatches()
+void SpriteBatch::Flush(const SpriteDrawList& drawList)
+{
+    if (drawList.mSprites.empty())
+        return;
+
+    unsigned int totalInstanceCount = drawList.mInstances.size();
+    debug_assert(totalInstanceCount == drawList.mSprites.size());
+
+    // instances are already generated, so they only get copied
+    TrimeshStreamingData streamingData;
+    if (mTrimeshBuffer.IsStreaming() && mTrimeshBuffer.AllocateStreamingData(Sizeof_SpriteInstance3D, 
+        Sizeof_SpriteInstance3D * totalInstanceCount, 0, streamingData))
+    {
+        memcpy(streamingData.mVertices, drawList.mInstances.data(), Sizeof_SpriteInstance3D * totalInstanceCount);
+        RenderSpritesBatches(drawList, streamingData.mBaseVertex);
+    }
+    else
+    {
+        mTrimeshBuffer.SetVertices(Sizeof_SpriteInstance3D * totalInstanceCount, drawList.mInstances.data());
+        RenderSpritesBatches(drawList, 0);
+    }
+}
+
+void SpriteDrawList::Clear()
 {
-    int numSprites = mSpritesList.size();
+    mSprites.clear();
+    mInstances.clear();
+    mBatches.clear();
+}
 
-    int totalVertexCount = numSprites * NumVerticesPerSprite; 
-    debug_assert(totalVertexCount > 0);
+void SpriteDrawList::Build(eSpritesSortMode sortMode)
+{
+    mInstances.clear();
+    mBatches.clear();
+    if (mSprites.empty())
+        return;
 
-    int totalIndexCount = numSprites * NumIndicesPerSprite; 
-    debug_assert(totalIndexCount > 0);
+    SortSprites(sortMode);
 
-    // allocate memory for mesh data
-    mDrawVertices.resize(totalVertexCount);
-    SpriteVertex3D* vertexData = mDrawVertices.data();
+    mInstances.resize(mSprites.size());
+    GenerateBatches(mInstances.data());
+}
 
-    mDrawIndices.resize(totalIndexCount);
-    DrawIndex* indexData = mDrawIndices.data();
+void SpriteDrawList::GenerateBatches(SpriteInstance3D* instanceData)
+{
+    int numSprites = mSprites.size();
+    debug_assert(numSprites > 0);
+    debug_assert(instanceData);
 
     // initial batch
-    mBatchesList.clear();
-    mBatchesList.emplace_back();
-    DrawSpriteBatch* currentBatch = &mBatchesList.back();
-    currentBatch->mFirstVertex = 0;
-    currentBatch->mFirstIndex = 0;
-    currentBatch->mVertexCount = 0;
-    currentBatch->mIndexCount = 0;
-    currentBatch->mSpriteTexture = mSpritesList[0].mTexture;
+    mBatches.clear();
+    mBatches.emplace_back();
+    DrawBatch* currentBatch = &mBatches.back();
+    currentBatch->mFirstInstance = 0;
+    currentBatch->mInstanceCount = 0;
+    currentBatch->mSpriteTexture = mSprites[0].mTexture;
 
     for (int isprite = 0; isprite < numSprites; ++isprite)
     {
-        const Sprite2D& sprite = mSpritesList[isprite];
+        const Sprite2D& sprite = mSprites[isprite];
         // start new batch
         if (sprite.mTexture != currentBatch->mSpriteTexture)
         {
-            DrawSpriteBatch newBatch;
-            newBatch.mFirstVertex = currentBatch->mVertexCount + currentBatch->mFirstVertex;
-            newBatch.mFirstIndex = currentBatch->mIndexCount + currentBatch->mFirstIndex;
-            newBatch.mVertexCount = 0;
-            newBatch.mIndexCount = 0;
+            DrawBatch newBatch;
+            newBatch.mFirstInstance = currentBatch->mInstanceCount + currentBatch->mFirstInstance;
+            newBatch.mInstanceCount = 0;
             newBatch.mSpriteTexture = sprite.mTexture;
-            mBatchesList.push_back(newBatch);
-            currentBatch = &mBatchesList.back();
+            mBatches.push_back(newBatch);
+            currentBatch = &mBatches.back();
         }
 
-        currentBatch->mVertexCount += NumVerticesPerSprite;   
-        currentBatch->mIndexCount += NumIndicesPerSprite;
-
-        int vertexOffset = isprite * NumVerticesPerSprite;
-
-        vertexData[vertexOffset + 0].mTexcoord.x = sprite.mTextureRegion.mU0;
-        vertexData[vertexOffset + 0].mTexcoord.y = sprite.mTextureRegion.mV0;
-        vertexData[vertexOffset + 0].mClutIndex = sprite.mPaletteIndex;
-
-        vertexData[vertexOffset + 1].mTexcoord.x = sprite.mTextureRegion.mU1;
-        vertexData[vertexOffset + 1].mTexcoord.y = sprite.mTextureRegion.mV0;
-        vertexData[vertexOffset + 1].mClutIndex = sprite.mPaletteIndex;
-
-        vertexData[vertexOffset + 2].mTexcoord.x = sprite.mTextureRegion.mU0;
-        vertexData[vertexOffset + 2].mTexcoord.y = sprite.mTextureRegion.mV1;
-        vertexData[vertexOffset + 2].mClutIndex = sprite.mPaletteIndex;
-
-        vertexData[vertexOffset + 3].mTexcoord.x = sprite.mTextureRegion.mU1;
-        vertexData[vertexOffset + 3].mTexcoord.y = sprite.mTextureRegion.mV1;
-        vertexData[vertexOffset + 3].mClutIndex = sprite.mPaletteIndex;
-
-        glm::vec2 positions[4];
-        sprite.GetCorners(positions);
-
-        if (mDepthAxis == DepthAxis_Y)
-        {
-            for (int i = 0; i < 4; ++i)
-            {
-                vertexData[vertexOffset + i].mPosition.x = positions[i].x;
-                vertexData[vertexOffset + i].mPosition.z = positions[i].y;
-            }
-            vertexData[vertexOffset + 0].mPosition.y = sprite.mHeight;
-            vertexData[vertexOffset + 1].mPosition.y = sprite.mHeight;
-            vertexData[vertexOffset + 2].mPosition.y = sprite.mHeight;
-            vertexData[vertexOffset + 3].mPosition.y = sprite.mHeight;
-        }
-        else
-        {
-            for (int i = 0; i < 4; ++i)
-            {
-                vertexData[vertexOffset + i].mPosition.x = positions[i].x;
-                vertexData[vertexOffset + i].mPosition.y = positions[i].y;
-            }
-            vertexData[vertexOffset + 0].mPosition.z = sprite.mHeight;
-            vertexData[vertexOffset + 1].mPosition.z = sprite.mHeight;
-            vertexData[vertexOffset + 2].mPosition.z = sprite.mHeight;
-            vertexData[vertexOffset + 3].mPosition.z = sprite.mHeight;
-        }
-
-        // setup indices
-        int indexOffset = isprite * NumIndicesPerSprite;
-        indexData[indexOffset + 0] = vertexOffset + 0;
-        indexData[indexOffset + 1] = vertexOffset + 1;
-        indexData[indexOffset + 2] = vertexOffset + 2;
-        indexData[indexOffset + 3] = vertexOffset + 1;
-        indexData[indexOffset + 4] = vertexOffset + 2;
-        indexData[indexOffset + 5] = vertexOffset + 3;
+        ++currentBatch->mInstanceCount;
+
+        // destination may be write combined gpu memory, so instance is composed locally and then written at once
+        SpriteInstance3D spriteInstance;
+        spriteInstance.mPosition = sprite.mPosition;
+        spriteInstance.mHeight = sprite.mHeight;
+        spriteInstance.mRotation = sprite.mRotateAngle.non_zero() ? sprite.mRotateAngle.to_radians() : 0.0f;
+        spriteInstance.mTextureRegion.x = sprite.mTextureRegion.mU0;
+        spriteInstance.mTextureRegion.y = sprite.mTextureRegion.mV0;
+        spriteInstance.mTextureRegion.z = sprite.mTextureRegion.mU1;
+        spriteInstance.mTextureRegion.w = sprite.mTextureRegion.mV1;
+        spriteInstance.mSize.x = sprite.mTextureRegion.mRectangle.w * sprite.mScale;
+        spriteInstance.mSize.y = sprite.mTextureRegion.mRectangle.h * sprite.mScale;
+        spriteInstance.mClutIndex = sprite.mPaletteIndex;
+        spriteInstance.mOriginMode = sprite.mOriginMode;
+        memcpy(instanceData + isprite, &spriteInstance, Sizeof_SpriteInstance3D);
     }
 }
 
-void SpriteBatch::RenderSpritesBatches()
+void SpriteBatch::RenderSpritesBatches(const SpriteDrawList& drawList, unsigned int baseInstance)
 {
-    SpriteVertex3D_Format vFormat;
-    mTrimeshBuffer.SetVertices(Sizeof_SpriteVertex3D * mDrawVertices.size(), mDrawVertices.data());
-    mTrimeshBuffer.SetIndices(Sizeof_DrawIndex * mDrawIndices.size(), mDrawIndices.data());
-    mTrimeshBuffer.Bind(vFormat);
-
-    for (const DrawSpriteBatch& currBatch: mBatchesList)
+    SpriteInstance3D_Format instanceFormat;
+    for (const SpriteDrawList::DrawBatch& currBatch: drawList.mBatches)
     {
-        gGraphicsDevice.BindTexture(eTextureUnit_0, currBatch.mSpriteTexture);
+        // instance attributes are sourced from first instance of batch
+        instanceFormat.mBaseOffset = Sizeof_SpriteInstance3D * (baseInstance + currBatch.mFirstInstance);
+        mTrimeshBuffer.Bind(instanceFormat);
 
-        unsigned int idxBufferOffset = Sizeof_DrawIndex * currBatch.mFirstIndex;
-        gGraphicsDevice.RenderIndexedPrimitives(ePrimitiveType_Triangles, eIndicesType_i32, idxBufferOffset, currBatch.mIndexCount);
+        gGraphicsDevice.BindTexture(eTextureUnit_0, currBatch.mSpriteTexture);
+        gGraphicsDevice.RenderIndexedPrimitivesInstanced(ePrimitiveType_Triangles, eIndicesType_i32, 0, NumIndicesPerSprite, currBatch.mInstanceCount);
     }
 }
 
-void SpriteBatch::BeginBatch(DepthAxis depthAxis, eSpritesSortMode sortMode)
+void SpriteBatch::BeginBatch(eSpritesSortMode sortMode)
 {
     Clear();
 
-    mDepthAxis = depthAxis;
     mSortMode = sortMode;
 }
 
-void SpriteBatch::SortSprites()
+void SpriteDrawList::SortSprites(eSpritesSortMode sortMode)
 {
-    if (mSortMode == eSpritesSortMode_None)
+    if (sortMode == eSpritesSortMode_None)
         return;
 
-    if (mSortMode == eSpritesSortMode_Height)
+    const int numSprites = mSprites.size();
+    mSortKeys.resize(numSprites);
+    mSortKeysScratch.resize(numSprites);
+    mSortIndices.resize(numSprites);
+    mSortIndicesScratch.resize(numSprites);
+
+    const bool sortByHeight = (sortMode == eSpritesSortMode_Height || sortMode == eSpritesSortMode_HeightAndDrawOrder);
+    const bool sortByDrawOrder = (sortMode == eSpritesSortMode_DrawOrder || sortMode == eSpritesSortMode_HeightAndDrawOrder);
+
+    // build keys: height in bits 32-63, draw order in bits 16-31, texture index in bits 0-15
+    mSortTextures.clear();
+    GpuTexture2D* prevTexture = nullptr;
+    unsigned long long textureIndex = 0;
+    for (int isprite = 0; isprite < numSprites; ++isprite)
     {
-        static auto SortProc = [](const Sprite2D& lhs, const Sprite2D& rhs)
+        const Sprite2D& sprite = mSprites[isprite];
+        // sprites of same texture usually come in sequence
+        if (isprite == 0 || sprite.mTexture != prevTexture)
         {
-            return lhs.mHeight < rhs.mHeight;
-        };
-        std::sort(mSpritesList.begin(), mSpritesList.end(), SortProc);
-        return;
-    }
+            prevTexture = sprite.mTexture;
+            auto texture_iterator = std::find(mSortTextures.begin(), mSortTextures.end(), prevTexture);
+            textureIndex = (texture_iterator - mSortTextures.begin());
+            if (texture_iterator == mSortTextures.end())
+            {
+                mSortTextures.push_back(prevTexture);
+            }
+            debug_assert(textureIndex <= 0xFFFF);
+        }
 
-    if (mSortMode == eSpritesSortMode_DrawOrder)
-    {
-        static auto SortProc = [](const Sprite2D& lhs, const Sprite2D& rhs)
+        unsigned long long sortKey = textureIndex;
+        if (sortByHeight)
         {
-            return lhs.mDrawOrder < rhs.mDrawOrder;
-        };
-        std::sort(mSpritesList.begin(), mSpritesList.end(), SortProc);
-        return;
+            sortKey |= ((unsigned long long) cxx::float_to_sortable_bits(sprite.mHeight)) << 32;
+        }
+        if (sortByDrawOrder)
+        {
+            debug_assert(sprite.mDrawOrder <= 0xFFFF);
+            sortKey |= ((unsigned long long) sprite.mDrawOrder) << 16;
+        }
+        mSortKeys[isprite] = sortKey;
+        mSortIndices[isprite] = isprite;
     }
 
-    if (mSortMode == eSpritesSortMode_HeightAndDrawOrder)
+    cxx::radix_sort(mSortKeys.data(), mSortIndices.data(), numSprites, mSortKeysScratch.data(), mSortIndicesScratch.data());
+
+    // gather, each sprite is copied once
+    mSortedSprites.resize(numSprites);
+    for (int isprite = 0; isprite < numSprites; ++isprite)
     {
-        static auto SortProc = [](const Sprite2D& lhs, const Sprite2D& rhs)
-        {
-            if (lhs.mHeight != rhs.mHeight)
-            {
-                return (lhs.mHeight < rhs.mHeight);
-            }
-            return (lhs.mDrawOrder < rhs.mDrawOrder);
-        };  
-        std::sort(mSpritesList.begin(), mSpritesList.end(), SortProc);
-        return;
+        mSortedSprites[isprite] = mSprites[mSortIndices[isprite]];
     }
+    mSprites.swap(mSortedSprites);
 }
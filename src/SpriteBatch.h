@@ -12,22 +12,69 @@ enum eSpritesSortMode
     eSpritesSortMode_HeightAndDrawOrder,
 };
 
-// defines renderer class for 2d sprites
-class SpriteBatch final: public cxx::noncopyable
+// defines list of sprites which get sorted and grouped into batches by texture before drawing,
+// gpu is not accessed so separate lists can be built on worker threads and then drawn by sprite batch
+class SpriteDrawList
 {
 public:
+    // single batch of drawing sprites
+    struct DrawBatch
+    {
+        unsigned int mFirstInstance;
+        unsigned int mInstanceCount;
+        GpuTexture2D* mSpriteTexture;
+    };
+
+public:
+    // discard sprites, instances and batches
+    void Clear();
+
+    // sort sprites and generate draw instances and batches, after that list is ready to be drawn
+    // @param sortMode: Sprites sort mode
+    void Build(eSpritesSortMode sortMode);
+
+    // sort sprites by 64 bit keys, sort criteria goes to high bits and texture index goes to low bits,
+    // so sprites with same texture stay together and batches are not broken, order of equal sprites is preserved
+    // @param sortMode: Sprites sort mode
+    void SortSprites(eSpritesSortMode sortMode);
+
+    // generate draw instances and batches of sprites in their current order
+    // @param instanceData: Destination buffer, may point to mapped gpu memory
+    void GenerateBatches(SpriteInstance3D* instanceData);
+
+public:
+    std::vector<Sprite2D> mSprites;
+    std::vector<SpriteInstance3D> mInstances; // generated on build
+    std::vector<DrawBatch> mBatches;
 
-    enum DepthAxis { DepthAxis_Y, DepthAxis_Z };
+private:
+    // sorting buffers, kept between builds to avoid allocations
+    std::vector<unsigned long long> mSortKeys;
+    std::vector<unsigned long long> mSortKeysScratch;
+    std::vector<unsigned int> mSortIndices;
+    std::vector<unsigned int> mSortIndicesScratch;
+    std::vector<GpuTexture2D*> mSortTextures; // distinct textures, index is used as part of sort key
+    std::vector<Sprite2D> mSortedSprites;
+};
 
+// defines renderer class for 2d sprites, each sprite is drawn as instance of single quad,
+// depth axis is defined by render program - sprites program uses Y and gui sprites program uses Z
+class SpriteBatch final: public cxx::noncopyable
+{
+public:
     // init/deinit internal resources of sprite batch
     bool Initialize();
     void Deinit();
 
-    void BeginBatch(DepthAxis depthAxis, eSpritesSortMode sortMode);
+    void BeginBatch(eSpritesSortMode sortMode);
 
     // sort and then render all sprites in current batch
     void Flush();
 
+    // render prebuilt draw list, sprites in current batch are not affected
+    // @param drawList: Sprites draw list, must be built
+    void Flush(const SpriteDrawList& drawList);
+
     // discard all batched sprites
     void Clear();
 
@@ -35,31 +82,25 @@ public:
     // @param sourceSprite: Source sprite data
     void DrawSprite(const Sprite2D& sourceSprite);
 
-private:
-    void GenerateSpritesBatches();
-    void RenderSpritesBatches();
-    void SortSprites();
+    // add multiple sprites to batch but does not draw them immediately
+    // @param sprites: Source sprites data
+    void DrawSprites(const std::vector<Sprite2D>& sprites);
+
+    // move sprites added since batch began out of batch without drawing them
+    // @param outSprites: Output sprites list, its previous content is dropped
+    void DetachSprites(std::vector<Sprite2D>& outSprites);
 
 private:
-    // single batch of drawing sprites
-    struct DrawSpriteBatch
-    {
-        unsigned int mFirstVertex;
-        unsigned int mFirstIndex;
-        unsigned int mVertexCount;
-        unsigned int mIndexCount;
-        GpuTexture2D* mSpriteTexture;
-    };
-    // all sprites stored as is until they needs to be flushed
-    std::vector<Sprite2D> mSpritesList;
+    // @param drawList: Sprites draw list
+    // @param baseInstance: Index of first instance within instance buffer
+    void RenderSpritesBatches(const SpriteDrawList& drawList, unsigned int baseInstance);
 
-    // draw data buffers
-    std::vector<SpriteVertex3D> mDrawVertices;
-    std::vector<DrawIndex> mDrawIndices;
+private:
+    // all sprites stored as is until they needs to be flushed,
+    // draw instances buffer is used only if streaming buffers are not available
+    SpriteDrawList mDrawList;
 
-    std::vector<DrawSpriteBatch> mBatchesList;
-    TrimeshBuffer mTrimeshBuffer;
+    TrimeshBuffer mTrimeshBuffer; // streaming instances and static quad indices
 
-    DepthAxis mDepthAxis = DepthAxis_Y;
     eSpritesSortMode mSortMode = eSpritesSortMode_None;
 };
\ No newline at end of file
@@ -9,47 +9,124 @@
 #include "GameCheatsWindow.h"
 #include "MemoryManager.h"
 
+// entries of blocks indices table with this bit set refer to animation frames record instead of block texture,
+// must match city_mesh.glsl
+const int BlocksAnimationFramesFlag = 0x4000;
+
 const int ObjectsTextureSizeX = 2048;
 const int ObjectsTextureSizeY = 1024;
 const int SpritesSpacing = 4;
+const int DeltaSpritesAtlasSize = 1024;
+const int DeltaSpritesAtlasPageSize = 128;
 
 SpriteManager gSpriteManager;
 
 bool SpriteManager::InitLevelSprites()
 {
     Cleanup();
+
+    if (!PrepareLevelSprites())
+        return false;
+
+    // upload everything at once
+    bool isCompleted = false;
+    if (!UploadLevelSprites(mBlocksTexturesCount, isCompleted))
+        return false;
+
+    debug_assert(isCompleted);
+    return true;
+}
+
+bool SpriteManager::PrepareLevelSprites()
+{
     debug_assert(gGameMap.mStyleData.IsLoaded());
 
-    if (!InitBlocksTexture())
+    if (!PrepareBlocksTexture())
     {
         gConsole.LogMessage(eLogMessage_Warning, "Cannot create blocks texture");
         return false;
     }
 
-    if (!InitBlocksIndicesTable())
+    if (!PrepareObjectsSpritesheet())
     {
-        gConsole.LogMessage(eLogMessage_Warning, "Cannot initialize blocks indices table texture");
+        gConsole.LogMessage(eLogMessage_Warning, "Cannot create objects spritesheet");
         return false;
     }
+    return true;
+}
 
-    if (!InitObjectsSpritesheet())
+bool SpriteManager::UploadLevelSprites(int maxBlockTextures, bool& isCompleted)
+{
+    isCompleted = false;
+
+    if (!mLevelSpritesUploadStarted)
     {
-        gConsole.LogMessage(eLogMessage_Warning, "Cannot create objects spritesheet");
-        return false;
+        mLevelSpritesUploadStarted = true;
+
+        if (!InitBlocksTexture())
+        {
+            gConsole.LogMessage(eLogMessage_Warning, "Cannot create blocks texture");
+            return false;
+        }
+
+        if (!InitBlocksIndicesTable())
+        {
+            gConsole.LogMessage(eLogMessage_Warning, "Cannot initialize blocks indices table texture");
+            return false;
+        }
+
+        if (!InitObjectsSpritesheet())
+        {
+            gConsole.LogMessage(eLogMessage_Warning, "Cannot create objects spritesheet");
+            return false;
+        }
+
+        InitPalettesTable();
     }
 
-    InitPalettesTable();
+    // upload next portion of block textures
+    const int numTextures = std::min(maxBlockTextures, mBlocksTexturesCount - mBlocksTexturesUploaded);
+    if (numTextures > 0)
+    {
+        const unsigned char* sourceData = mBlocksTexturePixels.mData + mBlocksTexturesUploaded * MAP_BLOCK_TEXTURE_AREA;
+        if (!mBlocksTextureArray->Upload(mBlocksTexturesUploaded, numTextures, sourceData))
+        {
+            debug_assert(false);
+        }
+        mBlocksTexturesUploaded += numTextures;
+    }
+
+    if (mBlocksTexturesUploaded < mBlocksTexturesCount)
+        return true;
+
     InitBlocksAnimations();
     InitExplosionFrames();
+
+    // pixels are not needed anymore
+    mBlocksTexturePixels.Cleanup();
+    mObjectsSpritesheetPixels.Cleanup();
+
+    isCompleted = true;
     return true;
 }
 
+float SpriteManager::GetLevelSpritesUploadProgress() const
+{
+    if (mBlocksTexturesCount < 1)
+        return 0.0f;
+
+    return (mBlocksTexturesUploaded * 1.0f) / mBlocksTexturesCount;
+}
+
 void SpriteManager::Cleanup()
 {
     FlushSpritesCache();
     DestroySpriteTextures();
     FreeExplosionFrames();
     mIndicesTableChanged = false;
+    mBlocksAnimationOnGpu = false;
+    mBlocksAnimationTime = 0.0;
+    mBlocksAnimationCycle = 0;
     if (mBlocksTextureArray)
     {
         gGraphicsDevice.DestroyTexture(mBlocksTextureArray);
@@ -83,9 +160,15 @@ void SpriteManager::Cleanup()
     mBlocksIndices.clear();
     mBlocksAnimations.clear();
     mObjectsSpritesheet.mEntries.clear();
+
+    mBlocksTexturePixels.Cleanup();
+    mObjectsSpritesheetPixels.Cleanup();
+    mBlocksTexturesCount = 0;
+    mBlocksTexturesUploaded = 0;
+    mLevelSpritesUploadStarted = false;
 }
 
-bool SpriteManager::InitObjectsSpritesheet()
+bool SpriteManager::PrepareObjectsSpritesheet()
 {
     StyleData& cityStyle = gGameMap.mStyleData;
 
@@ -100,23 +183,16 @@ bool SpriteManager::InitObjectsSpritesheet()
     debug_assert(ObjectsTextureSizeX > 0);
     debug_assert(ObjectsTextureSizeY > 0);
 
-    mObjectsSpritesheet.mSpritesheetTexture = gGraphicsDevice.CreateTexture2D(eTextureFormat_R8UI, ObjectsTextureSizeX, ObjectsTextureSizeY, nullptr);
-    debug_assert(mObjectsSpritesheet.mSpritesheetTexture);
-
-    if (mObjectsSpritesheet.mSpritesheetTexture == nullptr)
-        return false;
-
     mObjectsSpritesheet.mEntries.resize(totalSprites);
 
-    // allocate temporary bitmap
-    PixelsArray spritesBitmap;
-    if (!spritesBitmap.Create(eTextureFormat_R8UI, ObjectsTextureSizeX, ObjectsTextureSizeY, gMemoryManager.mFrameHeapAllocator))
+    // allocate bitmap, it is kept until upload
+    if (!mObjectsSpritesheetPixels.Create(eTextureFormat_R8UI, ObjectsTextureSizeX, ObjectsTextureSizeY))
     {
         debug_assert(false);
         return false;
     }
 
-    spritesBitmap.FillWithColor(0);
+    mObjectsSpritesheetPixels.FillWithColor(0);
 
     // detect total layers count
     std::vector<stbrp_node> stbrp_nodes(ObjectsTextureSizeX);
@@ -142,7 +218,7 @@ bool SpriteManager::InitObjectsSpritesheet()
 		stbrp_init_target(&context, ObjectsTextureSizeX, ObjectsTextureSizeY, stbrp_nodes.data(), stbrp_nodes.size());
 		all_done = stbrp_pack_rects(&context, stbrp_rects.data(), stbrp_rects.size()) > 0;
 
-        // write sprites to temporary bitmap
+        // write sprites to bitmap
         int numPacked = 0;
         for (const stbrp_rect& curr_rc: stbrp_rects)
         {
@@ -150,7 +226,7 @@ bool SpriteManager::InitObjectsSpritesheet()
                 continue;
 
             ++numPacked;
-            if (!cityStyle.GetSpriteTexture(curr_rc.id, &spritesBitmap, curr_rc.x, curr_rc.y))
+            if (!cityStyle.GetSpriteTexture(curr_rc.id, &mObjectsSpritesheetPixels, curr_rc.x, curr_rc.y))
             {
                 debug_assert(false);
                 return false;
@@ -172,18 +248,25 @@ bool SpriteManager::InitObjectsSpritesheet()
             debug_assert(false);
             return false;
         }
-
-        // upload to texture
-        if (!mObjectsSpritesheet.mSpritesheetTexture->Upload(spritesBitmap.mData))
-        {
-            debug_assert(false);
-        }
     }
     debug_assert(all_done);
     return all_done;
 }
 
-bool SpriteManager::InitBlocksTexture()
+bool SpriteManager::InitObjectsSpritesheet()
+{
+    if (!mObjectsSpritesheetPixels.HasContent())
+        return true;
+
+    mObjectsSpritesheet.mSpritesheetTexture = gGraphicsDevice.CreateTexture2D(eTextureFormat_R8UI, 
+        mObjectsSpritesheetPixels.mSizex, 
+        mObjectsSpritesheetPixels.mSizey, mObjectsSpritesheetPixels.mData);
+    debug_assert(mObjectsSpritesheet.mSpritesheetTexture);
+
+    return mObjectsSpritesheet.mSpritesheetTexture != nullptr;
+}
+
+bool SpriteManager::PrepareBlocksTexture()
 {
     StyleData& cityStyle = gGameMap.mStyleData;
     // count textures
@@ -195,16 +278,12 @@ bool SpriteManager::InitBlocksTexture()
         return true;
     }
 
-    // allocate temporary bitmap
-    PixelsArray blockBitmap;
-    if (!blockBitmap.Create(eTextureFormat_R8, MAP_BLOCK_TEXTURE_DIMS, MAP_BLOCK_TEXTURE_DIMS, gMemoryManager.mFrameHeapAllocator))
+    // textures are stacked vertically so each one occupies continuous memory region
+    if (!mBlocksTexturePixels.Create(eTextureFormat_R8, MAP_BLOCK_TEXTURE_DIMS, MAP_BLOCK_TEXTURE_DIMS * totalTextures))
     {
         debug_assert(false);
         return false;
     }
-
-    mBlocksTextureArray = gGraphicsDevice.CreateTextureArray2D(eTextureFormat_R8UI, blockBitmap.mSizex, blockBitmap.mSizey, totalTextures, nullptr);
-    debug_assert(mBlocksTextureArray);
     
     int currentLayerIndex = 0;
     for (int iblockType = 0; iblockType < eBlockType_COUNT; ++iblockType)
@@ -212,21 +291,31 @@ bool SpriteManager::InitBlocksTexture()
         int numTextures = cityStyle.GetBlockTexturesCount((eBlockType) iblockType);
         for (int itexture = 0; itexture < numTextures; ++itexture)
         {
-            if (!cityStyle.GetBlockTexture((eBlockType) iblockType, itexture, &blockBitmap, 0, 0, 0))
+            if (!cityStyle.GetBlockTexture((eBlockType) iblockType, itexture, &mBlocksTexturePixels, 0, currentLayerIndex * MAP_BLOCK_TEXTURE_DIMS, 0))
             {
                 gConsole.LogMessage(eLogMessage_Warning, "Cannot read block texture: %d %d", iblockType, itexture);
                 return false;
             }
-
-            // upload bitmap to gpu
-            if (!mBlocksTextureArray->Upload(currentLayerIndex, 1, blockBitmap.mData))
-            {
-                debug_assert(false);
-            }
-            
             ++currentLayerIndex;
         }
     }
+    mBlocksTexturesCount = totalTextures;
+    return true;
+}
+
+bool SpriteManager::InitBlocksTexture()
+{
+    if (mBlocksTexturesCount == 0)
+        return true;
+
+    mBlocksTextureArray = gGraphicsDevice.CreateTextureArray2D(eTextureFormat_R8UI, MAP_BLOCK_TEXTURE_DIMS, MAP_BLOCK_TEXTURE_DIMS, mBlocksTexturesCount, nullptr);
+    debug_assert(mBlocksTextureArray);
+
+    if (mBlocksTextureArray == nullptr)
+        return false;
+
+    // merged faces of city mesh tile block texture
+    mBlocksTextureArray->SetSamplerState(mBlocksTextureArray->mFiltering, eTextureWrapMode_Repeat);
     return true;
 }
 
@@ -251,14 +340,55 @@ bool SpriteManager::InitBlocksIndicesTable()
         mBlocksIndices[i] = i;
     }
 
+    // with gpu animation table is uploaded once along with frames of all animated blocks,
+    // otherwise it gets patched and uploaded every time animation frame changes
+    std::vector<unsigned short> blocksFramesTable;
+    if (gSystem.mConfig.mGpuBlocksAnimation)
+    {
+        blocksFramesTable = mBlocksIndices;
+        mBlocksAnimationOnGpu = AppendBlocksAnimationFrames(blocksFramesTable);
+        if (!mBlocksAnimationOnGpu)
+        {
+            gConsole.LogMessage(eLogMessage_Warning, "Blocks animation frames do not fit into indices table, fallback to cpu animation");
+        }
+    }
+
+    const std::vector<unsigned short>& tableData = mBlocksAnimationOnGpu ? blocksFramesTable : mBlocksIndices;
     mBlocksIndicesTable = gGraphicsDevice.CreateBufferTexture(eTextureFormat_R16UI, 
-        mBlocksIndices.size() * sizeof(unsigned short), 
-        mBlocksIndices.data());
+        tableData.size() * sizeof(unsigned short), 
+        tableData.data());
     debug_assert(mBlocksIndicesTable);
 
     return true;
 }
 
+bool SpriteManager::AppendBlocksAnimationFrames(std::vector<unsigned short>& blocksTable) const
+{
+    StyleData& cityStyle = gGameMap.mStyleData;
+
+    if (blocksTable.size() >= BlocksAnimationFramesFlag)
+        return false;
+
+    // record layout: frames count, game cycles per frame, frames
+    for (const BlockAnimationInfo& currAnim: cityStyle.mBlocksAnimations)
+    {
+        const int recordOffset = (int) blocksTable.size();
+        if (recordOffset >= BlocksAnimationFramesFlag)
+            return false;
+
+        const int blockIndex = cityStyle.GetBlockTextureLinearIndex((currAnim.mWhich == 0 ? eBlockType_Side : eBlockType_Lid), currAnim.mBlock);
+        blocksTable[blockIndex] = (unsigned short) (BlocksAnimationFramesFlag | recordOffset);
+        blocksTable.push_back((unsigned short) (currAnim.mFrameCount + 1));
+        blocksTable.push_back((unsigned short) std::max(currAnim.mSpeed, 1));
+        blocksTable.push_back((unsigned short) blockIndex); // initial frame
+        for (int iframe = 0; iframe < currAnim.mFrameCount; ++iframe)
+        {
+            blocksTable.push_back((unsigned short) cityStyle.GetBlockTextureLinearIndex(eBlockType_Aux, currAnim.mFrames[iframe]));
+        }
+    }
+    return true;
+}
+
 void SpriteManager::InitPalettesTable()
 {
     StyleData& cityStyle = gGameMap.mStyleData;
@@ -279,11 +409,10 @@ void SpriteManager::InitPalettesTable()
 
 void SpriteManager::RenderFrameBegin()
 {
+    // animation time is advanced by game simulation, so it is captured while frame gets prepared
+    mBlocksAnimationCycle = (int) (mBlocksAnimationTime * GTA_CYCLES_PER_FRAME);
 
-}
-
-void SpriteManager::RenderFrameEnd()
-{
+    // indices table is patched by game simulation, so upload happens while frame gets prepared
     if (mIndicesTableChanged)
     {
         // upload indices table
@@ -293,6 +422,10 @@ void SpriteManager::RenderFrameEnd()
     }
 }
 
+void SpriteManager::RenderFrameEnd()
+{
+}
+
 void SpriteManager::InitBlocksAnimations()
 {
     StyleData& cityStyle = gGameMap.mStyleData;
@@ -320,6 +453,13 @@ void SpriteManager::UpdateBlocksAnimations(float deltaTime)
     if (!gGameCheatsWindow.mEnableBlocksAnimation)
         return;
 
+    // frames are picked by city mesh shader, so only time advances
+    if (mBlocksAnimationOnGpu)
+    {
+        mBlocksAnimationTime += deltaTime;
+        return;
+    }
+
     for (BlockAnimation& currAnim: mBlocksAnimations)
     {
         if (!currAnim.AdvanceAnimation(deltaTime))
@@ -489,7 +629,7 @@ void SpriteManager::FlushSpritesCache()
     // move all textures to pool
     for (SpriteCacheElement& currElement: mSpritesCache)
     {
-        mFreeSpriteTextures.push_back(currElement.mTexture);
+        ReleaseSpriteTexture(currElement);
     }
 
     mSpritesCache.clear();
@@ -502,7 +642,7 @@ void SpriteManager::FlushSpritesCache(GameObjectID objectID)
         if (icurrent->mObjectID == objectID)
         {
             // move texture to pool
-            mFreeSpriteTextures.push_back(icurrent->mTexture);
+            ReleaseSpriteTexture(*icurrent);
 
             icurrent = mSpritesCache.erase(icurrent);
             continue;
@@ -511,6 +651,16 @@ void SpriteManager::FlushSpritesCache(GameObjectID objectID)
     }
 }
 
+void SpriteManager::ReleaseSpriteTexture(const SpriteCacheElement& cacheElement)
+{
+    if (cacheElement.mTexture == mDeltaSpritesAtlas)
+    {
+        mDeltaSpritesAtlasAllocator.Free(cacheElement.mTextureArea);
+        return;
+    }
+    mFreeSpriteTextures.push_back(cacheElement.mTexture);
+}
+
 void SpriteManager::DestroySpriteTextures()
 {
     for (GpuTexture2D* currTexture: mFreeSpriteTextures)
@@ -518,6 +668,28 @@ void SpriteManager::DestroySpriteTextures()
         gGraphicsDevice.DestroyTexture(currTexture);
     }
     mFreeSpriteTextures.clear();
+
+    if (mDeltaSpritesAtlas)
+    {
+        gGraphicsDevice.DestroyTexture(mDeltaSpritesAtlas);
+        mDeltaSpritesAtlas = nullptr;
+    }
+    mDeltaSpritesAtlasAllocator.Cleanup();
+}
+
+bool SpriteManager::AllocateDeltaSpritesAtlasCell(const Point& dimensions, Rect& outRectangle)
+{
+    if (mDeltaSpritesAtlas == nullptr)
+    {
+        mDeltaSpritesAtlas = gGraphicsDevice.CreateTexture2D(eTextureFormat_R8UI, DeltaSpritesAtlasSize, DeltaSpritesAtlasSize, nullptr);
+        if (mDeltaSpritesAtlas == nullptr)
+        {
+            debug_assert(false);
+            return false;
+        }
+        mDeltaSpritesAtlasAllocator.Setup(Point(DeltaSpritesAtlasSize, DeltaSpritesAtlasSize), DeltaSpritesAtlasPageSize);
+    }
+    return mDeltaSpritesAtlasAllocator.Allocate(dimensions, outRectangle);
 }
 
 void SpriteManager::GetSpriteTexture(GameObjectID objectID, int spriteIndex, int remap, SpriteDeltaBits deltaBits, Sprite2D& sourceSprite)
@@ -558,10 +730,12 @@ void SpriteManager::GetSpriteTexture(GameObjectID objectID, int spriteIndex, int
             currElement.mSpriteDeltaBits = deltaBits;
 
             // upload changes
+            const Rect& textureArea = currElement.mTextureArea;
+
             PixelsArray pixels;
             if (!pixels.Create(currElement.mTexture->mFormat, 
-                currElement.mTexture->mSize.x, 
-                currElement.mTexture->mSize.y, gMemoryManager.mFrameHeapAllocator))
+                textureArea.w, 
+                textureArea.h, gMemoryManager.mFrameHeapAllocator))
             {
                 debug_assert(false);
             }
@@ -572,24 +746,33 @@ void SpriteManager::GetSpriteTexture(GameObjectID objectID, int spriteIndex, int
             }
             sourceSprite.mTextureRegion = currElement.mTextureRegion;
             sourceSprite.mTexture = currElement.mTexture;
-            sourceSprite.mTexture->Upload(pixels.mData);
+            sourceSprite.mTexture->Upload(0, textureArea.x, textureArea.y, textureArea.w, textureArea.h, pixels.mData);
             return;
         }
     }
     
     // cache miss
-    Point dimensions;
-    dimensions.x = cxx::get_next_pot(spriteStyle.mWidth);
-    dimensions.y = cxx::get_next_pot(spriteStyle.mHeight);
-
-    sourceSprite.mTexture = GetFreeSpriteTexture(dimensions, eTextureFormat_R8UI);
-    if (sourceSprite.mTexture == nullptr)
+    Rect textureArea;
+    if (AllocateDeltaSpritesAtlasCell(Point(spriteStyle.mWidth, spriteStyle.mHeight), textureArea))
     {
-        debug_assert(false);
+        sourceSprite.mTexture = mDeltaSpritesAtlas;
+    }
+    else
+    {
+        textureArea.x = 0;
+        textureArea.y = 0;
+        textureArea.w = cxx::get_next_pot(spriteStyle.mWidth);
+        textureArea.h = cxx::get_next_pot(spriteStyle.mHeight);
+
+        sourceSprite.mTexture = GetFreeSpriteTexture(Point(textureArea.w, textureArea.h), eTextureFormat_R8UI);
+        if (sourceSprite.mTexture == nullptr)
+        {
+            debug_assert(false);
+        }
     }
 
     PixelsArray pixels;
-    if (!pixels.Create(eTextureFormat_R8UI, dimensions.x, dimensions.y, 
+    if (!pixels.Create(eTextureFormat_R8UI, textureArea.w, textureArea.h, 
         gMemoryManager.mFrameHeapAllocator))
     {
         debug_assert(false);
@@ -604,15 +787,15 @@ void SpriteManager::GetSpriteTexture(GameObjectID objectID, int spriteIndex, int
     }
 
     // upload to texture
-    sourceSprite.mTexture->Upload(pixels.mData);
+    sourceSprite.mTexture->Upload(0, textureArea.x, textureArea.y, textureArea.w, textureArea.h, pixels.mData);
 
     Rect srcRect;
-    srcRect.x = 0;
-    srcRect.y = 0;
+    srcRect.x = textureArea.x;
+    srcRect.y = textureArea.y;
     srcRect.w = spriteStyle.mWidth;
     srcRect.h = spriteStyle.mHeight;
 
-    sourceSprite.mTextureRegion.SetRegion(srcRect, dimensions);
+    sourceSprite.mTextureRegion.SetRegion(srcRect, sourceSprite.mTexture->mSize);
 
     // add to sprites cache
     SpriteCacheElement spriteCacheElement;
@@ -621,6 +804,7 @@ void SpriteManager::GetSpriteTexture(GameObjectID objectID, int spriteIndex, int
     spriteCacheElement.mSpriteDeltaBits = deltaBits;
     spriteCacheElement.mTexture = sourceSprite.mTexture;
     spriteCacheElement.mTextureRegion = sourceSprite.mTextureRegion;
+    spriteCacheElement.mTextureArea = textureArea;
 
     mSpritesCache.push_back(spriteCacheElement);
 }
@@ -2,6 +2,7 @@
 
 #include "GameDefs.h"
 #include "Sprite2D.h"
+#include "TextureAtlasAllocator.h"
 
 // This class implements caching mechanism for graphic resources
 
@@ -10,7 +11,8 @@
 class SpriteManager final: public cxx::noncopyable
 {
 public:
-    // animating blocks texture indices table
+    // animating blocks texture indices table,
+    // with gpu blocks animation it also contains static frames of animated blocks and never changes
     GpuBufferTexture* mBlocksIndicesTable = nullptr;
 
     GpuTexture2D* mPalettesTable = nullptr;
@@ -26,6 +28,18 @@ public:
     // preload sprite textures for current level
     bool InitLevelSprites();
 
+    // generate level sprites pixels on cpu side, gpu is not accessed so it can be done on worker thread
+    bool PrepareLevelSprites();
+
+    // upload prepared level sprites to gpu, work can be spread across multiple frames
+    // @param maxBlockTextures: Max number of block textures to upload within single call
+    // @param isCompleted: Output flag, set once all sprites are uploaded
+    // @returns false on error
+    bool UploadLevelSprites(int maxBlockTextures, bool& isCompleted);
+
+    // get uploaded level sprites fraction in range [0, 1]
+    float GetLevelSpritesUploadProgress() const;
+
     // flush all currently cached sprites
     void Cleanup();
 
@@ -34,6 +48,10 @@ public:
 
     void UpdateBlocksAnimations(float deltaTime);
 
+    // Get number of game cycles elapsed since blocks animation started, city mesh shader uses it to pick frames
+    // Value is captured on frame begin, so it does not change while game simulation is running
+    inline int GetBlocksAnimationCycle() const { return mBlocksAnimationCycle; }
+
     // force drop cached sprites
     // @param objectID: Specific object identifier
     void FlushSpritesCache();
@@ -64,7 +82,13 @@ public:
 
 private:
     bool InitBlocksIndicesTable();
+    // append frames of animated blocks to indices table, animated blocks entries get replaced with frames offset
+    // @param blocksTable: Indices table
+    // @returns false if table does not fit into entry limits
+    bool AppendBlocksAnimationFrames(std::vector<unsigned short>& blocksTable) const;
+    bool PrepareBlocksTexture();
     bool InitBlocksTexture();
+    bool PrepareObjectsSpritesheet();
     bool InitObjectsSpritesheet();
     void InitPalettesTable();
     void InitBlocksAnimations();
@@ -76,6 +100,12 @@ private:
     GpuTexture2D* GetFreeSpriteTexture(const Point& dimensions, eTextureFormat format);
     void DestroySpriteTextures();
 
+    // allocate area for sprite with deltas within shared atlas, atlas gets created on first use
+    // @param dimensions: Sprite size
+    // @param outRectangle: Allocated area, might be larger than sprite
+    // @returns false if sprite does not fit into atlas
+    bool AllocateDeltaSpritesAtlasCell(const Point& dimensions, Rect& outRectangle);
+
 private:
     // animation state for blocks sharing specific texture
     struct BlockAnimation: public SpriteAnimation
@@ -87,10 +117,25 @@ private:
     std::vector<BlockAnimation> mBlocksAnimations;
     std::vector<unsigned short> mBlocksIndices;
     bool mIndicesTableChanged;
+    bool mBlocksAnimationOnGpu = false; // frames are picked by city mesh shader, indices table is static
+    double mBlocksAnimationTime = 0.0; // seconds, advanced by game simulation
+    int mBlocksAnimationCycle = 0;
+
+    // level sprites pixels waiting for upload
+    PixelsArray mBlocksTexturePixels; // all block textures stacked vertically
+    PixelsArray mObjectsSpritesheetPixels;
+    int mBlocksTexturesCount = 0;
+    int mBlocksTexturesUploaded = 0;
+    bool mLevelSpritesUploadStarted = false;
 
     // usused sprite textures
     std::vector<GpuTexture2D*> mFreeSpriteTextures;
 
+    // sprites with deltas are placed into single texture so they don't break sprites batching,
+    // large sprites or sprites which are not fit into atlas get dedicated textures
+    GpuTexture2D* mDeltaSpritesAtlas = nullptr;
+    TextureAtlasAllocator mDeltaSpritesAtlasAllocator;
+
     // explosion sprite is huge and it was originally split into four pieces, 
     // so it must be assembled in one piece again before use
     std::vector<GpuTexture2D*> mExplosionFrames;
@@ -105,8 +150,11 @@ private:
         SpriteDeltaBits mSpriteDeltaBits; // all deltas applied to this sprite
         GpuTexture2D* mTexture;
         TextureRegion mTextureRegion;
+        Rect mTextureArea; // texture area owned by sprite, either whole texture or atlas cell
     };
     std::vector<SpriteCacheElement> mSpritesCache;
+
+    void ReleaseSpriteTexture(const SpriteCacheElement& cacheElement);
 };
 
 extern SpriteManager gSpriteManager;
\ No newline at end of file
@@ -1,5 +1,6 @@
 #include "stdafx.h"
 #include "StyleData.h"
+#include "TaskManager.h"
 
 //////////////////////////////////////////////////////////////////////////
 
@@ -116,20 +117,37 @@ bool StyleData::LoadFromFile(const std::string& stylesName)
 {
     Cleanup();
 
-    std::ifstream file;
-    if (!gFiles.OpenBinaryFile(stylesName, file))
+    // style sections are decoded in place from mapped file, fallback to reading whole file content
+    cxx::mapped_file mappedFile;
+    std::vector<unsigned char> fileContent;
+
+    const unsigned char* fileData = nullptr;
+    size_t fileLength = 0;
+    if (gFiles.MapBinaryFile(stylesName, mappedFile))
     {
-        gConsole.LogMessage(eLogMessage_Warning, "Cannot open style file '%s'", stylesName.c_str());
-        return false;
+        fileData = mappedFile.get_data();
+        fileLength = mappedFile.get_size();
+    }
+    else
+    {
+        if (!gFiles.ReadBinaryFile(stylesName, fileContent))
+        {
+            gConsole.LogMessage(eLogMessage_Warning, "Cannot open style file '%s'", stylesName.c_str());
+            return false;
+        }
+        fileData = fileContent.data();
+        fileLength = fileContent.size();
     }
-
-    file.seekg(0, std::ios::end);
-    std::streampos fileSize = file.tellg();
-    file.seekg(0, std::ios::beg);
 
     // read header
     GTAFileHeaderG24 header;
-    if (!cxx::read_from_stream(file, header) || header.version_code != GTA_G24FILE_VERSION_CODE)
+    if (fileLength < sizeof(header))
+    {
+        gConsole.LogMessage(eLogMessage_Warning, "Cannot read header of style file '%s'", stylesName.c_str());
+        return false;
+    }
+    memcpy(&header, fileData, sizeof(header));
+    if (header.version_code != GTA_G24FILE_VERSION_CODE)
     {
         gConsole.LogMessage(eLogMessage_Warning, "Cannot read header of style file '%s'", stylesName.c_str());
         return false;
@@ -150,80 +168,93 @@ bool StyleData::LoadFromFile(const std::string& stylesName)
     mRemapClutsCount = header.newcarclut_size / sizeof(Palette256);
     mFontClutsCount = header.fontclut_size / sizeof(Palette256);
 
+    // tile blocks are stored in paged format 256x256 pixels (4x4 tiles)
+    // extra space may be added at the end of aux_block so that the total number of  blocks is a multiple of 4 
+    const int totalBlocks = (mSideBlocksCount + mLidBlocksCount + mAuxBlocksCount);
+    const int blockTexturesLength = cxx::round_up_to(totalBlocks, 4) * MAP_BLOCK_TEXTURE_AREA;
+
     // clut_size, rounded up to 64K
     int clutsDataLength = cxx::round_up_to(header.clut_size, 64 * 1024);
 
-    if (!ReadBlockTextures(file))
+    // all sections follow header in strict order, so offsets are known up front
+    using ReadSectionProc = bool (StyleData::*)(std::istream&, int);
+    struct StyleSection
     {
-        gConsole.LogMessage(eLogMessage_Warning, "Cannot read block textures from style file '%s'", stylesName.c_str());
-        return false;
-    }
-
-    // read the sprite numbers first
-    std::streampos currentPos = file.tellg();
-
-    std::streamoff spriteNumbersDataOffset = clutsDataLength + 
-        header.anim_size + 
-        header.palette_index_size + 
-        header.object_info_size + 
-        header.car_size +
-        header.sprite_info_size + 
-        header.sprite_graphics_size;
-
-    file.seekg(spriteNumbersDataOffset, std::ios::cur);
-
-    if (!ReadSpriteNumbers(file, header.sprite_numbers_size))
+        ReadSectionProc mReadProc;
+        unsigned int mLength;
+        const char* mErrorMessage;
+        unsigned int mOffset = 0;
+        bool mReadSuccess = false;
+    };
+    StyleSection sections[] =
     {
-        gConsole.LogMessage(eLogMessage_Warning, "Cannot read sprite numbers from style file '%s'", stylesName.c_str());
-        return false;
-    }
-
-    file.seekg(currentPos);
-
-    if (!ReadAnimations(file, header.anim_size))
+        {&StyleData::ReadBlockTextures, (unsigned int) blockTexturesLength, "Cannot read block textures from style file '%s'"},
+        {&StyleData::ReadAnimations, header.anim_size, "Cannot read animations from style file '%s'"},
+        {&StyleData::ReadCLUTs, (unsigned int) clutsDataLength, "Cannot read palette data from style file '%s'"},
+        {&StyleData::ReadPaletteIndices, header.palette_index_size, "Cannot read palette indices data from style file '%s'"},
+        {&StyleData::ReadObjects, header.object_info_size, "Cannot read objects data from style file '%s'"},
+        {&StyleData::ReadVehicles, header.car_size, "Cannot read cars data from style file '%s'"},
+        {&StyleData::ReadSprites, header.sprite_info_size, "Cannot read sprites info from style file '%s'"},
+        {&StyleData::ReadSpriteGraphics, header.sprite_graphics_size, "Cannot read sprite graphics from style file '%s'"},
+        {&StyleData::ReadSpriteNumbers, header.sprite_numbers_size, "Cannot read sprite numbers from style file '%s'"},
+    };
+    StyleSection& spriteNumbersSection = sections[CountOf(sections) - 1];
+
+    size_t sectionOffset = sizeof(header);
+    for (StyleSection& currSection: sections)
     {
-        gConsole.LogMessage(eLogMessage_Warning, "Cannot read animations from style file '%s'", stylesName.c_str());
-        return false;
+        currSection.mOffset = (unsigned int) sectionOffset;
+        sectionOffset += currSection.mLength;
     }
 
-    if (!ReadCLUTs(file, clutsDataLength))
+    if (sectionOffset > fileLength)
     {
-        gConsole.LogMessage(eLogMessage_Warning, "Cannot read palette data from style file '%s'", stylesName.c_str());
+        gConsole.LogMessage(eLogMessage_Warning, "Style file '%s' is truncated", stylesName.c_str());
         return false;
     }
 
-    if (!ReadPaletteIndices(file, header.palette_index_size))
+    auto ReadSection = [this, fileData](StyleSection& section)
     {
-        gConsole.LogMessage(eLogMessage_Warning, "Cannot read palette indices data from style file '%s'", stylesName.c_str());
-        return false;
-    }
-
-    if (!ReadObjects(file, header.object_info_size))
+        // stream buffer requires non-const pointers but data is never modified
+        char* sectionData = const_cast<char*>(reinterpret_cast<const char*>(fileData + section.mOffset));
+        cxx::memory_istream sectionBuffer(sectionData, sectionData + section.mLength);
+        std::istream sectionStream(&sectionBuffer);
+        section.mReadSuccess = (this->*section.mReadProc)(sectionStream, section.mLength);
+    };
+
+    // read the sprite numbers first, vehicles data depends on it
+    ReadSection(spriteNumbersSection);
+    if (!spriteNumbersSection.mReadSuccess)
     {
-        gConsole.LogMessage(eLogMessage_Warning, "Cannot read objects data from style file '%s'", stylesName.c_str());
+        gConsole.LogMessage(eLogMessage_Warning, spriteNumbersSection.mErrorMessage, stylesName.c_str());
         return false;
     }
 
-    if (!ReadVehicles(file, header.car_size))
+    // remaining sections are independent of each other and get decoded in parallel
+    TaskGroup sectionsTasks;
+    for (StyleSection& currSection: sections)
     {
-        gConsole.LogMessage(eLogMessage_Warning, "Cannot read cars data from style file '%s'", stylesName.c_str());
-        return false;
-    }
+        if (&currSection == &spriteNumbersSection)
+            continue;
 
-    if (!ReadSprites(file, header.sprite_info_size))
-    {
-        gConsole.LogMessage(eLogMessage_Warning, "Cannot read sprites info from style file '%s'", stylesName.c_str());
-        return false;
+        gTaskManager.QueueTask([&ReadSection, &currSection]()
+            {
+                ReadSection(currSection);
+            }, 
+            &sectionsTasks);
     }
+    gTaskManager.WaitForTasks(sectionsTasks);
 
-    if (!ReadSpriteGraphics(file, header.sprite_graphics_size))
+    for (const StyleSection& currSection: sections)
     {
-        gConsole.LogMessage(eLogMessage_Warning, "Cannot read sprite graphics from style file '%s'", stylesName.c_str());
-        return false;
+        if (!currSection.mReadSuccess)
+        {
+            gConsole.LogMessage(eLogMessage_Warning, currSection.mErrorMessage, stylesName.c_str());
+            Cleanup();
+            return false;
+        }
     }
 
-    file.close();
-
     if (!InitGameObjectsList())
     {
         gConsole.LogMessage(eLogMessage_Warning, "Fail to initialize game objects");
@@ -608,21 +639,9 @@ int StyleData::GetVehicleSpriteIndex(eVehicleClass vehicleClass, int spriteId) c
     return GetSpriteIndex(spriteType, spriteId);
 }
 
-bool StyleData::ReadBlockTextures(std::ifstream& file)
+bool StyleData::ReadBlockTextures(std::istream& file, int dataLength)
 {
-    const int totalBlocks = (mSideBlocksCount + mLidBlocksCount + mAuxBlocksCount);
-
-    // tile blocks are stored in paged format 256x256 pixels (4x4 tiles)
-    // extra space may be added at the end of aux_block so that the total number of  blocks is a multiple of 4 
-    int extraBlocks = 0;
-    if ((totalBlocks % 4) > 0)
-    {
-        extraBlocks = 4 - (totalBlocks % 4);
-    }
-
-    const int dataLength = (totalBlocks * MAP_BLOCK_TEXTURE_AREA);
-    const int extraLength = (extraBlocks * MAP_BLOCK_TEXTURE_AREA);
-    mBlockTexturesRaw.resize(dataLength + extraLength);
+    mBlockTexturesRaw.resize(dataLength);
 
     if (!file.read(reinterpret_cast<char*>(mBlockTexturesRaw.data()), mBlockTexturesRaw.size()))
         return false;
@@ -630,7 +649,7 @@ bool StyleData::ReadBlockTextures(std::ifstream& file)
     return true;
 }
 
-bool StyleData::ReadCLUTs(std::ifstream& file, int dataLength)
+bool StyleData::ReadCLUTs(std::istream& file, int dataLength)
 {
     const int palCount = dataLength / sizeof(Palette256);
     if (palCount == 0)
@@ -668,7 +687,7 @@ bool StyleData::ReadCLUTs(std::ifstream& file, int dataLength)
     return true;
 }
 
-bool StyleData::ReadPaletteIndices(std::ifstream& file, int dataLength)
+bool StyleData::ReadPaletteIndices(std::istream& file, int dataLength)
 {
     mPaletteIndices.resize(dataLength / sizeof(unsigned short));
     // read bunch of shorts
@@ -678,7 +697,7 @@ bool StyleData::ReadPaletteIndices(std::ifstream& file, int dataLength)
     return true;
 }
 
-bool StyleData::ReadAnimations(std::ifstream& file, int dataLength)
+bool StyleData::ReadAnimations(std::istream& file, int dataLength)
 {
     unsigned char numAnimationBlocks = 0;
     if (!cxx::read_from_stream(file, numAnimationBlocks))
@@ -709,7 +728,7 @@ bool StyleData::ReadAnimations(std::ifstream& file, int dataLength)
     return true;
 }
 
-bool StyleData::ReadObjects(std::ifstream& file, int dataLength)
+bool StyleData::ReadObjects(std::istream& file, int dataLength)
 {
     for (int icurrentObject = 0; dataLength > 0; ++icurrentObject)
     {
@@ -744,7 +763,7 @@ bool StyleData::ReadObjects(std::ifstream& file, int dataLength)
     return dataLength == 0;
 }
 
-bool StyleData::ReadVehicles(std::ifstream& file, int dataLength)
+bool StyleData::ReadVehicles(std::istream& file, int dataLength)
 {
     for (int icurrent = 0; dataLength > 0; ++icurrent)
     {
@@ -880,7 +899,7 @@ bool StyleData::ReadVehicles(std::ifstream& file, int dataLength)
     return dataLength == 0;
 }
 
-bool StyleData::ReadSprites(std::ifstream& file, int dataLength)
+bool StyleData::ReadSprites(std::istream& file, int dataLength)
 {
     for (; dataLength > 0;)
     {
@@ -916,7 +935,7 @@ bool StyleData::ReadSprites(std::ifstream& file, int dataLength)
     return dataLength == 0;
 }
 
-bool StyleData::ReadSpriteGraphics(std::ifstream& file, int dataLength)
+bool StyleData::ReadSpriteGraphics(std::istream& file, int dataLength)
 {
     if (dataLength > 0)
     {
@@ -929,7 +948,7 @@ bool StyleData::ReadSpriteGraphics(std::ifstream& file, int dataLength)
     return true;
 }
 
-bool StyleData::ReadSpriteNumbers(std::ifstream& file, int dataLength)
+bool StyleData::ReadSpriteNumbers(std::istream& file, int dataLength)
 {
     if (dataLength > 0)
     {
@@ -113,17 +113,18 @@ private:
     // apply single delta on sprite
     void ApplySpriteDelta(SpriteInfo& sprite, SpriteInfo::DeltaInfo& spriteDelta, PixelsArray* pixelsArray, int positionX, int positionY);
 
-    // Reading style data internals
+    // Reading style data internals, sections can be read concurrently
     // @param file: Source stream
-    bool ReadBlockTextures(std::ifstream& file);
-    bool ReadCLUTs(std::ifstream& file, int dataLength);
-    bool ReadPaletteIndices(std::ifstream& file, int dataLength);
-    bool ReadAnimations(std::ifstream& file, int dataLength);
-    bool ReadObjects(std::ifstream& file, int dataLength);
-    bool ReadVehicles(std::ifstream& file, int dataLength);
-    bool ReadSprites(std::ifstream& file, int dataLength);
-    bool ReadSpriteGraphics(std::ifstream& file, int dataLength);
-    bool ReadSpriteNumbers(std::ifstream& file, int dataLength);
+    // @param dataLength: Section length
+    bool ReadBlockTextures(std::istream& file, int dataLength);
+    bool ReadCLUTs(std::istream& file, int dataLength);
+    bool ReadPaletteIndices(std::istream& file, int dataLength);
+    bool ReadAnimations(std::istream& file, int dataLength);
+    bool ReadObjects(std::istream& file, int dataLength);
+    bool ReadVehicles(std::istream& file, int dataLength);
+    bool ReadSprites(std::istream& file, int dataLength);
+    bool ReadSpriteGraphics(std::istream& file, int dataLength);
+    bool ReadSpriteNumbers(std::istream& file, int dataLength);
 
     void ReadPedestrianAnimations();
     void ReadWeapons();
@@ -6,6 +6,7 @@
 #include "CarnageGame.h"
 #include "ImGuiManager.h"
 #include "TimeManager.h"
+#include "TaskManager.h"
 
 //////////////////////////////////////////////////////////////////////////
 
@@ -27,6 +28,8 @@ void SystemConfig::SetToDefaults()
     mEnableFrameHeapAllocator = true;
     mShowImguiDemoWindow = false;
     mEnableVSync = false;
+    mPackedCityVertices = true;
+    mGpuBlocksAnimation = true;
     mFullscreen = false;
     mScreenSizex = DefaultScreenResolutionX;
     mScreenSizey = DefaultScreenResolutionY;
@@ -49,6 +52,13 @@ void SystemConfig::InitFromJsonDocument(const cxx::json_document& sourceDocument
         cxx::json_get_attribute(screenConfig, "vsync", mEnableVSync);
     }
 
+    // graphics
+    if (cxx::json_document_node graphicsConfig = configRootNode["graphics"])
+    {
+        cxx::json_get_attribute(graphicsConfig, "packed_city_vertices", mPackedCityVertices);
+        cxx::json_get_attribute(graphicsConfig, "gpu_blocks_animation", mGpuBlocksAnimation);
+    }
+
     // memory
     if (cxx::json_document_node memConfig = configRootNode["memory"])
     {
@@ -145,6 +155,12 @@ void System::Initialize(int argc, char *argv[])
         Terminate();
     }
 
+    if (!gTaskManager.Initialize())
+    {
+        gConsole.LogMessage(eLogMessage_Error, "Cannot initialize task manager");
+        Terminate();
+    }
+
     if (!gGraphicsDevice.Initialize())
     {
         gConsole.LogMessage(eLogMessage_Error, "Cannot initialize graphics device");
@@ -190,6 +206,7 @@ void System::Deinit()
     gGuiManager.Deinit();
     gRenderManager.Deinit();
     gGraphicsDevice.Deinit();
+    gTaskManager.Deinit();
     gMemoryManager.Deinit();
     gFiles.Deinit();
     gConsole.Deinit();
@@ -205,8 +222,32 @@ void System::Execute()
         gMemoryManager.FlushFrameHeapMemory();
         gImGuiManager.UpdateFrame();
         gGuiManager.UpdateFrame();
-        gCarnageGame.UpdateFrame();
-        gRenderManager.RenderFrame();
+
+        // level loading uploads data to gpu, so it can't run along with rendering
+        if (gCarnageGame.IsLoading())
+        {
+            gCarnageGame.UpdateFrame();
+            gRenderManager.PrepareFrame();
+            gRenderManager.RenderFrame();
+        }
+        else
+        {
+            // captured game state is drawn while next game frame is simulated on worker thread
+            gRenderManager.PrepareFrame();
+
+            TaskGroup gameFrameTasks;
+            gTaskManager.QueueTask([]()
+                {
+                    gCarnageGame.UpdateFrame();
+                }, 
+                &gameFrameTasks);
+
+            gRenderManager.RenderFrame();
+            gTaskManager.WaitForTasks(gameFrameTasks);
+        }
+
+        // input events get dispatched to game here, so simulation must be paused
+        gGraphicsDevice.Present();
     }
 }
 
@@ -237,6 +278,13 @@ bool System::LoadConfiguration()
 
     // gta1 data files location
     cxx::json_get_attribute(configRootNode, "gta_gamedata_location", gFiles.mGTADataDirectoryPath);
+
+    // cached data files are stored next to config
+    std::string configPath;
+    if (gFiles.GetFullPathToFile(SysConfigPath, configPath))
+    {
+        gFiles.mCacheDirectoryPath = cxx::get_parent_directory(configPath) + "/cache";
+    }
     return true;
 }
 
@@ -17,6 +17,8 @@ public:
     int mScreenSizex, mScreenSizey; // screen dimensions
     bool mFullscreen; // enable full screen mode
     bool mEnableVSync; // enable vertical synchronization
+    bool mPackedCityVertices; // use compact vertex format for city mesh
+    bool mGpuBlocksAnimation; // pick animated blocks frames in city mesh shader instead of patching indices table
 
     // physics
     float mPhysicsFramerate;
@@ -0,0 +1,207 @@
+#include "stdafx.h"
+#include "TaskManager.h"
+
+//////////////////////////////////////////////////////////////////////////
+
+const int MaxWorkerThreads = 8;
+
+//////////////////////////////////////////////////////////////////////////
+
+TaskManager gTaskManager;
+
+bool TaskManager::Initialize()
+{
+    // keep one core for main thread
+    int numWorkers = (int) std::thread::hardware_concurrency() - 1;
+    numWorkers = glm::clamp(numWorkers, 1, MaxWorkerThreads);
+
+    gConsole.LogMessage(eLogMessage_Info, "Init TaskManager (%d worker threads)", numWorkers);
+
+    mShutdownRequested = false;
+    mWorkerThreads.reserve(numWorkers);
+    for (int iworker = 0; iworker < numWorkers; ++iworker)
+    {
+        mWorkerThreads.emplace_back(&TaskManager::WorkerThreadProc, this);
+    }
+    return true;
+}
+
+void TaskManager::Deinit()
+{
+    {
+        std::lock_guard<std::mutex> lock (mTasksMutex);
+        mShutdownRequested = true;
+    }
+    mTasksCondition.notify_all();
+
+    for (std::thread& currThread: mWorkerThreads)
+    {
+        currThread.join();
+    }
+    mWorkerThreads.clear();
+
+    // tasks that were not started get dropped
+    std::deque<TaskEntry> droppedTasks;
+    {
+        std::lock_guard<std::mutex> lock (mTasksMutex);
+        droppedTasks.swap(mPendingTasks);
+    }
+    for (TaskEntry& currTask: droppedTasks)
+    {
+        if (currTask.mTaskGroup)
+        {
+            CompleteGroupTask(*currTask.mTaskGroup);
+        }
+    }
+}
+
+void TaskManager::QueueTask(TaskProc taskProc, TaskGroup* taskGroup)
+{
+    debug_assert(taskProc);
+
+    if (taskGroup)
+    {
+        taskGroup->mPendingCount.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    TaskEntry taskEntry;
+    taskEntry.mTaskProc = std::move(taskProc);
+    taskEntry.mTaskGroup = taskGroup;
+
+    // no workers, run in place
+    if (mWorkerThreads.empty())
+    {
+        ExecuteTask(taskEntry);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock (mTasksMutex);
+        mPendingTasks.push_back(std::move(taskEntry));
+    }
+    mTasksCondition.notify_one();
+
+    // waiter of group might help with it
+    if (taskGroup)
+    {
+        mGroupsCondition.notify_all();
+    }
+}
+
+void TaskManager::WaitForTasks(TaskGroup& taskGroup)
+{
+    auto IsGroupTask = [&taskGroup](const TaskEntry& taskEntry)
+    {
+        return taskEntry.mTaskGroup == &taskGroup;
+    };
+
+    for (;;)
+    {
+        TaskEntry taskEntry;
+        {
+            // only tasks of same group are processed, so unrelated long task cannot delay waiter,
+            // otherwise sleep until group gets completed or its new task gets queued
+            std::unique_lock<std::mutex> lock (mTasksMutex);
+            std::deque<TaskEntry>::iterator task_iterator;
+            mGroupsCondition.wait(lock, [this, &taskGroup, &task_iterator, &IsGroupTask]()
+                {
+                    if (taskGroup.IsCompleted())
+                        return true;
+
+                    task_iterator = std::find_if(mPendingTasks.begin(), mPendingTasks.end(), IsGroupTask);
+                    return task_iterator != mPendingTasks.end();
+                });
+
+            if (taskGroup.IsCompleted())
+                return;
+
+            taskEntry = std::move(*task_iterator);
+            mPendingTasks.erase(task_iterator);
+        }
+        ExecuteTask(taskEntry);
+    }
+}
+
+void TaskManager::ParallelFor(int count, const IndexedTaskProc& taskProc)
+{
+    if (count < 1)
+        return;
+
+    const int numTasks = std::min(count, GetWorkersCount() + 1);
+    if (numTasks < 2)
+    {
+        for (int icurr = 0; icurr < count; ++icurr)
+        {
+            taskProc(icurr);
+        }
+        return;
+    }
+
+    // indices are distributed dynamically, so uneven work balances out
+    std::atomic<int> nextIndex {0};
+    auto processIndices = [&nextIndex, &taskProc, count]()
+    {
+        for (int icurr = nextIndex.fetch_add(1); icurr < count; icurr = nextIndex.fetch_add(1))
+        {
+            taskProc(icurr);
+        }
+    };
+
+    TaskGroup taskGroup;
+    for (int itask = 1; itask < numTasks; ++itask)
+    {
+        QueueTask(processIndices, &taskGroup);
+    }
+    processIndices();
+    WaitForTasks(taskGroup);
+}
+
+int TaskManager::GetWorkersCount() const
+{
+    return (int) mWorkerThreads.size();
+}
+
+void TaskManager::WorkerThreadProc()
+{
+    for (;;)
+    {
+        TaskEntry taskEntry;
+        {
+            std::unique_lock<std::mutex> lock (mTasksMutex);
+            mTasksCondition.wait(lock, [this]()
+                {
+                    return mShutdownRequested || !mPendingTasks.empty();
+                });
+
+            if (mShutdownRequested)
+                break;
+
+            taskEntry = std::move(mPendingTasks.front());
+            mPendingTasks.pop_front();
+        }
+        ExecuteTask(taskEntry);
+    }
+}
+
+void TaskManager::ExecuteTask(TaskEntry& taskEntry)
+{
+    taskEntry.mTaskProc();
+
+    if (taskEntry.mTaskGroup)
+    {
+        CompleteGroupTask(*taskEntry.mTaskGroup);
+    }
+}
+
+void TaskManager::CompleteGroupTask(TaskGroup& taskGroup)
+{
+    if (taskGroup.mPendingCount.fetch_sub(1, std::memory_order_acq_rel) > 1)
+        return;
+
+    // group must not be accessed after this point, waiter may destroy it as soon as it sees completion;
+    // lock ensures that waiter is either sleeping or has not checked completion yet
+    {
+        std::lock_guard<std::mutex> lock (mTasksMutex);
+    }
+    mGroupsCondition.notify_all();
+}
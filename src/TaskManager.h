@@ -0,0 +1,73 @@
+#pragma once
+
+// defines group of background tasks, allows to wait for completion of all its tasks
+class TaskGroup final: public cxx::noncopyable
+{
+    friend class TaskManager;
+
+public:
+    // test whether all tasks of group are done
+    inline bool IsCompleted() const
+    {
+        return mPendingCount.load(std::memory_order_acquire) == 0;
+    }
+
+private:
+    std::atomic<int> mPendingCount {0};
+};
+
+// defines pool of worker threads which process background tasks
+class TaskManager final: public cxx::noncopyable
+{
+public:
+    using TaskProc = std::function<void()>;
+    using IndexedTaskProc = std::function<void(int)>;
+
+public:
+    // Setup worker threads
+    bool Initialize();
+    void Deinit();
+
+    // Queue task for execution on worker thread
+    // @param taskProc: Task procedure
+    // @param taskGroup: Group that tracks task completion, optional
+    void QueueTask(TaskProc taskProc, TaskGroup* taskGroup = nullptr);
+
+    // Block until all tasks of group are done, calling thread processes pending tasks of same group while waiting,
+    // tasks of other groups are left to workers
+    // @param taskGroup: Group
+    void WaitForTasks(TaskGroup& taskGroup);
+
+    // Run procedure for each index in range [0, count) on worker threads and calling thread, returns when all done
+    // @param count: Number of indices
+    // @param taskProc: Procedure
+    void ParallelFor(int count, const IndexedTaskProc& taskProc);
+
+    // Get number of worker threads, calling thread is not counted
+    int GetWorkersCount() const;
+
+private:
+    struct TaskEntry
+    {
+        TaskProc mTaskProc;
+        TaskGroup* mTaskGroup = nullptr;
+    };
+
+    void WorkerThreadProc();
+
+    void ExecuteTask(TaskEntry& taskEntry);
+
+    // Decrease number of pending tasks of group and wake up waiters once it gets completed
+    // @param taskGroup: Group
+    void CompleteGroupTask(TaskGroup& taskGroup);
+
+private:
+    std::vector<std::thread> mWorkerThreads;
+    std::deque<TaskEntry> mPendingTasks;
+    std::mutex mTasksMutex;
+    std::condition_variable mTasksCondition;
+    std::condition_variable mGroupsCondition; // signaled when group task is queued or group gets completed
+    bool mShutdownRequested = false;
+};
+
+extern TaskManager gTaskManager;
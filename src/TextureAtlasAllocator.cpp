@@ -0,0 +1,119 @@
+#include "stdafx.h"
+#include "TextureAtlasAllocator.h"
+
+// smallest cells are large enough to keep rows aligned for pixels uploads
+const int MinAtlasCellSize = 8;
+
+void TextureAtlasAllocator::Setup(const Point& atlasDimensions, int pageSize)
+{
+    debug_assert(cxx::is_pot(pageSize) && pageSize >= MinAtlasCellSize);
+    debug_assert(atlasDimensions.x >= pageSize && atlasDimensions.y >= pageSize);
+
+    mPageSize = pageSize;
+    mPagesPerRow = atlasDimensions.x / pageSize;
+    mPages.clear();
+    mPages.resize(mPagesPerRow * (atlasDimensions.y / pageSize));
+    mUsedPagesCount = 0;
+}
+
+void TextureAtlasAllocator::Cleanup()
+{
+    mPages.clear();
+    mPagesPerRow = 0;
+    mPageSize = 0;
+    mUsedPagesCount = 0;
+}
+
+bool TextureAtlasAllocator::IsFitsPage(const Point& dimensions) const
+{
+    return dimensions.x > 0 && dimensions.y > 0 && dimensions.x <= mPageSize && dimensions.y <= mPageSize;
+}
+
+bool TextureAtlasAllocator::Allocate(const Point& dimensions, Rect& outRectangle)
+{
+    if (!IsFitsPage(dimensions))
+    {
+        debug_assert(mPageSize > 0);
+        return false;
+    }
+
+    Point cellSize;
+    cellSize.x = std::max((int) cxx::get_next_pot(dimensions.x), MinAtlasCellSize);
+    cellSize.y = std::max((int) cxx::get_next_pot(dimensions.y), MinAtlasCellSize);
+
+    const int numPages = mPages.size();
+
+    // find page which is already split into cells of same size
+    int pageIndex = -1;
+    for (int ipage = 0; ipage < numPages; ++ipage)
+    {
+        const AtlasPage& currPage = mPages[ipage];
+        if (currPage.mCellSize == cellSize && !currPage.mFreeCells.empty())
+        {
+            pageIndex = ipage;
+            break;
+        }
+    }
+
+    // take free page
+    if (pageIndex == -1)
+    {
+        for (int ipage = 0; ipage < numPages; ++ipage)
+        {
+            AtlasPage& currPage = mPages[ipage];
+            if (currPage.mCellsCount > 0)
+                continue;
+
+            currPage.mCellSize = cellSize;
+            currPage.mCellsCount = (mPageSize / cellSize.x) * (mPageSize / cellSize.y);
+            // cells with lower indices are allocated first
+            currPage.mFreeCells.resize(currPage.mCellsCount);
+            for (int icell = 0; icell < currPage.mCellsCount; ++icell)
+            {
+                currPage.mFreeCells[icell] = currPage.mCellsCount - icell - 1;
+            }
+            ++mUsedPagesCount;
+            pageIndex = ipage;
+            break;
+        }
+    }
+
+    if (pageIndex == -1)
+        return false;
+
+    AtlasPage& page = mPages[pageIndex];
+    int cellIndex = page.mFreeCells.back();
+    page.mFreeCells.pop_back();
+
+    const int cellsPerRow = mPageSize / cellSize.x;
+    outRectangle.x = (pageIndex % mPagesPerRow) * mPageSize + (cellIndex % cellsPerRow) * cellSize.x;
+    outRectangle.y = (pageIndex / mPagesPerRow) * mPageSize + (cellIndex / cellsPerRow) * cellSize.y;
+    outRectangle.w = cellSize.x;
+    outRectangle.h = cellSize.y;
+    return true;
+}
+
+void TextureAtlasAllocator::Free(const Rect& rectangle)
+{
+    debug_assert(mPageSize > 0);
+
+    const int pageIndex = (rectangle.y / mPageSize) * mPagesPerRow + (rectangle.x / mPageSize);
+    debug_assert(pageIndex > -1 && pageIndex < (int) mPages.size());
+
+    AtlasPage& page = mPages[pageIndex];
+    debug_assert(page.mCellSize.x == rectangle.w && page.mCellSize.y == rectangle.h);
+
+    const int cellsPerRow = mPageSize / page.mCellSize.x;
+    const int cellIndex = ((rectangle.y % mPageSize) / page.mCellSize.y) * cellsPerRow + (rectangle.x % mPageSize) / page.mCellSize.x;
+    debug_assert(!cxx::contains(page.mFreeCells, cellIndex));
+    page.mFreeCells.push_back(cellIndex);
+
+    // all cells are free
+    if ((int) page.mFreeCells.size() == page.mCellsCount)
+    {
+        page.mFreeCells.clear();
+        page.mCellSize = Point(0, 0);
+        page.mCellsCount = 0;
+        --mUsedPagesCount;
+    }
+}
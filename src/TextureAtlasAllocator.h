@@ -0,0 +1,45 @@
+#pragma once
+
+// manages free space of texture atlas which is split into square pages, each page is divided into equal cells
+// of power of two dimensions, so regions of similar size share pages and freed cells get reused without fragmentation,
+// it does not own any texture and only tracks rectangles in texels
+class TextureAtlasAllocator final: public cxx::noncopyable
+{
+public:
+    // Reset allocator, all pages become free
+    // @param atlasDimensions: Atlas width and height in texels, should be multiple of page size
+    // @param pageSize: Page width and height in texels, power of two
+    void Setup(const Point& atlasDimensions, int pageSize);
+
+    // Drop all pages
+    void Cleanup();
+
+    // Find free cell which fits region of specified size
+    // @param dimensions: Requested size in texels, should not exceed page size
+    // @param outRectangle: Allocated cell, its dimensions are rounded up to power of two
+    // @returns false if there is no free cell of suitable size
+    bool Allocate(const Point& dimensions, Rect& outRectangle);
+
+    // Return previously allocated cell, page becomes free for any cell size once all its cells are freed
+    // @param rectangle: Allocated cell
+    void Free(const Rect& rectangle);
+
+    // Test whether region of specified size can be allocated at all
+    // @param dimensions: Region size in texels
+    bool IsFitsPage(const Point& dimensions) const;
+
+    inline int GetPageSize() const { return mPageSize; }
+    inline int GetUsedPagesCount() const { return mUsedPagesCount; }
+
+private:
+    struct AtlasPage
+    {
+        Point mCellSize {0, 0}; // zero if page is free
+        std::vector<int> mFreeCells; // stack of free cell indices, row by row
+        int mCellsCount = 0;
+    };
+    std::vector<AtlasPage> mPages; // row by row
+    int mPagesPerRow = 0;
+    int mPageSize = 0;
+    int mUsedPagesCount = 0;
+};
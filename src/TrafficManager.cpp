@@ -88,13 +88,11 @@ void TrafficManager::GeneratePedestrians(bool offscreenOnly)
         // scan candidate from top
         for (int iz = (MAP_LAYERS_COUNT - 1); iz > 0; --iz)
         {
-            MapBlockInfo* mapBlockInfo = gGameMap.GetBlockClamp(pos.x, pos.y, iz - 1);
-            debug_assert(mapBlockInfo);
-
-            if (mapBlockInfo->mGroundType == eGroundType_Air)
+            eGroundType groundType = gGameMap.GetGroundTypeClamp(pos.x, pos.y, iz - 1);
+            if (groundType == eGroundType_Air)
                 continue;
 
-            if (mapBlockInfo->mGroundType == eGroundType_Pawement)
+            if (groundType == eGroundType_Pawement)
             {
                 CandidatePos candidatePos;
                 candidatePos.mMapX = pos.x;
@@ -10,6 +10,8 @@ TrimeshBuffer::~TrimeshBuffer()
 
 void TrimeshBuffer::SetVertices(unsigned int dataLength, const void* dataSource)
 {
+    debug_assert(!mIsStreaming);
+
     if (mVertexBuffer == nullptr)
     {
         mVertexBuffer = gGraphicsDevice.CreateBuffer(eBufferContent_Vertices, eBufferUsage_Stream, dataLength, dataSource);
@@ -25,6 +27,8 @@ void TrimeshBuffer::SetVertices(unsigned int dataLength, const void* dataSource)
 
 void TrimeshBuffer::SetIndices(unsigned int dataLength, const void* dataSource)
 {
+    debug_assert(!mIsStreaming || mSegmentIndicesLength == 0);
+
     if (mIndexBuffer == nullptr)
     {
         mIndexBuffer = gGraphicsDevice.CreateBuffer(eBufferContent_Indices, eBufferUsage_Stream, dataLength, dataSource);
@@ -50,6 +54,9 @@ void TrimeshBuffer::Bind(const VertexFormat& vertexFormat)
 
 void TrimeshBuffer::Deinit()
 {
+    DestroyStreamingFences();
+    mIsStreaming = false;
+
     if (mIndexBuffer)
     {
         gGraphicsDevice.DestroyBuffer(mIndexBuffer);
@@ -60,4 +67,131 @@ void TrimeshBuffer::Deinit()
         gGraphicsDevice.DestroyBuffer(mVertexBuffer);
         mVertexBuffer = nullptr;
     }
+}
+
+bool TrimeshBuffer::SetupStreaming(unsigned int verticesLength, unsigned int indicesLength)
+{
+    if (!gGraphicsDevice.mCaps.mFeatures[eGraphicsFeature_BufferStorage])
+        return false;
+
+    debug_assert(verticesLength > 0);
+    return SetupStreamingBuffers(verticesLength, indicesLength);
+}
+
+bool TrimeshBuffer::SetupStreamingBuffers(unsigned int verticesLength, unsigned int indicesLength)
+{
+    // old buffer objects are released by driver once gpu completes pending draws, so there is no need to wait
+    DestroyStreamingFences();
+
+    mIsStreaming = false;
+    mSegmentVerticesLength = (verticesLength + 15U) & (~15U);
+    mSegmentIndicesLength = (indicesLength + 15U) & (~15U);
+    mVerticesCursor = 0;
+    mIndicesCursor = 0;
+    mCurrentSegment = 0;
+
+    if (mVertexBuffer == nullptr)
+    {
+        mVertexBuffer = gGraphicsDevice.CreateBuffer(eBufferContent_Vertices);
+        debug_assert(mVertexBuffer);
+    }
+
+    if (!mVertexBuffer->SetupPersistent(mSegmentVerticesLength * NumStreamingSegments))
+    {
+        gConsole.LogMessage(eLogMessage_Warning, "Cannot allocate streaming trimesh buffers");
+        return false;
+    }
+
+    // indices are static
+    if (mSegmentIndicesLength == 0)
+    {
+        mIsStreaming = true;
+        return true;
+    }
+
+    if (mIndexBuffer == nullptr)
+    {
+        mIndexBuffer = gGraphicsDevice.CreateBuffer(eBufferContent_Indices);
+        debug_assert(mIndexBuffer);
+    }
+
+    if (!mIndexBuffer->SetupPersistent(mSegmentIndicesLength * NumStreamingSegments))
+    {
+        gConsole.LogMessage(eLogMessage_Warning, "Cannot allocate streaming trimesh buffers");
+        return false;
+    }
+
+    mIsStreaming = true;
+    return true;
+}
+
+bool TrimeshBuffer::AllocateStreamingData(unsigned int vertexSize, unsigned int verticesLength, unsigned int indicesLength, TrimeshStreamingData& outStreamingData)
+{
+    debug_assert(mIsStreaming);
+    debug_assert(vertexSize > 0);
+
+    // grow segments, reserve space for vertex alignment
+    if ((verticesLength + vertexSize > mSegmentVerticesLength) || (indicesLength > mSegmentIndicesLength))
+    {
+        unsigned int newVerticesLength = std::max(mSegmentVerticesLength * 2, verticesLength + vertexSize);
+        unsigned int newIndicesLength = std::max(mSegmentIndicesLength * 2, indicesLength);
+        if (!SetupStreamingBuffers(newVerticesLength, newIndicesLength))
+            return false;
+    }
+
+    auto GetVerticesOffset = [this, vertexSize]()
+    {
+        unsigned int verticesOffset = mCurrentSegment * mSegmentVerticesLength + mVerticesCursor;
+        return ((verticesOffset + vertexSize - 1) / vertexSize) * vertexSize;
+    };
+
+    unsigned int verticesOffset = GetVerticesOffset();
+
+    // does not fit into current segment, move to next one
+    if ((verticesOffset + verticesLength > (mCurrentSegment + 1) * mSegmentVerticesLength) ||
+        (mIndicesCursor + indicesLength > mSegmentIndicesLength))
+    {
+        // protect filled segment until gpu completes its draws
+        debug_assert(mSegmentsFences[mCurrentSegment] == nullptr);
+        mSegmentsFences[mCurrentSegment] = gGraphicsDevice.CreateFence();
+
+        mCurrentSegment = (mCurrentSegment + 1) % NumStreamingSegments;
+        mVerticesCursor = 0;
+        mIndicesCursor = 0;
+
+        if (mSegmentsFences[mCurrentSegment])
+        {
+            gGraphicsDevice.WaitFence(mSegmentsFences[mCurrentSegment]);
+            gGraphicsDevice.DestroyFence(mSegmentsFences[mCurrentSegment]);
+            mSegmentsFences[mCurrentSegment] = nullptr;
+        }
+        verticesOffset = GetVerticesOffset();
+    }
+
+    unsigned int indicesOffset = mCurrentSegment * mSegmentIndicesLength + mIndicesCursor;
+
+    outStreamingData.mVertices = static_cast<unsigned char*>(mVertexBuffer->mPersistentData) + verticesOffset;
+    outStreamingData.mIndices = nullptr;
+    if (mSegmentIndicesLength > 0)
+    {
+        outStreamingData.mIndices = static_cast<unsigned char*>(mIndexBuffer->mPersistentData) + indicesOffset;
+    }
+    outStreamingData.mBaseVertex = verticesOffset / vertexSize;
+    outStreamingData.mIndicesOffset = indicesOffset;
+
+    mVerticesCursor = verticesOffset + verticesLength - mCurrentSegment * mSegmentVerticesLength;
+    mIndicesCursor += indicesLength;
+    return true;
+}
+
+void TrimeshBuffer::DestroyStreamingFences()
+{
+    for (GpuFenceHandle& currFence: mSegmentsFences)
+    {
+        if (currFence)
+        {
+            gGraphicsDevice.DestroyFence(currFence);
+            currFence = nullptr;
+        }
+    }
 }
\ No newline at end of file
@@ -1,5 +1,15 @@
 #pragma once
 
+// defines destination of streaming trimesh data allocated within ring buffers
+struct TrimeshStreamingData
+{
+public:
+    void* mVertices = nullptr; // write only, mapped gpu memory
+    void* mIndices = nullptr; // write only, mapped gpu memory
+    unsigned int mBaseVertex = 0; // index of first allocated vertex
+    unsigned int mIndicesOffset = 0; // offset within index buffer, bytes
+};
+
 class TrimeshBuffer final: public cxx::noncopyable
 {
 public:
@@ -11,7 +21,42 @@ public:
     void Bind(const VertexFormat& vertexFormat);
     void Deinit();
 
+    // Switch to streaming mode, vertices and indices are written directly into persistently mapped ring buffers
+    // Ring buffers are split into segments, each segment gets protected with fence once it is filled up
+    // so cpu never overwrites data which is still in use by gpu
+    // Requires eGraphicsFeature_BufferStorage
+    // @param verticesLength, indicesLength: Initial length of single segment, bytes
+    // Indices length might be zero, in that case only vertices are streamed and indices are specified with SetIndices
+    // @returns false if streaming is not supported
+    bool SetupStreaming(unsigned int verticesLength, unsigned int indicesLength);
+
+    // Allocate space for vertices and indices within current ring segment, valid until next allocation,
+    // data must be written before draw calls are issued
+    // @param vertexSize: Size of single vertex, bytes
+    // @param verticesLength, indicesLength: Data length, bytes
+    // @param outStreamingData: Output write pointers and buffer offsets
+    // @returns false on fail
+    bool AllocateStreamingData(unsigned int vertexSize, unsigned int verticesLength, unsigned int indicesLength, TrimeshStreamingData& outStreamingData);
+
+    // Test whether streaming mode is active
+    inline bool IsStreaming() const { return mIsStreaming; }
+
+private:
+    bool SetupStreamingBuffers(unsigned int verticesLength, unsigned int indicesLength);
+    void DestroyStreamingFences();
+
 public:
     GpuBuffer* mVertexBuffer = nullptr;
     GpuBuffer* mIndexBuffer = nullptr;
-};
\ No newline at end of file
+
+private:
+    static const int NumStreamingSegments = 3; // triple buffering
+
+    GpuFenceHandle mSegmentsFences[NumStreamingSegments] = {};
+    unsigned int mSegmentVerticesLength = 0;
+    unsigned int mSegmentIndicesLength = 0;
+    unsigned int mVerticesCursor = 0; // within current segment, bytes
+    unsigned int mIndicesCursor = 0; // within current segment, bytes
+    int mCurrentSegment = 0;
+    bool mIsStreaming = false;
+};
@@ -62,53 +62,108 @@ public:
     }
 };
 
-// defines draw vertex of sprite
-struct SpriteVertex3D
+// defines compact draw vertex of city mesh, all coordinates are on block grid so they are stored as integers
+struct CityVertex3D_Packed
 {
 public:
-    SpriteVertex3D() = default;
-
-    // setup vertex
-    // @param posx, posy, posz: Coordinate in 3d space
-    // @param tcu, tcv: Texture coordinate normalized [0, 1]
-    void Set(float posx, float posy, float posz, float tcu, float tcv, unsigned short clutIndex)
-    {
-        mPosition.x = posx;
-        mPosition.y = posy;
-        mPosition.z = posz;
-        mTexcoord.x = tcu;
-        mTexcoord.y = tcv;
-        mClutIndex = clutIndex;
-    }
-public:
-    glm::vec3 mPosition; // 12 bytes
-    glm::vec2 mTexcoord; // 8 bytes
+    static const int PositionFixedPoint = 64; // position units per map unit, exact for slopes elevations
+
+public:
+    CityVertex3D_Packed() = default;
+
+    // setup vertex from regular city mesh vertex
+    // @param sourceVertex: Source vertex, texture coordinates must be integers
+    inline void Set(const CityVertex3D& sourceVertex)
+    {
+        const float positionScale = PositionFixedPoint / METERS_PER_MAP_UNIT;
+        mPosition[0] = (short) std::lround(sourceVertex.mPosition.x * positionScale);
+        mPosition[1] = (short) std::lround(sourceVertex.mPosition.y * positionScale);
+        mPosition[2] = (short) std::lround(sourceVertex.mPosition.z * positionScale);
+        mTextureLayer = (short) std::lround(sourceVertex.mTexcoord.z);
+        mTexcoord[0] = (signed char) std::lround(sourceVertex.mTexcoord.x);
+        mTexcoord[1] = (signed char) std::lround(sourceVertex.mTexcoord.y);
+        mRemap = (signed char) sourceVertex.mRemap;
+        mTransparency = (signed char) sourceVertex.mTransparency;
+    }
+public:
+    short mPosition[3]; // 6 bytes
+    short mTextureLayer; // 2 bytes
+    signed char mTexcoord[2]; // 2 bytes, block corners, merged faces go beyond [0, 1]
+    signed char mRemap; // 1 byte
+    signed char mTransparency; // 1 byte
+};
+
+const unsigned int Sizeof_CityVertex3D_Packed = sizeof(CityVertex3D_Packed);
+
+// defines compact draw vertex format of city mesh, see city_mesh.glsl
+struct CityVertex3D_Packed_Format: public VertexFormat
+{
+public:
+    CityVertex3D_Packed_Format()
+    {
+        Setup();
+    }
+    // get format definition
+    static const CityVertex3D_Packed_Format& Get() 
+    { 
+        static const CityVertex3D_Packed_Format sDefinition; 
+        return sDefinition; 
+    }
+    using TVertexType = CityVertex3D_Packed;
+    // initialzie definition
+    inline void Setup()
+    {
+        this->mDataStride = Sizeof_CityVertex3D_Packed;
+        // position and texture layer
+        this->SetAttribute(eVertexAttribute_Position0, eVertexAttributeFormat_4S, offsetof(TVertexType, mPosition));
+        // texture coordinates, remap and transparency
+        this->SetAttribute(eVertexAttribute_Texcoord0, eVertexAttributeFormat_4B, offsetof(TVertexType, mTexcoord));
+    }
+};
+
+// defines draw instance of sprite, quad vertices are generated in sprites.glsl
+struct SpriteInstance3D
+{
+public:
+    SpriteInstance3D() = default;
+
+public:
+    glm::vec2 mPosition; // 8 bytes
+    float mHeight; // 4 bytes
+    float mRotation; // 4 bytes, radians
+    glm::vec4 mTextureRegion; // 16 bytes, u0, v0, u1, v1
+    glm::vec2 mSize; // 8 bytes
     unsigned short mClutIndex; // 2 bytes
+    unsigned short mOriginMode; // 2 bytes, see Sprite2D::eOriginMode
 };
 
-const unsigned int Sizeof_SpriteVertex3D = sizeof(SpriteVertex3D);
+const unsigned int Sizeof_SpriteInstance3D = sizeof(SpriteInstance3D);
 
-// defines draw vertex format of sprite
-struct SpriteVertex3D_Format: public VertexFormat
-{
-public:
-    SpriteVertex3D_Format()
-    {
-        Setup();
-    }
-    // get format definition
-    static const SpriteVertex3D_Format& Get() 
-    { 
-        static const SpriteVertex3D_Format sDefinition; 
-        return sDefinition; 
-    }
-    using TVertexType = SpriteVertex3D;
-    // initialzie definition
-    inline void Setup()
-    {
-        this->mDataStride = Sizeof_SpriteVertex3D;
-        this->SetAttribute(eVertexAttribute_Position0, eVertexAttributeFormat_3F, offsetof(TVertexType, mPosition));
-        this->SetAttribute(eVertexAttribute_Texcoord0, eVertexAttributeFormat_2F, offsetof(TVertexType, mTexcoord));
-        this->SetAttribute(eVertexAttribute_Color0, eVertexAttributeFormat_1US, offsetof(TVertexType, mClutIndex));
-    }
+// defines draw instance format of sprite
+struct SpriteInstance3D_Format: public VertexFormat
+{
+public:
+    SpriteInstance3D_Format()
+    {
+        Setup();
+    }
+    // get format definition
+    static const SpriteInstance3D_Format& Get() 
+    { 
+        static const SpriteInstance3D_Format sDefinition; 
+        return sDefinition; 
+    }
+    using TVertexType = SpriteInstance3D;
+    // initialzie definition
+    inline void Setup()
+    {
+        this->mDataStride = Sizeof_SpriteInstance3D;
+        this->mInstanceDivisor = 1;
+        // position, height and rotation
+        this->SetAttribute(eVertexAttribute_Position0, eVertexAttributeFormat_4F, offsetof(TVertexType, mPosition));
+        this->SetAttribute(eVertexAttribute_Texcoord0, eVertexAttributeFormat_4F, offsetof(TVertexType, mTextureRegion));
+        this->SetAttribute(eVertexAttribute_Texcoord1, eVertexAttributeFormat_2F, offsetof(TVertexType, mSize));
+        // palette index and origin mode
+        this->SetAttribute(eVertexAttribute_Color0, eVertexAttributeFormat_2US, offsetof(TVertexType, mClutIndex));
+    }
 };
\ No newline at end of file
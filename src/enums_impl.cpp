@@ -192,9 +192,12 @@ impl_enum_strings(eVertexAttributeFormat)
 {
     {eVertexAttributeFormat_2F, "2f"},
     {eVertexAttributeFormat_3F, "3f"},
+    {eVertexAttributeFormat_4F, "4f"},
     {eVertexAttributeFormat_4UB, "4ub"},
     {eVertexAttributeFormat_1US, "1us"},
     {eVertexAttributeFormat_2US, "2us"},
+    {eVertexAttributeFormat_4B, "4b"},
+    {eVertexAttributeFormat_4S, "4s"},
     {eVertexAttributeFormat_Unknown, "unknown"},
 };
 
@@ -214,6 +217,7 @@ impl_enum_strings(eBufferContent)
 {
     {eBufferContent_Vertices, "vertices"},
     {eBufferContent_Indices, "indices"},
+    {eBufferContent_DrawIndirect, "draw_indirect"},
 };
 
 impl_enum_strings(eBufferUsage)
@@ -233,6 +237,7 @@ impl_enum_strings(eRenderUniform)
     {eRenderUniform_ViewProjectionMatrix, "view_projection_matrix"},
     {eRenderUniform_NormalMatrix, "normal_matrix"},
     {eRenderUniform_CameraPosition, "camera_position"},
+    {eRenderUniform_AnimationCycle, "animation_cycle"},
 };
 
 impl_enum_strings(eBlendMode)
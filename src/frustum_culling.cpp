@@ -0,0 +1,91 @@
+#include "stdafx.h"
+#include "frustum_culling.h"
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+    #define FRUSTUM_CULLING_SSE
+    #include <xmmintrin.h>
+#endif
+
+namespace cxx
+{
+    // box is outside of frustum if its corner farthest along plane normal is behind that plane,
+    // distance to that corner is dot(normal, center) + dot(abs(normal), extents) + distance
+
+    unsigned int frustum_contains_4(const frustum_t& frustum, const aabbox_t* boundingBoxes)
+    {
+#ifdef FRUSTUM_CULLING_SSE
+        const __m128 half = _mm_set1_ps(0.5f);
+        const __m128 minx = _mm_setr_ps(boundingBoxes[0].mMin.x, boundingBoxes[1].mMin.x, boundingBoxes[2].mMin.x, boundingBoxes[3].mMin.x);
+        const __m128 miny = _mm_setr_ps(boundingBoxes[0].mMin.y, boundingBoxes[1].mMin.y, boundingBoxes[2].mMin.y, boundingBoxes[3].mMin.y);
+        const __m128 minz = _mm_setr_ps(boundingBoxes[0].mMin.z, boundingBoxes[1].mMin.z, boundingBoxes[2].mMin.z, boundingBoxes[3].mMin.z);
+        const __m128 maxx = _mm_setr_ps(boundingBoxes[0].mMax.x, boundingBoxes[1].mMax.x, boundingBoxes[2].mMax.x, boundingBoxes[3].mMax.x);
+        const __m128 maxy = _mm_setr_ps(boundingBoxes[0].mMax.y, boundingBoxes[1].mMax.y, boundingBoxes[2].mMax.y, boundingBoxes[3].mMax.y);
+        const __m128 maxz = _mm_setr_ps(boundingBoxes[0].mMax.z, boundingBoxes[1].mMax.z, boundingBoxes[2].mMax.z, boundingBoxes[3].mMax.z);
+
+        const __m128 centerx = _mm_mul_ps(_mm_add_ps(minx, maxx), half);
+        const __m128 centery = _mm_mul_ps(_mm_add_ps(miny, maxy), half);
+        const __m128 centerz = _mm_mul_ps(_mm_add_ps(minz, maxz), half);
+        const __m128 extentx = _mm_mul_ps(_mm_sub_ps(maxx, minx), half);
+        const __m128 extenty = _mm_mul_ps(_mm_sub_ps(maxy, miny), half);
+        const __m128 extentz = _mm_mul_ps(_mm_sub_ps(maxz, minz), half);
+
+        __m128 outside = _mm_setzero_ps();
+        for (const plane3d_t& currPlane: frustum.mPlanes)
+        {
+            __m128 distance = _mm_add_ps(
+                _mm_add_ps(_mm_mul_ps(centerx, _mm_set1_ps(currPlane.mNormal.x)), _mm_mul_ps(centery, _mm_set1_ps(currPlane.mNormal.y))),
+                _mm_add_ps(_mm_mul_ps(centerz, _mm_set1_ps(currPlane.mNormal.z)), _mm_set1_ps(currPlane.mDistance)));
+            distance = _mm_add_ps(distance, _mm_add_ps(
+                _mm_add_ps(_mm_mul_ps(extentx, _mm_set1_ps(fabsf(currPlane.mNormal.x))), _mm_mul_ps(extenty, _mm_set1_ps(fabsf(currPlane.mNormal.y)))),
+                _mm_mul_ps(extentz, _mm_set1_ps(fabsf(currPlane.mNormal.z)))));
+            outside = _mm_or_ps(outside, _mm_cmple_ps(distance, _mm_setzero_ps()));
+        }
+        return (~_mm_movemask_ps(outside)) & 0x0F;
+#else
+        unsigned int visibleMask = 0;
+        for (int ibox = 0; ibox < 4; ++ibox)
+        {
+            const glm::vec3 center = (boundingBoxes[ibox].mMin + boundingBoxes[ibox].mMax) * 0.5f;
+            const glm::vec3 extents = (boundingBoxes[ibox].mMax - boundingBoxes[ibox].mMin) * 0.5f;
+
+            bool isOutside = false;
+            for (const plane3d_t& currPlane: frustum.mPlanes)
+            {
+                const float distance = glm::dot(center, currPlane.mNormal) + currPlane.mDistance + glm::dot(extents, glm::abs(currPlane.mNormal));
+                if (distance <= 0.0f)
+                {
+                    isOutside = true;
+                    break;
+                }
+            }
+
+            if (!isOutside)
+            {
+                visibleMask |= (1U << ibox);
+            }
+        }
+        return visibleMask;
+#endif
+    }
+
+    void frustum_contains_many(const frustum_t& frustum, const aabbox_t* boundingBoxes, int count, unsigned int* outVisibleMasks)
+    {
+        const int fullPacksCount = count / 4;
+        for (int ipack = 0; ipack < fullPacksCount; ++ipack)
+        {
+            outVisibleMasks[ipack] = frustum_contains_4(frustum, boundingBoxes + ipack * 4);
+        }
+
+        // last pack is padded with copies of its first box
+        const int remainingCount = count % 4;
+        if (remainingCount > 0)
+        {
+            aabbox_t lastPack[4];
+            for (int ibox = 0; ibox < 4; ++ibox)
+            {
+                lastPack[ibox] = boundingBoxes[fullPacksCount * 4 + ((ibox < remainingCount) ? ibox : 0)];
+            }
+            outVisibleMasks[fullPacksCount] = frustum_contains_4(frustum, lastPack) & ((1U << remainingCount) - 1);
+        }
+    }
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+namespace cxx
+{
+    // test 4 bounding boxes against frustum at once, sse is used when available
+    // results are same as of frustum_t::contains for each box
+    // @param frustum: Frustum
+    // @param boundingBoxes: Array of 4 boxes
+    // @returns bit mask of boxes which are in frustum, bit N is set if box N is visible
+    unsigned int frustum_contains_4(const frustum_t& frustum, const aabbox_t* boundingBoxes);
+
+    // test multiple bounding boxes against frustum, boxes are processed in packs of 4
+    // @param frustum: Frustum
+    // @param boundingBoxes: Boxes
+    // @param count: Number of boxes
+    // @param outVisibleMasks: Output bit masks of visible boxes, one mask per pack of 4 boxes so (count + 3) / 4 elements
+    void frustum_contains_many(const frustum_t& frustum, const aabbox_t* boundingBoxes, int count, unsigned int* outVisibleMasks);
+
+    // test whether box is visible according to masks produced by frustum_contains_many
+    // @param visibleMasks: Bit masks of visible boxes
+    // @param boxIndex: Box index
+    inline bool frustum_mask_visible(const unsigned int* visibleMasks, int boxIndex)
+    {
+        return (visibleMasks[boxIndex / 4] & (1U << (boxIndex % 4))) != 0;
+    }
+}
@@ -0,0 +1,109 @@
+#include "stdafx.h"
+#include "mapped_file.h"
+
+#if OS_NAME == OS_LINUX
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <fcntl.h>
+#endif
+
+namespace cxx
+{
+
+mapped_file::~mapped_file()
+{
+    close();
+}
+
+bool mapped_file::open(const std::string& pathto)
+{
+    close();
+
+#if OS_NAME == OS_WINDOWS
+    mFileHandle = ::CreateFileA(pathto.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (mFileHandle == INVALID_HANDLE_VALUE)
+        return false;
+
+    LARGE_INTEGER fileSize;
+    if (!::GetFileSizeEx(mFileHandle, &fileSize) || fileSize.QuadPart == 0)
+    {
+        close();
+        return false;
+    }
+
+    mMappingHandle = ::CreateFileMappingA(mFileHandle, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (mMappingHandle == NULL)
+    {
+        close();
+        return false;
+    }
+
+    void* mappedData = ::MapViewOfFile(mMappingHandle, FILE_MAP_READ, 0, 0, 0);
+    if (mappedData == nullptr)
+    {
+        close();
+        return false;
+    }
+    mMappedData = static_cast<const unsigned char*>(mappedData);
+    mMappedLength = static_cast<size_t>(fileSize.QuadPart);
+    return true;
+
+#elif OS_NAME == OS_LINUX
+    int fileDescriptor = ::open(pathto.c_str(), O_RDONLY);
+    if (fileDescriptor == -1)
+        return false;
+
+    struct stat fileStat;
+    if (::fstat(fileDescriptor, &fileStat) == -1 || fileStat.st_size == 0)
+    {
+        ::close(fileDescriptor);
+        return false;
+    }
+
+    void* mappedData = ::mmap(nullptr, static_cast<size_t>(fileStat.st_size), PROT_READ, MAP_PRIVATE, fileDescriptor, 0);
+    // mapping stays valid after descriptor is closed
+    ::close(fileDescriptor);
+
+    if (mappedData == MAP_FAILED)
+        return false;
+
+    ::madvise(mappedData, static_cast<size_t>(fileStat.st_size), MADV_SEQUENTIAL);
+
+    mMappedData = static_cast<const unsigned char*>(mappedData);
+    mMappedLength = static_cast<size_t>(fileStat.st_size);
+    return true;
+
+#else
+    debug_assert(false);
+    return false;
+#endif
+}
+
+void mapped_file::close()
+{
+#if OS_NAME == OS_WINDOWS
+    if (mMappedData)
+    {
+        ::UnmapViewOfFile(mMappedData);
+    }
+    if (mMappingHandle != NULL)
+    {
+        ::CloseHandle(mMappingHandle);
+        mMappingHandle = NULL;
+    }
+    if (mFileHandle != INVALID_HANDLE_VALUE)
+    {
+        ::CloseHandle(mFileHandle);
+        mFileHandle = INVALID_HANDLE_VALUE;
+    }
+#elif OS_NAME == OS_LINUX
+    if (mMappedData)
+    {
+        ::munmap(const_cast<unsigned char*>(mMappedData), mMappedLength);
+    }
+#endif
+    mMappedData = nullptr;
+    mMappedLength = 0;
+}
+
+} // namespace cxx
@@ -0,0 +1,36 @@
+#pragma once
+
+namespace cxx
+{
+    // defines read-only memory mapped file
+    class mapped_file: public cxx::noncopyable
+    {
+    public:
+        mapped_file() = default;
+        ~mapped_file();
+
+        // map whole file content into memory
+        // @param pathto: Full path to file
+        // @returns false on error
+        bool open(const std::string& pathto);
+
+        // unmap file content and release os handles
+        void close();
+
+        // test whether file content is mapped
+        bool is_open() const { return mMappedData != nullptr; }
+
+        // get mapped content, memory is valid until file gets closed
+        inline const unsigned char* get_data() const { return mMappedData; }
+        inline size_t get_size() const { return mMappedLength; }
+
+    private:
+        const unsigned char* mMappedData = nullptr;
+        size_t mMappedLength = 0;
+#if OS_NAME == OS_WINDOWS
+        HANDLE mFileHandle = INVALID_HANDLE_VALUE;
+        HANDLE mMappingHandle = NULL;
+#endif
+    };
+
+} // namespace cxx
@@ -0,0 +1,70 @@
+#include "stdafx.h"
+#include "radix_sort.h"
+
+namespace cxx
+{
+    void radix_sort(unsigned long long* keys, unsigned int* indices, int count, unsigned long long* scratchKeys, unsigned int* scratchIndices)
+    {
+        if (count < 2)
+            return;
+
+        debug_assert(keys && indices && scratchKeys && scratchIndices);
+
+        const int NumDigits = 8;
+        const int NumBuckets = 256;
+
+        // histograms of all digits are gathered with single pass over keys
+        unsigned int histograms[NumDigits][NumBuckets] = {};
+        for (int icurr = 0; icurr < count; ++icurr)
+        {
+            unsigned long long currKey = keys[icurr];
+            for (int idigit = 0; idigit < NumDigits; ++idigit)
+            {
+                ++histograms[idigit][(currKey >> (idigit * 8)) & 0xFF];
+            }
+        }
+
+        unsigned long long* sourceKeys = keys;
+        unsigned int* sourceIndices = indices;
+        unsigned long long* destKeys = scratchKeys;
+        unsigned int* destIndices = scratchIndices;
+
+        for (int idigit = 0; idigit < NumDigits; ++idigit)
+        {
+            unsigned int* histogram = histograms[idigit];
+            const int digitShift = idigit * 8;
+
+            // all keys have same digit, pass would not change order
+            if (histogram[(sourceKeys[0] >> digitShift) & 0xFF] == (unsigned int) count)
+                continue;
+
+            // convert counts to bucket offsets
+            unsigned int bucketOffset = 0;
+            for (int ibucket = 0; ibucket < NumBuckets; ++ibucket)
+            {
+                unsigned int bucketCount = histogram[ibucket];
+                histogram[ibucket] = bucketOffset;
+                bucketOffset += bucketCount;
+            }
+
+            // scatter keys in source order, so sort is stable
+            for (int icurr = 0; icurr < count; ++icurr)
+            {
+                unsigned long long currKey = sourceKeys[icurr];
+                unsigned int destIndex = histogram[(currKey >> digitShift) & 0xFF]++;
+                destKeys[destIndex] = currKey;
+                destIndices[destIndex] = sourceIndices[icurr];
+            }
+
+            std::swap(sourceKeys, destKeys);
+            std::swap(sourceIndices, destIndices);
+        }
+
+        // odd number of passes leaves result in scratch buffers
+        if (sourceKeys != keys)
+        {
+            ::memcpy(keys, sourceKeys, count * sizeof(unsigned long long));
+            ::memcpy(indices, sourceIndices, count * sizeof(unsigned int));
+        }
+    }
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+namespace cxx
+{
+    // stable least significant digit radix sort of 64 bit keys, 8 bits per pass,
+    // passes where all keys share same digit are skipped so narrow keys are sorted faster
+    // @param keys: Keys to sort, sorted in place
+    // @param indices: Values attached to keys, usually element indices, permuted along with keys
+    // @param count: Number of keys
+    // @param scratchKeys, scratchIndices: Temporary buffers of at least count elements
+    void radix_sort(unsigned long long* keys, unsigned int* indices, int count, unsigned long long* scratchKeys, unsigned int* scratchIndices);
+
+    // map float to unsigned integer with same ordering, so floats can be part of radix sort key
+    // @param value: Source value, must not be NaN
+    inline unsigned int float_to_sortable_bits(float value)
+    {
+        value += 0.0f; // negative zero becomes positive zero
+
+        unsigned int bits;
+        ::memcpy(&bits, &value, sizeof(bits));
+        // negative values are flipped entirely, positive values get sign bit set
+        return (bits & 0x80000000U) ? ~bits : (bits | 0x80000000U);
+    }
+}
@@ -44,6 +44,9 @@
 #include <chrono>
 #include <thread>
 #include <functional>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
 
 // opengl
 #include <GL/glew.h>
@@ -70,6 +73,8 @@
 #include "enum_utils.h"
 #include "math_defs.h"
 #include "math_utils.h"
+#include "frustum_culling.h"
+#include "radix_sort.h"
 #include "handle.h"
 #include "intrusive_list.h"
 #include "memory_istream.h"
@@ -78,6 +83,7 @@
 #include "randomizer.h"
 #include "strings.h"
 #include "path_utils.h"
+#include "mapped_file.h"
 #include "json_document.h"
 #include "mem_allocators.h"
 #include "iostream_utils.h"